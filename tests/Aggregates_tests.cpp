@@ -0,0 +1,151 @@
+#include "PseudonymisedDB.h"
+#include "Aggregates_tests.h"
+#include "PseudonymisedDB_tests.h"
+#include "cryptoTools/Common/Matrix.h"
+#include "cryptoTools/Crypto/PRNG.h"
+
+#include <unordered_map>
+#include <iostream>
+
+using namespace oc;
+using namespace uppid;
+
+void standingAggregates_test(const oc::CLP& cmd)
+{
+    const u64 n = cmd.getOr("n", 500);
+    const u64 rounds = cmd.getOr("rounds", 3);
+    const u64 dataByteSize = 16;
+
+    PRNG prng;
+    prng.SetSeed(oc::ZeroBlock);
+
+    macoro::thread_pool pool0;
+    auto e0 = pool0.make_work();
+    pool0.create_thread();
+
+    macoro::thread_pool pool1;
+    auto e1 = pool1.make_work();
+    pool1.create_thread();
+
+    auto socket = coproto::LocalAsyncSocket::makePair();
+    socket[0].setExecutor(pool0);
+    socket[1].setExecutor(pool1);
+
+    PseudonymisedDB_P0 db0(dataByteSize, prng.get(), PrfType::AltMod, 1ull << 16);
+    PseudonymisedDB_P1 db1(dataByteSize, prng.get(), PrfType::AltMod, 1ull << 16);
+
+    auto run = [&](auto p0, auto p1) {
+        auto r = macoro::sync_wait(macoro::when_all_ready(
+            p0() | macoro::start_on(pool0),
+            p1() | macoro::start_on(pool1)));
+        std::get<0>(r).result();
+        std::get<1>(r).result();
+    };
+
+    // COUNT, SUM of bytes [0, 8) and SUM of bytes [8, 12)
+    const std::vector<AggregateSpec> specs = {
+        { AggregateOp::Count },
+        { AggregateOp::Sum, 0, 8 },
+        { AggregateOp::Sum, 8, 4 } };
+    std::vector<u64> ids(specs.size());
+
+    auto registerAggregate = [&](u64 k) {
+        u64 id1;
+        run([&]() -> Proto {
+            co_await db0.registerAggregate_P0(specs[k], ids[k], socket[0]);
+        }, [&]() -> Proto {
+            co_await db1.registerAggregate_P1(specs[k], id1, socket[1]);
+        });
+        if (ids[k] != id1)
+            throw RTE_LOC;
+    };
+
+    // the count is registered on the empty table, the sums after the first update
+    registerAggregate(0);
+
+    std::vector<block> Xall, Yall;
+    std::unordered_map<block, u64> yPayload;
+    Matrix<u8> Dall(0, dataByteSize);
+    std::vector<u64> expected(specs.size());
+
+    for (u64 round = 0; round < rounds; ++round)
+    {
+        // X' is fresh. Y' holds half of X', some rows of X that had no match
+        // yet (the delta of SSLJ (X, Y')) and fresh identifiers.
+        std::vector<block> X(n), Y;
+        prng.get(X.data(), X.size());
+        for (u64 i = 0; i < n / 2; ++i)
+            Y.push_back(X[i]);
+        for (u64 i = 0, added = 0; i < Xall.size() && added < n / 10; ++i)
+            if (!yPayload.count(Xall[i]))
+                Y.push_back(Xall[i]), ++added;
+        for (u64 i = 0; i < n / 4; ++i)
+            Y.push_back(prng.get<block>());
+
+        Matrix<u8> D(Y.size(), dataByteSize);
+        prng.get(D.data(), D.size());
+        for (u64 j = 0; j < Y.size(); ++j)
+            yPayload[Y[j]] = Dall.rows() + j;
+        Matrix<u8> tmp(Dall.rows() + D.rows(), dataByteSize);
+        std::memcpy(tmp.data(), Dall.data(), Dall.size());
+        std::memcpy(tmp.data(Dall.rows()), D.data(), D.size());
+        Dall = std::move(tmp);
+        Xall.insert(Xall.end(), X.begin(), X.end());
+        Yall.insert(Yall.end(), Y.begin(), Y.end());
+
+        run([&]() -> Proto {
+            co_await db0.insertID(X, socket[0]);
+            co_await db0.respondOPRF(socket[0]);
+        }, [&]() -> Proto {
+            co_await db1.respondOPRF(socket[1]);
+            co_await db1.insertID(Y, D, socket[1]);
+        });
+        run([&]() -> Proto {
+            co_await db0.shareUpdate_P0(socket[0]);
+        }, [&]() -> Proto {
+            co_await db1.shareUpdate_P1(socket[1]);
+        });
+        // the table must agree with the aggregates, late matches included
+        checkCurrentState(db0, db1, Xall, Yall, Dall, dataByteSize);
+
+        if (round == 0)
+            for (u64 k = 1; k < specs.size(); ++k)
+                registerAggregate(k);
+
+        std::fill(expected.begin(), expected.end(), 0);
+        for (auto& x : Xall)
+        {
+            auto it = yPayload.find(x);
+            if (it == yPayload.end())
+                continue;
+            for (u64 k = 0; k < specs.size(); ++k)
+            {
+                u64 v = 1;
+                if (specs[k].mOp == AggregateOp::Sum)
+                {
+                    v = 0;
+                    std::memcpy(&v, Dall.data(it->second) + specs[k].mOffset, specs[k].mBytes);
+                }
+                expected[k] += v;
+            }
+        }
+
+        for (u64 k = 0; k < specs.size(); ++k)
+        {
+            u64 v0, v1;
+            run([&]() -> Proto {
+                co_await db0.revealAggregate(ids[k], v0, socket[0]);
+            }, [&]() -> Proto {
+                co_await db1.revealAggregate(ids[k], v1, socket[1]);
+            });
+
+            if (v0 != v1 || v0 != expected[k] || 
+                db0.aggregateShare(ids[k]) + db1.aggregateShare(ids[k]) != v0)
+                throw RTE_LOC;
+        }
+
+        if (cmd.isSet("v"))
+            std::cout << "round " << round << ": |X| = " << Xall.size() 
+                      << ", count = " << expected[0] << "\n";
+    }
+}
@@ -0,0 +1,77 @@
+#include "CostModel.h"
+#include "CostModel_tests.h"
+#include "cryptoTools/Crypto/PRNG.h"
+
+#include <cmath>
+#include <iostream>
+
+using namespace oc;
+using namespace uppid;
+
+void costModel_test(const oc::CLP& cmd)
+{
+    PRNG prng;
+    prng.SetSeed(oc::ZeroBlock);
+
+    auto close = [](double a, double b) { return std::abs(a - b) <= 1e-3 * std::abs(b) + 1e-12; };
+
+    // the defaults are kept until there are enough observations
+    CostModel model;
+    auto defaults = model.mSslj;
+    model.observeSslj(1000, 1000, 1.0);
+    if (model.mSslj.mFixed != defaults.mFixed)
+        throw RTE_LOC;
+    model = CostModel();
+
+    // exact observations of a known model are recovered
+    for (u64 i = 0; i < 20; ++i)
+    {
+        u64 s = 1000 + prng.get<u32>() % 100000;
+        u64 r = 1000 + prng.get<u32>() % 100000;
+        model.observeSslj(s, r, 0.3 + 1e-6 * s + 5e-6 * r);
+
+        u64 m = 1000 + prng.get<u32>() % 100000;
+        model.observeMux(m, 0.02 + 2e-6 * m);
+    }
+    if (!close(model.mSslj.mFixed, 0.3) ||
+        !close(model.mSslj.mPerSender, 1e-6) ||
+        !close(model.mSslj.mPerReceiver, 5e-6) ||
+        !close(model.mMux.mFixed, 0.02) ||
+        !close(model.mMux.mPerRow, 2e-6))
+        throw RTE_LOC;
+
+    // only the last mWindow observations count
+    model.mWindow = 8;
+    for (u64 i = 0; i < 8; ++i)
+    {
+        u64 m = 1000 + prng.get<u32>() % 100000;
+        model.observeMux(m, 0.1 + 4e-6 * m);
+    }
+    if (!close(model.mMux.mFixed, 0.1) || !close(model.mMux.mPerRow, 4e-6))
+        throw RTE_LOC;
+
+    // equal sizes repeated are underdetermined, the coefficients are kept
+    CostModel same;
+    for (u64 i = 0; i < 8; ++i)
+        same.observeSslj(5000, 5000, 2.0);
+    if (same.mSslj.mPerSender != defaults.mPerSender ||
+        same.mSslj.mPerReceiver != defaults.mPerReceiver)
+        throw RTE_LOC;
+
+    // Small updates of a large table are incremental. When Y' is as large
+    // as the table, SSLJ (X, Y') and the mux cost more than starting over.
+    CostModel def;
+    const u64 n = 1ull << 20;
+    if (def.rebuild(n, n / 100, n, n / 100) <= def.incremental(n, n / 100, n, n / 100))
+        throw RTE_LOC;
+    if (def.rebuild(n, n / 100, n / 100, n) >= def.incremental(n, n / 100, n / 100, n))
+        throw RTE_LOC;
+
+    // the first update has no previous rows to join
+    if (!close(def.incremental(0, n, 0, n), def.sslj(n, n)))
+        throw RTE_LOC;
+
+    if (cmd.isSet("v"))
+        std::cout << "sslj " << model.mSslj.mFixed << " + " << model.mSslj.mPerSender
+            << " s + " << model.mSslj.mPerReceiver << " r" << std::endl;
+}
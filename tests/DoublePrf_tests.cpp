@@ -121,6 +121,24 @@ void doublePrf_AltMod_test(const oc::CLP& cmd)
                 throw RTE_LOC;
         }
     }
+
+    // the same update with the local half computed up front, on -t threads
+    party0.setNumThreads(cmd.getOr("t", 4));
+    std::vector<oc::block> localPrf(n_update), UID_pre;
+    party0.evalLocal(X_update, localPrf);
+
+    auto pl0 = party0.recv(X_update, localPrf, UID_pre, socket[0]);
+    auto pl1 = party1.send(socket[1]);
+    auto rl = macoro::sync_wait(
+        macoro::when_all_ready(std::move(pl0) | macoro::start_on(pool0),
+                                std::move(pl1) | macoro::start_on(pool1)));
+    std::get<0>(rl).result();
+    std::get<1>(rl).result();
+
+    timer0.setTimePoint("Precomputed update " + to_string(n_update));
+
+    if (UID_pre != UID_update)
+        throw RTE_LOC;
    
     if (cmd.isSet("v")) {
         cout << endl;
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "cryptoTools/Common/Defines.h"
+#include <coproto/Socket/LocalAsyncSocket.h>
+#include <macoro/thread_pool.h>
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <memory>
+#include <system_error>
+#include <vector>
+
+// Byte stream over a LocalAsyncSocket pair that breaks once one end has
+// sent mSendBudget bytes. The breaking end tells the peer, which answers,
+// so both ends fail instead of waiting for each other.
+struct FaultySocket
+{
+    struct State
+    {
+        coproto::Socket mInner;
+        std::vector<oc::u8> mMsg;
+        oc::u64 mMsgPos = 0;
+        oc::u64 mSendBudget = ~0ull;
+        bool mBroken = false;
+    };
+    std::shared_ptr<State> mState;
+
+    static std::error_code broken() 
+    {
+        return std::make_error_code(std::errc::connection_reset); 
+    }
+
+    // every message is a tag byte (0 = data, 1 = broken) and the data
+    macoro::task<std::pair<std::error_code, oc::u64>> send(
+        coproto::span<oc::u8> data, macoro::stop_token = {})
+    {
+        auto& s = *mState;
+        if (s.mBroken)
+            co_return { broken(), 0 };
+
+        if (data.size() >= s.mSendBudget)
+        {
+            s.mBroken = true;
+            co_await s.mInner.send(std::vector<oc::u8>{ 1 });
+            co_return { broken(), 0 };
+        }
+        s.mSendBudget -= data.size();
+
+        std::vector<oc::u8> msg(1 + data.size());
+        std::memcpy(msg.data() + 1, data.data(), data.size());
+        co_await s.mInner.send(std::move(msg));
+        co_return { std::error_code{}, data.size() };
+    }
+
+    macoro::task<std::pair<std::error_code, oc::u64>> recv(
+        coproto::span<oc::u8> data, macoro::stop_token = {})
+    {
+        auto& s = *mState;
+        while (s.mMsgPos == s.mMsg.size())
+        {
+            if (s.mBroken)
+                co_return { broken(), 0 };
+
+            co_await s.mInner.recvResize(s.mMsg);
+            s.mMsgPos = 1;
+            if (s.mMsg[0])
+            {
+                s.mBroken = true;
+                co_await s.mInner.send(std::vector<oc::u8>{ 1 });
+                co_return { broken(), 0 };
+            }
+        }
+
+        auto n = std::min<oc::u64>(data.size(), s.mMsg.size() - s.mMsgPos);
+        std::memcpy(data.data(), s.mMsg.data() + s.mMsgPos, n);
+        s.mMsgPos += n;
+        co_return { std::error_code{}, n };
+    }
+
+    // P_0's end breaks after sending failAfter bytes
+    static std::array<coproto::Socket, 2> makePair(
+        oc::u64 failAfter, macoro::thread_pool& pool0, macoro::thread_pool& pool1)
+    {
+        auto inner = coproto::LocalAsyncSocket::makePair();
+        inner[0].setExecutor(pool0);
+        inner[1].setExecutor(pool1);
+
+        std::array<coproto::Socket, 2> r;
+        for (oc::u64 i = 0; i < 2; ++i)
+        {
+            auto state = std::make_shared<State>();
+            state->mInner = inner[i];
+            state->mSendBudget = i ? ~0ull : failAfter;
+            r[i] = coproto::makeSocket(FaultySocket{ state });
+            r[i].setExecutor(i ? pool1 : pool0);
+        }
+        return r;
+    }
+};
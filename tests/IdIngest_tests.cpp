@@ -0,0 +1,127 @@
+#include "IdIngest.h"
+#include "IdIngest_tests.h"
+#include "cryptoTools/Common/Matrix.h"
+#include "cryptoTools/Crypto/PRNG.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+using namespace oc;
+using namespace uppid;
+
+void idIngest_test(const oc::CLP& cmd)
+{
+    const u64 n = cmd.getOr("n", 1000);
+    const u64 batchSize = cmd.getOr("b", 128);
+    const u64 dataByteSize = 16;
+
+    auto dir = std::filesystem::temp_directory_path() / "uppid_ingest_test";
+    std::filesystem::create_directories(dir);
+    auto path0 = (dir / "p0.csv").string();
+    auto path1 = (dir / "p1.bin").string();
+
+    // P_0: CSV, ids in mixed case with stray spaces, rows [0, n)
+    {
+        std::ofstream f(path0);
+        f << "email,name\n";
+        for (u64 i = 0; i < n; ++i)
+            f << "  User" << i << "@Example.com ,\"name \"\"" << i << "\"\"\"\r\n";
+    }
+
+    // P_1: length-prefixed (email, payload), rows [n/2, n/2 + n)
+    {
+        std::ofstream f(path1, std::ios::binary);
+        auto field = [&](const std::string& s) {
+            u32 len = (u32)s.size();
+            f.write((const char*)&len, sizeof(len));
+            f.write(s.data(), len);
+        };
+        for (u64 i = n / 2; i < n / 2 + n; ++i)
+        {
+            field("user" + std::to_string(i) + "@example.com");
+            field("p" + std::to_string(i));
+        }
+    }
+
+    IngestParams params0;
+    params0.mNormalize = { Normalize::Lower };
+    params0.mBatchSize = batchSize;
+    params0.mNumThreads = 4;
+
+    IngestParams params1 = params0;
+    params1.mFormat = IdFormat::LengthPrefixed;
+    params1.mNumFields = 2;
+    params1.mDataColumns = { 1 };
+
+    // same normalized id, same hash
+    IdHasher hasher;
+    std::vector<std::string> a = { "user1@example.com" };
+    if (hasher.hash(a) == IdHasher("other.domain").hash(a))
+        throw RTE_LOC;
+
+    PRNG prng(oc::ZeroBlock);
+    PseudonymisedDB_P0 db0(dataByteSize, prng.get(), PrfType::AltMod, 1ull << 20);
+    PseudonymisedDB_P1 db1(dataByteSize, prng.get(), PrfType::AltMod, 1ull << 20);
+
+    macoro::thread_pool pool0;
+    auto e0 = pool0.make_work();
+    pool0.create_thread();
+    macoro::thread_pool pool1;
+    auto e1 = pool1.make_work();
+    pool1.create_thread();
+
+    auto socket = coproto::LocalAsyncSocket::makePair();
+    socket[0].setExecutor(pool0);
+    socket[1].setExecutor(pool1);
+
+    {
+        IdFileReader reader0(path0, params0);
+        IdFileReader reader1(path1, params1);
+
+        auto r0 = macoro::sync_wait(macoro::when_all_ready(
+            ingest_P0(db0, reader0, socket[0]) | macoro::start_on(pool0),
+            serveIngest_P1(db1, socket[1]) | macoro::start_on(pool1)));
+        std::get<0>(r0).result();
+        std::get<1>(r0).result();
+
+        auto r1 = macoro::sync_wait(macoro::when_all_ready(
+            serveIngest_P0(db0, socket[0]) | macoro::start_on(pool0),
+            ingest_P1(db1, reader1, socket[1]) | macoro::start_on(pool1)));
+        std::get<0>(r1).result();
+        std::get<1>(r1).result();
+
+        if (reader0.rowsRead() != n || reader1.rowsRead() != n)
+            throw RTE_LOC;
+    }
+
+    auto& uid0 = db0.getUID();
+    auto& uid1 = db1.getUID();
+    auto& data1 = db1.getData();
+    if (uid0.size() != n || uid1.size() != n || data1.rows() != n)
+        throw RTE_LOC;
+
+    // rows are inserted in file order; ids n/2 .. n-1 are common
+    for (u64 i = n / 2; i < n; ++i)
+        if (uid0[i] != uid1[i - n / 2])
+            throw RTE_LOC;
+    if (n > 1 && uid0[0] == uid1[n - 1])
+        throw RTE_LOC;
+
+    for (u64 j = 0; j < n; ++j)
+    {
+        u8 expected[dataByteSize] = {};
+        auto p = "p" + std::to_string(n / 2 + j);
+        std::memcpy(expected, p.data(), std::min<u64>(p.size(), dataByteSize));
+        if (std::memcmp(data1.data(j), expected, dataByteSize))
+            throw RTE_LOC;
+    }
+
+    std::filesystem::remove_all(dir);
+
+    if (cmd.isSet("v"))
+        std::cout << "ingested " << n << " + " << n << " rows, comm "
+                  << double(socket[0].bytesSent() + socket[1].bytesSent()) / 1024 / 1024
+                  << "MB\n";
+}
@@ -0,0 +1,114 @@
+#include "Kernels.h"
+#include "Kernels_tests.h"
+#include "cryptoTools/Common/BitVector.h"
+#include "cryptoTools/Crypto/PRNG.h"
+
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+using namespace oc;
+using namespace uppid;
+
+// The fixed-width copies must agree with the generic one, so widths on both
+// sides of every specialization are checked.
+static void checkKernels(u64 n, PRNG& prng)
+{
+    for (u64 bytes : { 1, 4, 5, 8, 15, 16, 17, 24, 32, 48, 64, 80 })
+    {
+        const u64 bpr = (bytes + 15) / 16;
+        std::vector<u8> rows(n * bytes), back(n * bytes);
+        prng.get(rows.data(), rows.size());
+
+        std::vector<block> packed(n * bpr);
+        prng.get(packed.data(), packed.size());
+        packRows(rows.data(), n, bytes, packed.data());
+
+        for (u64 i = 0; i < n; ++i)
+        {
+            auto p = (const u8*)(packed.data() + i * bpr);
+            if (std::memcmp(p, rows.data() + i * bytes, bytes))
+                throw RTE_LOC;
+            for (u64 j = bytes; j < bpr * 16; ++j)
+                if (p[j])
+                    throw RTE_LOC;
+        }
+
+        unpackRows(packed.data(), n, bytes, back.data());
+        if (rows != back)
+            throw RTE_LOC;
+    }
+
+    // unaligned starts and byte tails
+    for (u64 offset : { 0, 1, 7 })
+    {
+        std::vector<u8> dst(n * 5 + offset), src(n * 5 + offset);
+        prng.get(dst.data(), dst.size());
+        prng.get(src.data(), src.size());
+        auto expected = dst;
+        for (u64 i = offset; i < dst.size(); ++i)
+            expected[i] ^= src[i];
+        xorBytes(dst.data() + offset, src.data() + offset, n * 5);
+        if (dst != expected)
+            throw RTE_LOC;
+    }
+
+    for (u64 bpr = 1; bpr <= 5; ++bpr)
+    {
+        oc::BitVector bits(n);
+        bits.randomize(prng);
+
+        std::vector<block> x0(n * bpr), x1(n * bpr);
+        prng.get(x0.data(), x0.size());
+        prng.get(x1.data(), x1.size());
+
+        auto masked = x0;
+        maskRows(bits.data(), masked.data(), n, bpr);
+
+        auto xored = x0;
+        maskedXorRows(bits.data(), x1.data(), xored.data(), n, bpr);
+
+        std::vector<block> selected(n * bpr);
+        selectRows(bits.data(), x0.data(), x1.data(), selected.data(), n, bpr);
+
+        for (u64 k = 0; k < n * bpr; ++k)
+        {
+            bool b = bits[k / bpr];
+            if (masked[k] != (b ? x0[k] : oc::ZeroBlock) ||
+                xored[k] != (b ? x0[k] ^ x1[k] : x0[k]) ||
+                selected[k] != (b ? x1[k] : x0[k]))
+                throw RTE_LOC;
+        }
+    }
+}
+
+void kernels_test(const oc::CLP& cmd)
+{
+    const u64 n = cmd.getOr("n", 1000) + 3; // odd tail
+    const std::string isa = kernelIsa();
+
+    // every instruction set this CPU runs, and all must expand OT keys alike
+    std::vector<std::vector<block>> expanded;
+    for (auto& name : supportedKernelIsas())
+    {
+        setKernelIsa(name);
+        if (cmd.isSet("v"))
+            std::cout << "kernels: " << kernelIsa() << std::endl;
+
+        PRNG prng(oc::ZeroBlock);
+        checkKernels(n, prng);
+
+        std::vector<block> keys(n), out(n * 3);
+        prng.get(keys.data(), keys.size());
+        expandRows(keys.data(), 1, n, 3, out.data());
+        for (u64 i = 0; i < n; ++i)
+            if (out[i * 3] != keys[i])
+                throw RTE_LOC;
+        expanded.push_back(std::move(out));
+    }
+    setKernelIsa(isa);
+
+    for (auto& e : expanded)
+        if (e != expanded[0])
+            throw RTE_LOC;
+}
@@ -0,0 +1,238 @@
+#include "MultiKeySsLeftJoin.h"
+#include "MultiKeySsLeftJoin_tests.h"
+#include "cryptoTools/Common/Matrix.h"
+#include "cryptoTools/Crypto/PRNG.h"
+#include "cryptoTools/Common/Timer.h"
+
+#include <unordered_map>
+#include <iostream>
+#include <chrono>
+
+using namespace oc;
+using namespace uppid;
+
+namespace
+{
+    // Rows of X share some slots with one row of Y, some slots with
+    // different rows of Y, or nothing. About one identifier in five is
+    // absent. Each row of Y is used once, so the identifiers of X stay
+    // distinct.
+    void makeRows(PRNG& prng, u64 nx, u64 ny, u64 k, Matrix<block>& X, Matrix<block>& Y)
+    {
+        auto randomId = [&] {
+            return prng.get<u8>() % 5 ? prng.get<block>() : oc::ZeroBlock;
+        };
+
+        Y.resize(ny, k);
+        for (auto& y : Y)
+            y = randomId();
+
+        std::vector<u64> perm(ny);
+        for (u64 t = 0; t < ny; ++t)
+            perm[t] = t;
+        for (u64 t = 0; t < ny; ++t)
+            std::swap(perm[t], perm[t + prng.get<u64>() % (ny - t)]);
+        u64 next = 0;
+
+        X.resize(nx, k);
+        for (u64 i = 0; i < nx; ++i)
+        {
+            auto c = prng.get<u8>() % 4;
+            if (next + 2 > ny)
+                c = 3;
+            u64 t0 = 0, t1 = 0;
+            if (c != 3)
+                t0 = perm[next++];
+            if (c == 2)
+                t1 = perm[next++];
+            for (u64 j = 0; j < k; ++j)
+            {
+                if (c == 0 || (c == 1 && prng.getBit()))
+                    X(i, j) = Y(t0, j);
+                else if (c == 2)
+                    X(i, j) = Y(j % 2 ? t1 : t0, j);
+                else
+                    X(i, j) = randomId();
+            }
+        }
+    }
+}
+
+void multiKeySsLeftJoin_test(const oc::CLP& cmd)
+{
+    const u64 nx = cmd.getOr("nx", 1ull << cmd.getOr("nn", 8));
+    const u64 ny = cmd.getOr("ny", nx);
+    const u64 k = cmd.getOr("k", 3);
+    const u64 dataByteSize = cmd.getOr("bs", 16);
+
+    PRNG prng(oc::ZeroBlock);
+
+    Matrix<block> X, Y;
+    makeRows(prng, nx, ny, k, X, Y);
+    Matrix<u8> D(ny, dataByteSize);
+    prng.get<u8>(D.data(), D.size());
+
+    // expected: the Y row matched by the lowest slot
+    std::vector<std::unordered_map<block, u64>> slot(k);
+    for (u64 t = 0; t < ny; ++t)
+        for (u64 j = 0; j < k; ++j)
+            if (Y(t, j) != oc::ZeroBlock)
+                slot[j][Y(t, j)] = t;
+
+    macoro::thread_pool pool0;
+    auto e0 = pool0.make_work();
+    pool0.create_thread();
+    macoro::thread_pool pool1;
+    auto e1 = pool1.make_work();
+    pool1.create_thread();
+
+    auto socket = coproto::LocalAsyncSocket::makePair();
+    socket[0].setExecutor(pool0);
+    socket[1].setExecutor(pool1);
+
+    MultiKeySsLeftJoinReceiver recver;
+    MultiKeySsLeftJoinSender sender;
+    recver.init(dataByteSize, k, prng.get(), 1ull << 16);
+    sender.init(dataByteSize, k, prng.get(), 1ull << 16);
+
+    oc::Timer timer;
+    recver.setTimer(timer);
+    timer.setTimePoint("start");
+
+    BitVector mem0, mem1;
+    Matrix<u8> val0(0, dataByteSize), val1(0, dataByteSize);
+    auto r = macoro::sync_wait(macoro::when_all_ready(
+        recver.recv(X, mem0, val0, socket[0]) | macoro::start_on(pool0),
+        sender.send(Y, D, mem1, val1, socket[1]) | macoro::start_on(pool1)));
+    std::get<0>(r).result();
+    std::get<1>(r).result();
+
+    if (mem0.size() != nx || mem1.size() != nx || val0.rows() != nx || val1.rows() != nx)
+        throw RTE_LOC;
+
+    u64 matches = 0;
+    for (u64 i = 0; i < nx; ++i)
+    {
+        u64 t = ~0ull;
+        for (u64 j = 0; j < k && t == ~0ull; ++j)
+        {
+            auto it = slot[j].find(X(i, j));
+            if (X(i, j) != oc::ZeroBlock && it != slot[j].end())
+                t = it->second;
+        }
+
+        if (bool(mem0[i] ^ mem1[i]) != (t != ~0ull))
+            throw RTE_LOC;
+        for (u64 b = 0; b < dataByteSize; ++b)
+        {
+            u8 expected = t != ~0ull ? D(t, b) : 0;
+            if ((val0(i, b) ^ val1(i, b)) != expected)
+                throw RTE_LOC;
+        }
+        matches += t != ~0ull;
+    }
+
+    if (cmd.isSet("v"))
+    {
+        std::cout << matches << " / " << nx << " rows matched\n" << timer << std::endl;
+        std::cout << "comm "
+            << double(socket[0].bytesSent() + socket[1].bytesSent()) / 1024 / 1024
+            << "MB" << std::endl;
+    }
+}
+
+// The multi-key join against k separate single-key joins, one per slot.
+// The latter is only the join part of that approach; merging its k results
+// would cost about as much again as the combine step.
+void multiKeySsLeftJoin_bench(const oc::CLP& cmd)
+{
+    const u64 nx = cmd.getOr("nx", 1ull << cmd.getOr("nn", 8));
+    const u64 ny = cmd.getOr("ny", nx);
+    const u64 k = cmd.getOr("k", 3);
+    const u64 dataByteSize = cmd.getOr("bs", 16);
+
+    PRNG prng(oc::OneBlock);
+
+    Matrix<block> X, Y;
+    makeRows(prng, nx, ny, k, X, Y);
+    Matrix<u8> D(ny, dataByteSize);
+    prng.get<u8>(D.data(), D.size());
+
+    macoro::thread_pool pool0;
+    auto e0 = pool0.make_work();
+    pool0.create_thread();
+    macoro::thread_pool pool1;
+    auto e1 = pool1.make_work();
+    pool1.create_thread();
+
+    // multi-key
+    auto socket = coproto::LocalAsyncSocket::makePair();
+    socket[0].setExecutor(pool0);
+    socket[1].setExecutor(pool1);
+
+    MultiKeySsLeftJoinReceiver recver;
+    MultiKeySsLeftJoinSender sender;
+    recver.init(dataByteSize, k, prng.get(), 1ull << 16);
+    sender.init(dataByteSize, k, prng.get(), 1ull << 16);
+
+    BitVector mem0, mem1;
+    Matrix<u8> val0(0, dataByteSize), val1(0, dataByteSize);
+    auto begin = std::chrono::steady_clock::now();
+    auto r = macoro::sync_wait(macoro::when_all_ready(
+        recver.recv(X, mem0, val0, socket[0]) | macoro::start_on(pool0),
+        sender.send(Y, D, mem1, val1, socket[1]) | macoro::start_on(pool1)));
+    std::get<0>(r).result();
+    std::get<1>(r).result();
+    double multiSeconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - begin).count();
+    u64 multiBytes = socket[0].bytesSent() + socket[1].bytesSent();
+
+    if (mem0.size() != nx || val0.rows() != nx)
+        throw RTE_LOC;
+
+    // k separate joins, absent identifiers replaced by random dummies
+    auto socket2 = coproto::LocalAsyncSocket::makePair();
+    socket2[0].setExecutor(pool0);
+    socket2[1].setExecutor(pool1);
+
+    SsLeftJoinReceiver slotRecver;
+    SsLeftJoinSender slotSender;
+    slotRecver.init(dataByteSize, prng.get(), 1ull << 16);
+    slotSender.init(dataByteSize, prng.get(), 1ull << 16);
+
+    std::vector<block> Xj(nx), Yj(ny);
+    double slotSeconds = 0;
+    for (u64 j = 0; j < k; ++j)
+    {
+        for (u64 i = 0; i < nx; ++i)
+            Xj[i] = X(i, j) == oc::ZeroBlock ? prng.get<block>() : X(i, j);
+        for (u64 t = 0; t < ny; ++t)
+            Yj[t] = Y(t, j) == oc::ZeroBlock ? prng.get<block>() : Y(t, j);
+
+        BitVector m0, m1;
+        Matrix<u8> v0(0, dataByteSize), v1(0, dataByteSize);
+        begin = std::chrono::steady_clock::now();
+        auto rj = macoro::sync_wait(macoro::when_all_ready(
+            slotRecver.recv(Xj, m0, v0, socket2[0]) | macoro::start_on(pool0),
+            slotSender.send(Yj, D, m1, v1, socket2[1]) | macoro::start_on(pool1)));
+        std::get<0>(rj).result();
+        std::get<1>(rj).result();
+        slotSeconds += std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - begin).count();
+
+        if (m0.size() != nx || v0.rows() != nx)
+            throw RTE_LOC;
+    }
+    u64 slotBytes = socket2[0].bytesSent() + socket2[1].bytesSent();
+
+    if (cmd.isSet("v"))
+    {
+        std::cout << "k = " << k << ", |X| = " << nx << ", |Y| = " << ny
+            << ", bs = " << dataByteSize << "\n"
+            << "multi-key join  " << multiSeconds * 1000 << "ms, "
+            << double(multiBytes) / 1024 / 1024 << "MB\n"
+            << k << " slot joins    " << slotSeconds * 1000 << "ms, "
+            << double(slotBytes) / 1024 / 1024 << "MB (before merging)"
+            << std::endl;
+    }
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+#include "cryptoTools/Common/CLP.h"
+
+void multiKeySsLeftJoin_test(const oc::CLP& cmd);
+void multiKeySsLeftJoin_bench(const oc::CLP& cmd);
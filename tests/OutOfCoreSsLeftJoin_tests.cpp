@@ -0,0 +1,114 @@
+#include "OutOfCoreSsLeftJoin.h"
+#include "OutOfCoreSsLeftJoin_tests.h"
+#include "cryptoTools/Common/Matrix.h"
+#include "cryptoTools/Crypto/PRNG.h"
+#include "cryptoTools/Common/Timer.h"
+
+#include <filesystem>
+#include <unordered_map>
+#include <iostream>
+
+using namespace oc;
+using namespace uppid;
+
+void outOfCoreSsLeftJoin_test(const oc::CLP& cmd)
+{
+    const u64 nx = cmd.getOr("nx", 1ull << cmd.getOr("nn", 10));
+    const u64 ny = cmd.getOr("ny", nx);
+    const u64 dataByteSize = cmd.getOr("bs", 16);
+    const u64 numPartitions = cmd.getOr("k", 4);
+
+    PRNG prng;
+    prng.SetSeed(oc::OneBlock);
+
+    oc::Matrix<oc::u8> D(ny, dataByteSize);
+    prng.get<u8>(D.data(), D.size());
+    std::vector<oc::block> Y(ny);
+    prng.get(Y.data(), ny);
+
+    // half of X is in Y
+    std::vector<oc::block> X(nx);
+    for (u64 i = 0; i < nx; ++i)
+        X[i] = (i % 2 && i / 2 < ny) ? Y[i / 2] : prng.get<oc::block>();
+
+    auto dir = std::filesystem::temp_directory_path() / "uppid_ooc_test";
+    std::filesystem::create_directories(dir);
+    OutOfCoreParams params;
+    params.mWorkDir = dir.string();
+    params.mNumPartitions = numPartitions;
+    auto outR = (dir / "recv").string();
+    auto outS = (dir / "send").string();
+
+    macoro::thread_pool pool0;
+    auto e0 = pool0.make_work();
+    pool0.create_thread();
+    macoro::thread_pool pool1;
+    auto e1 = pool1.make_work();
+    pool1.create_thread();
+
+    auto socket = coproto::LocalAsyncSocket::makePair();
+    socket[0].setExecutor(pool0);
+    socket[1].setExecutor(pool1);
+
+    OutOfCoreSsLeftJoinReceiver recv;
+    OutOfCoreSsLeftJoinSender send;
+    recv.init(dataByteSize, params, prng.get(), 1ull << 20);
+    send.init(dataByteSize, params, prng.get(), 1ull << 20);
+
+    oc::Timer timer;
+    recv.setTimer(timer);
+    timer.setTimePoint("start");
+
+    auto r = macoro::sync_wait(macoro::when_all_ready(
+        recv.recv(X, outR, socket[0]) | macoro::start_on(pool0),
+        send.send(Y, D, outS, socket[1]) | macoro::start_on(pool1)));
+    std::get<0>(r).result();
+    std::get<1>(r).result();
+
+    ///////// Check
+    MappedFile rows(outR + ".rows", MappedFile::Mode::Read);
+    MappedFile memR(outR + ".mem", MappedFile::Mode::Read);
+    MappedFile memS(outS + ".mem", MappedFile::Mode::Read);
+    MappedFile dataR(outR + ".data", MappedFile::Mode::Read);
+    MappedFile dataS(outS + ".data", MappedFile::Mode::Read);
+    if (rows.size() != nx * sizeof(u64) || memR.size() != nx || memS.size() != nx ||
+        dataR.size() != nx * dataByteSize || dataS.size() != nx * dataByteSize)
+        throw RTE_LOC;
+
+    std::unordered_map<oc::block, u64> y2idx;
+    for (u64 j = 0; j < ny; ++j)
+        y2idx[Y[j]] = j;
+
+    auto rowIdx = rows.as<u64>();
+    std::vector<u8> seen(nx, 0);
+    for (u64 i = 0; i < nx; ++i)
+    {
+        auto x = rowIdx[i];
+        if (x >= nx || seen[x]++)
+            throw RTE_LOC;
+
+        bool member = memR.data()[i] ^ memS.data()[i];
+        auto iter = y2idx.find(X[x]);
+        if (member != (iter != y2idx.end()))
+            throw RTE_LOC;
+
+        if (member)
+            for (u64 b = 0; b < dataByteSize; ++b)
+                if ((dataR.data()[i * dataByteSize + b] ^ dataS.data()[i * dataByteSize + b]) !=
+                    D(iter->second, b))
+                    throw RTE_LOC;
+    }
+
+    rows.close(); memR.close(); memS.close(); dataR.close(); dataS.close();
+    std::filesystem::remove_all(dir);
+
+    if (cmd.isSet("v"))
+    {
+        std::cout << std::endl << timer << std::endl;
+        std::cout << "comm "
+                  << double(socket[0].bytesSent()) / 1024 / 1024 << " + "
+                  << double(socket[1].bytesSent()) / 1024 / 1024 << " = "
+                  << double(socket[0].bytesSent() + socket[1].bytesSent()) / 1024 / 1024
+                  << "MB\n";
+    }
+}
@@ -0,0 +1,5 @@
+#pragma once
+
+#include "cryptoTools/Common/CLP.h"
+
+void outOfCoreSsLeftJoin_test(const oc::CLP& cmd);
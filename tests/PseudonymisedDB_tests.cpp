@@ -1,4 +1,9 @@
 #include "PseudonymisedDB.h"
+#include "PseudonymisedDB_tests.h"
+#include "FaultySocket.h"
+#include "Kernels.h"
+#include "ShareExport.h"
+#include "Transcript.h"
 #include "cryptoTools/Common/Matrix.h"
 #include "cryptoTools/Crypto/PRNG.h"
 #include "cryptoTools/Common/Timer.h"
@@ -13,7 +18,13 @@
 
 #include <unordered_map>
 #include <algorithm>
+#include <array>
+#include <filesystem>
+#include <memory>
+#include <system_error>
 #include <set>
+#include <string>
+#include <utility>
 #include <vector>
 #include <iostream>
 
@@ -28,6 +39,61 @@ inline void myShuffle(std::vector<T>& v, oc::PRNG& prng)
     }
 }
 
+void checkCurrentState(
+    PseudonymisedDB_P0& db0,
+    PseudonymisedDB_P1& db1,
+    const std::vector<block>& Xall,
+    const std::vector<block>& Yall,
+    const Matrix<u8>& Dall,
+    u64 dataByteSize)
+{
+    auto mem0 = db0.getMemShare();
+    auto mem1 = db1.getMemShare();
+    auto val0 = db0.getDataShare();
+    auto val1 = db1.getDataShare();
+
+    int count = 0;
+
+    if (mem0.size() != mem1.size()) throw RTE_LOC;
+    if (val0.rows() != val1.rows() || val0.cols() != val1.cols()) throw RTE_LOC;
+
+    // std::cout << "mem0.size() is " << mem0.size() << " Xall.size() is " << Xall.size() << "\n";
+    if (mem0.size() != Xall.size()) throw RTE_LOC;
+    if (val0.rows() != Xall.size()) throw RTE_LOC;
+    if (val0.cols() != dataByteSize) throw RTE_LOC;
+
+    std::unordered_map<block, u64> y2idx;
+    y2idx.reserve(Yall.size() * 2 + 1);
+    for (u64 j = 0; j < Yall.size(); ++j)
+        y2idx[Yall[j]] = j;
+
+    for (u64 i = 0; i < Xall.size(); ++i)
+    {
+        bool inY = (y2idx.find(Xall[i]) != y2idx.end());
+        bool mem = bool(mem0[i] ^ mem1[i]);
+
+        if (mem != inY)
+            throw RTE_LOC;
+        
+
+        if (inY)
+        {
+            u64 j = y2idx[Xall[i]];
+            for (u64 b = 0; b < dataByteSize; ++b)
+            {
+                u8 v = val0(i, b) ^ val1(i, b);
+                if (v != Dall(j, b)){
+                    std::cout << "i is " << i << '\n';
+                    throw RTE_LOC;
+                }
+            }
+            count++;
+        }
+
+    }
+
+}
+
 namespace
 {
 
@@ -74,61 +140,6 @@ namespace
         dst = std::move(tmp);
     }
 
-    void checkCurrentState(
-        PseudonymisedDB_P0& db0,
-        PseudonymisedDB_P1& db1,
-        const std::vector<block>& Xall,
-        const std::vector<block>& Yall,
-        const Matrix<u8>& Dall,
-        u64 dataByteSize)
-    {
-        auto mem0 = db0.getMemShare();
-        auto mem1 = db1.getMemShare();
-        auto val0 = db0.getDataShare();
-        auto val1 = db1.getDataShare();
-
-        int count = 0;
-
-        if (mem0.size() != mem1.size()) throw RTE_LOC;
-        if (val0.rows() != val1.rows() || val0.cols() != val1.cols()) throw RTE_LOC;
-
-        // std::cout << "mem0.size() is " << mem0.size() << " Xall.size() is " << Xall.size() << "\n";
-        if (mem0.size() != Xall.size()) throw RTE_LOC;
-        if (val0.rows() != Xall.size()) throw RTE_LOC;
-        if (val0.cols() != dataByteSize) throw RTE_LOC;
-
-        std::unordered_map<block, u64> y2idx;
-        y2idx.reserve(Yall.size() * 2 + 1);
-        for (u64 j = 0; j < Yall.size(); ++j)
-            y2idx[Yall[j]] = j;
-
-        for (u64 i = 0; i < Xall.size(); ++i)
-        {
-            bool inY = (y2idx.find(Xall[i]) != y2idx.end());
-            bool mem = bool(mem0[i] ^ mem1[i]);
-
-            if (mem != inY)
-                throw RTE_LOC;
-            
-
-            if (inY)
-            {
-                u64 j = y2idx[Xall[i]];
-                for (u64 b = 0; b < dataByteSize; ++b)
-                {
-                    u8 v = val0(i, b) ^ val1(i, b);
-                    if (v != Dall(j, b)){
-                        std::cout << "i is " << i << '\n';
-                        throw RTE_LOC;
-                    }
-                }
-                count++;
-            }
-
-        }
-
-    }
-
     // Generate X, Y, and D:
     //  - Y is unique (no duplicates).
     //  - Construct X so that some elements intersect with Y, and the rest are fresh.
@@ -224,6 +235,63 @@ namespace
         myShuffle(Xout, prng);
 
     }
+
+    // Replace up to k identifiers of Yu that are not in Xu by rows of Xall
+    // that match nothing in usedY, so that SSLJ (X, Y') finds matches.
+    // makeBatch alone keeps Y' away from the previous X.
+    void matchPreviousX(
+        const std::vector<block>& Xall,
+        const std::set<block>& usedY,
+        const std::vector<block>& Xu,
+        u64 k,
+        std::vector<block>& Yu)
+    {
+        std::set<block> inXu(Xu.begin(), Xu.end());
+        u64 j = 0;
+        for (u64 i = 0; i < Xall.size() && k; ++i)
+        {
+            if (usedY.count(Xall[i]))
+                continue;
+            while (j < Yu.size() && inXu.count(Yu[j]))
+                ++j;
+            if (j == Yu.size())
+                break;
+            Yu[j++] = Xall[i];
+            --k;
+        }
+    }
+
+    // Two parties on a thread each, over a local socket pair.
+    struct TwoParties
+    {
+        using Work = decltype(std::declval<macoro::thread_pool&>().make_work());
+
+        macoro::thread_pool mPool0, mPool1;
+        Work mWork0 = mPool0.make_work();
+        Work mWork1 = mPool1.make_work();
+        std::array<coproto::Socket, 2> socket;
+
+        TwoParties()
+        {
+            mPool0.create_thread();
+            mPool1.create_thread();
+            auto s = coproto::LocalAsyncSocket::makePair();
+            s[0].setExecutor(mPool0);
+            s[1].setExecutor(mPool1);
+            socket = { s[0], s[1] };
+        }
+
+        // p0 on party 0's thread and p1 on party 1's, rethrows a failure of either
+        template <typename P0, typename P1>
+        void run(P0&& p0, P1&& p1)
+        {
+            auto r = macoro::sync_wait(macoro::when_all_ready(
+                p0() | macoro::start_on(mPool0),
+                p1() | macoro::start_on(mPool1)));
+            std::get<0>(r).result();
+            std::get<1>(r).result();
+        }
+    };
 }
 
 void pseudonymisedDB_test(const oc::CLP& cmd)
@@ -274,6 +342,16 @@ void pseudonymisedDB_test(const oc::CLP& cmd)
     PseudonymisedDB_P0 db0(dataByteSize, prng.get(), PrfType::AltMod, 1ull << 20);
     PseudonymisedDB_P1 db1(dataByteSize, prng.get(), PrfType::AltMod, 1ull << 20);
 
+    // -thp 1: transparent, -thp 2: explicit huge pages; -numa <node>
+    AllocPolicy policy;
+    policy.mHugePages = HugePages(cmd.getOr("thp", 0));
+    policy.mNumaNode = cmd.getOr("numa", AllocPolicy::AnyNode);
+    db0.setAllocPolicy(policy);
+    db1.setAllocPolicy(policy);
+
+    // -wan: fewer rounds, see setWanMode
+    db0.setWanMode(cmd.isSet("wan"));
+    db1.setWanMode(cmd.isSet("wan"));
     
     double AccumulateComm = 0;
     timer.setTimePoint("start");
@@ -448,5 +526,1022 @@ void pseudonymisedDB_test(const oc::CLP& cmd)
                   << double(socket[1].bytesSent()) / 1024.0 / 1024.0 << " = "
                   << double(socket[0].bytesSent() + socket[1].bytesSent()) / 1024.0 / 1024.0
                   << "MB\n";
+        std::cout << "kernels: " << kernelIsa() << "\n";
+        std::cout << "pages P0: " << toString(db0.pageReport()) << "\n";
+        std::cout << "pages P1: " << toString(db1.pageReport()) << "\n";
+    }
+}
+void pseudonymisedDB_keyRotation_test(const oc::CLP& cmd)
+{
+    const u64 n = cmd.getOr("n", 1000);
+    const u64 dataByteSize = cmd.getOr("bs", 16);
+    const u64 chunkSize = cmd.getOr("chunk", 300);
+
+    PRNG prng;
+    prng.SetSeed(oc::ZeroBlock);
+
+    std::vector<block> Xall, Yall;
+    Matrix<u8> Dall;
+    makeBatch(n, n, dataByteSize, 0.25, prng, {}, {}, Xall, Yall, Dall);
+
+    TwoParties parties;
+    auto& socket = parties.socket;
+
+    PseudonymisedDB_P0 db0(dataByteSize, prng.get(), PrfType::AltMod, 1ull << 16);
+    PseudonymisedDB_P1 db1(dataByteSize, prng.get(), PrfType::AltMod, 1ull << 16);
+
+    auto insert = [&](std::vector<block> X, std::vector<block> Y, Matrix<u8> D) {
+        parties.run([&]() -> Proto {
+            co_await db0.insertID(X, socket[0]);
+            co_await db0.respondOPRF(socket[0]);
+        }, [&]() -> Proto {
+            co_await db1.respondOPRF(socket[1]);
+            co_await db1.insertID(Y, D, socket[1]);
+        });
+        parties.run([&]() -> Proto {
+            co_await db0.shareUpdate_P0(socket[0]);
+        }, [&]() -> Proto {
+            co_await db1.shareUpdate_P1(socket[1]);
+        });
+    };
+
+    insert(Xall, Yall, Dall);
+    checkCurrentState(db0, db1, Xall, Yall, Dall, dataByteSize);
+
+    auto uid0 = db0.getUID();
+    auto uid1 = db1.getUID();
+    auto mem0 = db0.getMemShare();
+    Matrix<u8> data0 = db0.getDataShare();
+
+    // a rotation that breaks off in the middle changes nothing
+    auto healthy = socket;
+    socket = FaultySocket::makePair(4096, parties.mPool0, parties.mPool1);
+    bool failed = false;
+    try {
+        parties.run([&]() -> Proto {
+            co_await db0.rotateKey(socket[0], chunkSize, 2);
+        }, [&]() -> Proto {
+            co_await db1.rotateKey(socket[1], chunkSize, 2);
+        });
+    }
+    catch (...) { failed = true; }
+    socket = healthy;
+    if (!failed || db0.getUID() != uid0 || db1.getUID() != uid1)
+        throw RTE_LOC;
+
+    parties.run([&]() -> Proto {
+        co_await db0.rotateKey(socket[0], chunkSize, 2);
+    }, [&]() -> Proto {
+        co_await db1.rotateKey(socket[1], chunkSize, 2);
+    });
+
+    // every UID changes, the shares stay as they are
+    for (u64 i = 0; i < uid0.size(); ++i)
+        if (uid0[i] == db0.getUID()[i])
+            throw RTE_LOC;
+    for (u64 i = 0; i < uid1.size(); ++i)
+        if (uid1[i] == db1.getUID()[i])
+            throw RTE_LOC;
+    if (!(mem0 == db0.getMemShare()) ||
+        std::memcmp(data0.data(), db0.getDataShare().data(), data0.size()))
+        throw RTE_LOC;
+
+    // equal identifiers still have equal UIDs
+    std::unordered_map<block, u64> y2idx;
+    for (u64 j = 0; j < Yall.size(); ++j)
+        y2idx[Yall[j]] = j;
+    for (u64 i = 0; i < Xall.size(); ++i)
+    {
+        auto it = y2idx.find(Xall[i]);
+        if ((it != y2idx.end()) != 
+            (std::find(db1.getUID().begin(), db1.getUID().end(), db0.getUID()[i]) != db1.getUID().end()))
+            throw RTE_LOC;
+        if (it != y2idx.end() && db0.getUID()[i] != db1.getUID()[it->second])
+            throw RTE_LOC;
+    }
+
+    // New identifiers go through both key epochs and must match the rotated
+    // UIDs of the other party: P_0 adds members of Y, P_1 members of X.
+    std::set<block> inX(Xall.begin(), Xall.end()), inY(Yall.begin(), Yall.end());
+    std::vector<block> Xu, Yu;
+    for (auto& y : Yall)
+        if (!inX.count(y) && Xu.size() < n / 10)
+            Xu.push_back(y);
+    for (auto& x : Xall)
+        if (!inY.count(x) && Yu.size() < n / 10)
+            Yu.push_back(x);
+    for (u64 i = 0; i < n / 10; ++i)
+        Xu.push_back(prng.get<block>());
+    Matrix<u8> Du(Yu.size(), dataByteSize);
+    prng.get<u8>(Du.data(), Du.size());
+
+    insert(Xu, Yu, Du);
+
+    Xall.insert(Xall.end(), Xu.begin(), Xu.end());
+    Yall.insert(Yall.end(), Yu.begin(), Yu.end());
+    appendRows(Dall, Du);
+    checkCurrentState(db0, db1, Xall, Yall, Dall, dataByteSize);
+
+    // retire both epochs for one fresh key, re-deriving every UID
+    uid0 = db0.getUID();
+    parties.run([&]() -> Proto {
+        co_await db0.compactKeys(Xall, socket[0]);
+    }, [&]() -> Proto {
+        co_await db1.compactKeys(Yall, socket[1]);
+    });
+    for (u64 i = 0; i < uid0.size(); ++i)
+        if (uid0[i] == db0.getUID()[i])
+            throw RTE_LOC;
+    checkCurrentState(db0, db1, Xall, Yall, Dall, dataByteSize);
+
+    // new identifiers now take one OPRF and still match the old rows
+    std::vector<block> Xc, Yc;
+    for (u64 i = 0; i < n / 10; ++i)
+    {
+        Xc.push_back(prng.get<block>());
+        Yc.push_back(Xc.back());
+    }
+    for (u64 i = 0, added = 0; i < Xall.size() && added < n / 10; ++i)
+        if (!y2idx.count(Xall[i]) && std::find(Yu.begin(), Yu.end(), Xall[i]) == Yu.end())
+            Yc.push_back(Xall[i]), ++added;
+    Matrix<u8> Dc(Yc.size(), dataByteSize);
+    prng.get<u8>(Dc.data(), Dc.size());
+
+    insert(Xc, Yc, Dc);
+
+    Xall.insert(Xall.end(), Xc.begin(), Xc.end());
+    Yall.insert(Yall.end(), Yc.begin(), Yc.end());
+    appendRows(Dall, Dc);
+    checkCurrentState(db0, db1, Xall, Yall, Dall, dataByteSize);
+}
+
+void pseudonymisedDB_count_test(const oc::CLP& cmd)
+{
+    const u64 n = cmd.getOr("n", 1000);
+    const u64 dataByteSize = cmd.getOr("bs", 16);
+
+    PRNG prng;
+    prng.SetSeed(oc::ZeroBlock);
+
+    std::vector<block> X, Y;
+    Matrix<u8> D;
+    makeBatch(n, n, dataByteSize, 0.25, prng, {}, {}, X, Y, D);
+
+    TwoParties parties;
+    auto& socket = parties.socket;
+
+    PseudonymisedDB_P0 db0(dataByteSize, prng.get(), PrfType::AltMod, 1ull << 16);
+    PseudonymisedDB_P1 db1(dataByteSize, prng.get(), PrfType::AltMod, 1ull << 16);
+
+    parties.run([&]() -> Proto {
+        co_await db0.insertID(X, socket[0]);
+        co_await db0.respondOPRF(socket[0]);
+    }, [&]() -> Proto {
+        co_await db1.respondOPRF(socket[1]);
+        co_await db1.insertID(Y, D, socket[1]);
+    });
+
+    std::set<block> inY(Y.begin(), Y.end());
+    u64 expected = 0;
+    for (auto& x : X)
+        expected += inY.count(x);
+
+    u64 count0, count1;
+    BitVector mem0, mem1;
+    auto bytesBefore = socket[0].bytesSent() + socket[1].bytesSent();
+    parties.run([&]() -> Proto {
+        co_await db0.countMatches_P0(count0, socket[0]);
+    }, [&]() -> Proto {
+        co_await db1.countMatches_P1(count1, socket[1]);
+    });
+    auto countBytes = socket[0].bytesSent() + socket[1].bytesSent() - bytesBefore;
+
+    if (count0 + count1 != expected)
+        throw RTE_LOC;
+
+    parties.run([&]() -> Proto {
+        co_await db0.membershipShares_P0(mem0, socket[0]);
+    }, [&]() -> Proto {
+        co_await db1.membershipShares_P1(mem1, socket[1]);
+    });
+
+    if (mem0.size() != X.size() || mem1.size() != X.size())
+        throw RTE_LOC;
+    for (u64 i = 0; i < X.size(); ++i)
+        if ((mem0[i] ^ mem1[i]) != (bool)inY.count(X[i]))
+            throw RTE_LOC;
+
+    // the tables are left alone
+    if (db0.getMemShare().size() || db1.getMemShare().size())
+        throw RTE_LOC;
+
+    bytesBefore = socket[0].bytesSent() + socket[1].bytesSent();
+    parties.run([&]() -> Proto {
+        co_await db0.shareUpdate_P0(socket[0]);
+    }, [&]() -> Proto {
+        co_await db1.shareUpdate_P1(socket[1]);
+    });
+    auto updateBytes = socket[0].bytesSent() + socket[1].bytesSent() - bytesBefore;
+    checkCurrentState(db0, db1, X, Y, D, dataByteSize);
+
+    if (cmd.isSet("v"))
+        std::cout << "count comm " << double(countBytes) / 1024 / 1024 << "MB"
+                  << ", shareUpdate comm " << double(updateBytes) / 1024 / 1024 << "MB\n";
+}
+
+void pseudonymisedDB_resume_test(const oc::CLP& cmd)
+{
+    const u64 n = cmd.getOr("n", 1000);
+    const u64 dataByteSize = cmd.getOr("bs", 16);
+
+    PRNG prng;
+    prng.SetSeed(oc::ZeroBlock);
+
+    macoro::thread_pool pool0;
+    auto e0 = pool0.make_work();
+    pool0.create_thread();
+
+    macoro::thread_pool pool1;
+    auto e1 = pool1.make_work();
+    pool1.create_thread();
+
+    std::array<coproto::Socket, 2> socket;
+    auto reconnect = [&] {
+        auto s = coproto::LocalAsyncSocket::makePair();
+        s[0].setExecutor(pool0);
+        s[1].setExecutor(pool1);
+        socket = { s[0], s[1] };
+    };
+    reconnect();
+
+    PseudonymisedDB_P0 db0(dataByteSize, prng.get(), PrfType::AltMod, 1ull << 16);
+    PseudonymisedDB_P1 db1(dataByteSize, prng.get(), PrfType::AltMod, 1ull << 16);
+
+    // false if either party failed
+    auto run = [&](auto p0, auto p1) {
+        auto r = macoro::sync_wait(macoro::when_all_ready(
+            p0() | macoro::start_on(pool0),
+            p1() | macoro::start_on(pool1)));
+        bool ok = true;
+        try { std::get<0>(r).result(); } catch (...) { ok = false; }
+        try { std::get<1>(r).result(); } catch (...) { ok = false; }
+        return ok;
+    };
+
+    auto update = [&] {
+        return run([&]() -> Proto {
+            co_await db0.shareUpdate_P0(socket[0]);
+        }, [&]() -> Proto {
+            co_await db1.shareUpdate_P1(socket[1]);
+        });
+    };
+
+    std::set<block> usedX, usedY;
+    std::vector<block> Xall, Yall;
+    Matrix<u8> Dall(0, dataByteSize);
+    auto insert = [&] {
+        std::vector<block> X, Y;
+        Matrix<u8> D;
+        makeBatch(n, n, dataByteSize, 0.25, prng, usedX, usedY, X, Y, D);
+        matchPreviousX(Xall, usedY, X, n / 10, Y);
+        usedX.insert(X.begin(), X.end());
+        usedY.insert(Y.begin(), Y.end());
+        Xall.insert(Xall.end(), X.begin(), X.end());
+        Yall.insert(Yall.end(), Y.begin(), Y.end());
+        appendRows(Dall, D);
+
+        if (!run([&]() -> Proto {
+            co_await db0.insertID(X, socket[0]);
+            co_await db0.respondOPRF(socket[0]);
+        }, [&]() -> Proto {
+            co_await db1.respondOPRF(socket[1]);
+            co_await db1.insertID(Y, D, socket[1]);
+        }))
+            throw RTE_LOC;
+    };
+
+    u64 countId, id1;
+    if (!run([&]() -> Proto {
+        co_await db0.registerAggregate_P0({ AggregateOp::Count }, countId, socket[0]);
+    }, [&]() -> Proto {
+        co_await db1.registerAggregate_P1({ AggregateOp::Count }, id1, socket[1]);
+    }))
+        throw RTE_LOC;
+
+    insert();
+    auto before = socket[0].bytesSent();
+    if (!update())
+        throw RTE_LOC;
+    const u64 updateBytes = socket[0].bytesSent() - before;
+    checkCurrentState(db0, db1, Xall, Yall, Dall, dataByteSize);
+
+    // break the connection early, in the middle and late in the update
+    for (auto failAfter : { u64(16), updateBytes / 3, updateBytes * 9 / 10 })
+    {
+        insert();
+        auto rows = db0.getMemShare().size();
+
+        socket = FaultySocket::makePair(failAfter, pool0, pool1);
+        if (update())
+            throw RTE_LOC;
+        // at most one party got to commit
+        auto epoch0 = db0.updateEpoch(), epoch1 = db1.updateEpoch();
+        if (std::max(epoch0, epoch1) - std::min(epoch0, epoch1) > 1)
+            throw RTE_LOC;
+
+        if (cmd.isSet("v"))
+            std::cout << "failed after " << failAfter << " bytes, steps done "
+                      << int(db0.pendingSteps()) << " / " << int(db1.pendingSteps()) << "\n";
+
+        // without a commit the pending rows sit behind the committed ones
+        if (db0.hasPendingUpdate() && db0.getMemShare().size() < rows)
+            throw RTE_LOC;
+
+        reconnect();
+        if (!update())
+            throw RTE_LOC;
+        if (db0.hasPendingUpdate() || db1.hasPendingUpdate() ||
+            db0.updateEpoch() != db1.updateEpoch())
+            throw RTE_LOC;
+
+        checkCurrentState(db0, db1, Xall, Yall, Dall, dataByteSize);
+
+        u64 count0, count1;
+        if (!run([&]() -> Proto {
+            co_await db0.revealAggregate(countId, count0, socket[0]);
+        }, [&]() -> Proto {
+            co_await db1.revealAggregate(countId, count1, socket[1]);
+        }))
+            throw RTE_LOC;
+
+        u64 expected = 0;
+        for (auto& x : Xall)
+            expected += usedY.count(x);
+        if (count0 != expected || count1 != expected)
+            throw RTE_LOC;
     }
-}
\ No newline at end of file
+}
+
+void pseudonymisedDB_rebuild_test(const oc::CLP& cmd)
+{
+    const u64 n = cmd.getOr("n", 1000);
+    const u64 dataByteSize = cmd.getOr("bs", 16);
+
+    PRNG prng;
+    prng.SetSeed(oc::ZeroBlock);
+
+    TwoParties parties;
+    auto& socket = parties.socket;
+
+    PseudonymisedDB_P0 db0(dataByteSize, prng.get(), PrfType::AltMod, 1ull << 16);
+    PseudonymisedDB_P1 db1(dataByteSize, prng.get(), PrfType::AltMod, 1ull << 16);
+
+    u64 id0, id1;
+    parties.run([&]() -> Proto {
+        co_await db0.registerAggregate_P0({ AggregateOp::Count }, id0, socket[0]);
+    }, [&]() -> Proto {
+        co_await db1.registerAggregate_P1({ AggregateOp::Count }, id1, socket[1]);
+    });
+
+    std::vector<block> Xall, Yall;
+    Matrix<u8> Dall(0, dataByteSize);
+    std::set<block> usedX, usedY;
+
+    // incremental, rebuild, rebuild, then whatever the model picks
+    std::vector<UpdatePolicy> policies = {
+        UpdatePolicy::Incremental, UpdatePolicy::Rebuild, UpdatePolicy::Rebuild, UpdatePolicy::Auto };
+    for (u64 u = 0; u < policies.size(); ++u)
+    {
+        std::vector<block> Xu, Yu;
+        Matrix<u8> Du;
+        auto size = u ? n / 4 : n;
+        makeBatch(size, size, dataByteSize, 0.25, prng, usedX, usedY, Xu, Yu, Du);
+        usedX.insert(Xu.begin(), Xu.end());
+        usedY.insert(Yu.begin(), Yu.end());
+
+        db0.setUpdatePolicy(policies[u]);
+        parties.run([&]() -> Proto {
+            co_await db0.insertID(Xu, socket[0]);
+            co_await db0.respondOPRF(socket[0]);
+            co_await db0.shareUpdate_P0(socket[0]);
+        }, [&]() -> Proto {
+            co_await db1.respondOPRF(socket[1]);
+            co_await db1.insertID(Yu, Du, socket[1]);
+            co_await db1.shareUpdate_P1(socket[1]);
+        });
+
+        Xall.insert(Xall.end(), Xu.begin(), Xu.end());
+        Yall.insert(Yall.end(), Yu.begin(), Yu.end());
+        appendRows(Dall, Du);
+        checkCurrentState(db0, db1, Xall, Yall, Dall, dataByteSize);
+
+        auto& m0 = db0.lastUpdateMetrics();
+        auto& m1 = db1.lastUpdateMetrics();
+        if (m0.mRebuild != m1.mRebuild ||
+            m0.mPrevRows != m1.mPrevRows || m0.mNewRows != m1.mNewRows ||
+            m0.mPrevYSize != m1.mPrevYSize || m0.mNewYSize != m1.mNewYSize ||
+            m0.mNewRows != Xu.size() || m1.mNewYSize != Yu.size() ||
+            m0.mKernelIsa != kernelIsa() || m1.mKernelIsa != kernelIsa())
+            throw RTE_LOC;
+        if (policies[u] != UpdatePolicy::Auto &&
+            m0.mRebuild != (policies[u] == UpdatePolicy::Rebuild))
+            throw RTE_LOC;
+
+        // the count survives both ways of updating
+        u64 c0, c1;
+        parties.run([&]() -> Proto {
+            co_await db0.revealAggregate(id0, c0, socket[0]);
+        }, [&]() -> Proto {
+            co_await db1.revealAggregate(id1, c1, socket[1]);
+        });
+        std::set<block> inY(Yall.begin(), Yall.end());
+        u64 expected = 0;
+        for (auto& x : Xall)
+            expected += inY.count(x);
+        if (c0 != expected || c1 != expected)
+            throw RTE_LOC;
+
+        if (cmd.isSet("v"))
+            std::cout << "update " << u << (m0.mRebuild ? " rebuild" : " incremental")
+                << " predicted " << m0.mIncrementalCost << " / " << m0.mRebuildCost
+                << " took " << m0.mSeconds << "s on " << m0.mKernelIsa << "\n";
+    }
+}
+
+void pseudonymisedDB_ownPayload_test(const oc::CLP& cmd)
+{
+    const u64 n = cmd.getOr("n", 1000);
+    const u64 dataByteSize = cmd.getOr("bs", 16);
+    const u64 ownByteSize = cmd.getOr("obs", 12);
+
+    PRNG prng;
+    prng.SetSeed(oc::ZeroBlock);
+
+    TwoParties parties;
+    auto& socket = parties.socket;
+
+    PseudonymisedDB_P0 db0(dataByteSize, prng.get(), PrfType::AltMod, 1ull << 16, ownByteSize);
+    PseudonymisedDB_P1 db1(dataByteSize, prng.get(), PrfType::AltMod, 1ull << 16, ownByteSize);
+
+    std::vector<block> Xall, Yall;
+    Matrix<u8> Dall(0, dataByteSize), Eall(0, ownByteSize);
+    std::set<block> usedX, usedY;
+
+    // the first update, an incremental one and a rebuild
+    std::vector<UpdatePolicy> policies = {
+        UpdatePolicy::Incremental, UpdatePolicy::Incremental, UpdatePolicy::Rebuild };
+    for (u64 u = 0; u < policies.size(); ++u)
+    {
+        std::vector<block> Xu, Yu;
+        Matrix<u8> Du;
+        auto size = u ? n / 4 : n;
+        makeBatch(size, size, dataByteSize, 0.25, prng, usedX, usedY, Xu, Yu, Du);
+        usedX.insert(Xu.begin(), Xu.end());
+        usedY.insert(Yu.begin(), Yu.end());
+
+        Matrix<u8> Eu(Xu.size(), ownByteSize);
+        prng.get<u8>(Eu.data(), Eu.size());
+
+        db0.setUpdatePolicy(policies[u]);
+        parties.run([&]() -> Proto {
+            co_await db0.insertID(Xu, Eu, socket[0]);
+            co_await db0.respondOPRF(socket[0]);
+            co_await db0.shareUpdate_P0(socket[0]);
+        }, [&]() -> Proto {
+            co_await db1.respondOPRF(socket[1]);
+            co_await db1.insertID(Yu, Du, socket[1]);
+            co_await db1.shareUpdate_P1(socket[1]);
+        });
+
+        Xall.insert(Xall.end(), Xu.begin(), Xu.end());
+        Yall.insert(Yall.end(), Yu.begin(), Yu.end());
+        appendRows(Dall, Du);
+        appendRows(Eall, Eu);
+        checkCurrentState(db0, db1, Xall, Yall, Dall, dataByteSize);
+
+        // P_0's payloads are in the rows of X, matched or not
+        auto& s0 = db0.getOwnDataShare();
+        auto& s1 = db1.getOwnDataShare();
+        if (s0.rows() != Xall.size() || s1.rows() != Xall.size() ||
+            s0.cols() != ownByteSize || s1.cols() != ownByteSize)
+            throw RTE_LOC;
+        for (u64 i = 0; i < Eall.size(); ++i)
+            if ((s0.data()[i] ^ s1.data()[i]) != Eall.data()[i])
+                throw RTE_LOC;
+
+        // P_1's share on its own says nothing
+        if (Eall.size() && std::memcmp(s1.data(), Eall.data(), Eall.size()) == 0)
+            throw RTE_LOC;
+    }
+}
+
+void pseudonymisedDB_innerJoin_test(const oc::CLP& cmd)
+{
+    const u64 n = cmd.getOr("n", 1000);
+    const u64 dataByteSize = cmd.getOr("bs", 16);
+    const u64 ownByteSize = cmd.getOr("obs", 4);
+
+    PRNG prng;
+    prng.SetSeed(oc::ZeroBlock);
+
+    TwoParties parties;
+    auto& socket = parties.socket;
+
+    PseudonymisedDB_P0 db0(dataByteSize, prng.get(), PrfType::AltMod, 1ull << 16, ownByteSize);
+    PseudonymisedDB_P1 db1(dataByteSize, prng.get(), PrfType::AltMod, 1ull << 16, ownByteSize);
+
+    // two updates, in the second some rows of the first X match Y'
+    std::vector<block> X, Y;
+    Matrix<u8> D(0, dataByteSize), E(0, ownByteSize);
+    std::set<block> usedX, usedY;
+    for (u64 u = 0; u < 2; ++u)
+    {
+        std::vector<block> Xu, Yu;
+        Matrix<u8> Du;
+        makeBatch(n, n, dataByteSize, 0.1, prng, usedX, usedY, Xu, Yu, Du);
+        matchPreviousX(X, usedY, Xu, n / 10, Yu);
+        usedX.insert(Xu.begin(), Xu.end());
+        usedY.insert(Yu.begin(), Yu.end());
+        Matrix<u8> Eu(Xu.size(), ownByteSize);
+        prng.get<u8>(Eu.data(), Eu.size());
+
+        parties.run([&]() -> Proto {
+            co_await db0.insertID(Xu, Eu, socket[0]);
+            co_await db0.respondOPRF(socket[0]);
+            co_await db0.shareUpdate_P0(socket[0]);
+        }, [&]() -> Proto {
+            co_await db1.respondOPRF(socket[1]);
+            co_await db1.insertID(Yu, Du, socket[1]);
+            co_await db1.shareUpdate_P1(socket[1]);
+        });
+
+        X.insert(X.end(), Xu.begin(), Xu.end());
+        Y.insert(Y.end(), Yu.begin(), Yu.end());
+        appendRows(D, Du);
+        appendRows(E, Eu);
+    }
+
+    Matrix<u8> rows0, rows1;
+    u64 count0, count1;
+    parties.run([&]() -> Proto {
+        co_await db0.innerJoin_P0(rows0, count0, socket[0]);
+    }, [&]() -> Proto {
+        co_await db1.innerJoin_P1(rows1, count1, socket[1]);
+    });
+
+    // p_y || p_x of every x in Y, in some order
+    std::unordered_map<block, u64> y2idx;
+    for (u64 j = 0; j < Y.size(); ++j)
+        y2idx[Y[j]] = j;
+    std::vector<std::string> expected, got;
+    for (u64 i = 0; i < X.size(); ++i)
+    {
+        auto it = y2idx.find(X[i]);
+        if (it == y2idx.end())
+            continue;
+        expected.emplace_back(std::string((const char*)D.data(it->second), dataByteSize) +
+            std::string((const char*)E.data(i), ownByteSize));
+    }
+
+    if (count0 != expected.size() || count1 != expected.size() ||
+        rows0.rows() != count0 || rows1.rows() != count1 ||
+        rows0.cols() != dataByteSize + ownByteSize)
+        throw RTE_LOC;
+    for (u64 i = 0; i < count0; ++i)
+    {
+        std::string row(rows0.cols(), 0);
+        for (u64 b = 0; b < rows0.cols(); ++b)
+            row[b] = char(rows0(i, b) ^ rows1(i, b));
+        got.push_back(std::move(row));
+    }
+    std::sort(expected.begin(), expected.end());
+    std::sort(got.begin(), got.end());
+    if (expected != got)
+        throw RTE_LOC;
+}
+
+void pseudonymisedDB_wan_test(const oc::CLP& cmd)
+{
+    const u64 n = cmd.getOr("n", 1000);
+    const u64 dataByteSize = cmd.getOr("bs", 16);
+    const u64 ownByteSize = cmd.getOr("obs", 4);
+
+    // the first update, an incremental one and a rebuild
+    std::vector<UpdatePolicy> policies = {
+        UpdatePolicy::Incremental, UpdatePolicy::Incremental, UpdatePolicy::Rebuild };
+
+    // flights of both parties over all updates, default and WAN mode
+    std::array<u64, 2> totalFlights{};
+    for (bool wan : { false, true })
+    {
+        PRNG prng;
+        prng.SetSeed(oc::ZeroBlock);
+
+        TwoParties parties;
+        auto stats0 = std::make_shared<TranscriptStats>();
+        auto stats1 = std::make_shared<TranscriptStats>();
+        Socket chl0 = makeRecordingSocket(parties.socket[0], {}, stats0);
+        Socket chl1 = makeRecordingSocket(parties.socket[1], {}, stats1);
+        chl0.setExecutor(parties.mPool0);
+        chl1.setExecutor(parties.mPool1);
+
+        PseudonymisedDB_P0 db0(dataByteSize, prng.get(), PrfType::AltMod, 1ull << 16, ownByteSize);
+        PseudonymisedDB_P1 db1(dataByteSize, prng.get(), PrfType::AltMod, 1ull << 16, ownByteSize);
+        db0.setWanMode(wan);
+        db1.setWanMode(wan);
+        db0.setTranscriptStats(stats0);
+        db1.setTranscriptStats(stats1);
+
+        std::vector<block> Xall, Yall;
+        Matrix<u8> Dall(0, dataByteSize), Eall(0, ownByteSize);
+        std::set<block> usedX, usedY;
+        for (u64 u = 0; u < policies.size(); ++u)
+        {
+            std::vector<block> Xu, Yu;
+            Matrix<u8> Du;
+            auto size = u ? n / 4 : n;
+            makeBatch(size, size, dataByteSize, 0.25, prng, usedX, usedY, Xu, Yu, Du);
+            usedX.insert(Xu.begin(), Xu.end());
+            usedY.insert(Yu.begin(), Yu.end());
+
+            Matrix<u8> Eu(Xu.size(), ownByteSize);
+            prng.get<u8>(Eu.data(), Eu.size());
+
+            parties.run([&]() -> Proto {
+                co_await db0.insertID(Xu, Eu, chl0);
+                co_await db0.respondOPRF(chl0);
+            }, [&]() -> Proto {
+                co_await db1.respondOPRF(chl1);
+                co_await db1.insertID(Yu, Du, chl1);
+            });
+
+            db0.setUpdatePolicy(policies[u]);
+            auto flights0 = stats0->mFlights;
+            auto flights1 = stats1->mFlights;
+            parties.run([&]() -> Proto {
+                co_await db0.shareUpdate_P0(chl0);
+            }, [&]() -> Proto {
+                co_await db1.shareUpdate_P1(chl1);
+            });
+
+            auto f0 = db0.lastUpdateMetrics().mFlights;
+            auto f1 = db1.lastUpdateMetrics().mFlights;
+            if (f0 != stats0->mFlights - flights0 || f1 != stats1->mFlights - flights1)
+                throw RTE_LOC;
+            totalFlights[wan] += f0 + f1;
+
+            if (cmd.isSet("v"))
+                std::cout << (wan ? "wan     " : "default ")
+                          << (policies[u] == UpdatePolicy::Rebuild ? "rebuild     " : "incremental ")
+                          << "shareUpdate flights P0 " << f0 << ", P1 " << f1 << "\n";
+
+            Xall.insert(Xall.end(), Xu.begin(), Xu.end());
+            Yall.insert(Yall.end(), Yu.begin(), Yu.end());
+            appendRows(Dall, Du);
+            appendRows(Eall, Eu);
+            checkCurrentState(db0, db1, Xall, Yall, Dall, dataByteSize);
+
+            auto& s0 = db0.getOwnDataShare();
+            auto& s1 = db1.getOwnDataShare();
+            if (s0.rows() != Xall.size() || s1.rows() != Xall.size())
+                throw RTE_LOC;
+            for (u64 i = 0; i < Eall.size(); ++i)
+                if ((s0.data()[i] ^ s1.data()[i]) != Eall.data()[i])
+                    throw RTE_LOC;
+        }
+    }
+
+    if (totalFlights[1] >= totalFlights[0])
+        throw RTE_LOC;
+}
+
+void pseudonymisedDB_lateMatch_test(const oc::CLP& cmd)
+{
+    const u64 n = cmd.getOr("n", 1000);
+    const u64 dataByteSize = cmd.getOr("bs", 16);
+
+    PRNG prng;
+    prng.SetSeed(oc::ZeroBlock);
+
+    TwoParties parties;
+    auto& socket = parties.socket;
+
+    PseudonymisedDB_P0 db0(dataByteSize, prng.get(), PrfType::AltMod, 1ull << 16);
+    PseudonymisedDB_P1 db1(dataByteSize, prng.get(), PrfType::AltMod, 1ull << 16);
+
+    std::vector<block> Xall, Yall;
+    Matrix<u8> Dall(0, dataByteSize);
+    std::set<block> usedX, usedY;
+
+    // rows of X that matched nothing get a match in Y', on both ways of
+    // updating and on the incremental update after a rebuild
+    std::vector<UpdatePolicy> policies = {
+        UpdatePolicy::Incremental, UpdatePolicy::Incremental, UpdatePolicy::Incremental,
+        UpdatePolicy::Rebuild, UpdatePolicy::Incremental };
+    for (u64 u = 0; u < policies.size(); ++u)
+    {
+        std::vector<block> Xu, Yu;
+        Matrix<u8> Du;
+        auto size = u ? n / 4 : n;
+        makeBatch(size, size, dataByteSize, 0.25, prng, usedX, usedY, Xu, Yu, Du);
+        matchPreviousX(Xall, usedY, Xu, size / 5, Yu);
+        usedX.insert(Xu.begin(), Xu.end());
+        usedY.insert(Yu.begin(), Yu.end());
+
+        db0.setUpdatePolicy(policies[u]);
+        parties.run([&]() -> Proto {
+            co_await db0.insertID(Xu, socket[0]);
+            co_await db0.respondOPRF(socket[0]);
+            co_await db0.shareUpdate_P0(socket[0]);
+        }, [&]() -> Proto {
+            co_await db1.respondOPRF(socket[1]);
+            co_await db1.insertID(Yu, Du, socket[1]);
+            co_await db1.shareUpdate_P1(socket[1]);
+        });
+
+        Xall.insert(Xall.end(), Xu.begin(), Xu.end());
+        Yall.insert(Yall.end(), Yu.begin(), Yu.end());
+        appendRows(Dall, Du);
+        checkCurrentState(db0, db1, Xall, Yall, Dall, dataByteSize);
+    }
+}
+
+void pseudonymisedDB_width_test(const oc::CLP& cmd)
+{
+    const u64 n = cmd.getOr("n", 1000);
+
+    // narrower than a block, so the mux stages its rows, and two whole blocks
+    for (u64 dataByteSize : { 8ull, 32ull })
+    {
+        PRNG prng;
+        prng.SetSeed(oc::ZeroBlock);
+
+        TwoParties parties;
+        auto& socket = parties.socket;
+
+        PseudonymisedDB_P0 db0(dataByteSize, prng.get(), PrfType::AltMod, 1ull << 16);
+        PseudonymisedDB_P1 db1(dataByteSize, prng.get(), PrfType::AltMod, 1ull << 16);
+
+        u64 id0, id1;
+        AggregateSpec sum{ AggregateOp::Sum, dataByteSize - 8, 8 };
+        parties.run([&]() -> Proto {
+            co_await db0.registerAggregate_P0(sum, id0, socket[0]);
+        }, [&]() -> Proto {
+            co_await db1.registerAggregate_P1(sum, id1, socket[1]);
+        });
+
+        std::vector<block> Xall, Yall;
+        Matrix<u8> Dall(0, dataByteSize);
+        std::set<block> usedX, usedY;
+
+        std::vector<UpdatePolicy> policies = {
+            UpdatePolicy::Incremental, UpdatePolicy::Incremental, UpdatePolicy::Rebuild };
+        for (u64 u = 0; u < policies.size(); ++u)
+        {
+            std::vector<block> Xu, Yu;
+            Matrix<u8> Du;
+            auto size = u ? n / 4 : n;
+            makeBatch(size, size, dataByteSize, 0.25, prng, usedX, usedY, Xu, Yu, Du);
+            matchPreviousX(Xall, usedY, Xu, size / 5, Yu);
+            usedX.insert(Xu.begin(), Xu.end());
+            usedY.insert(Yu.begin(), Yu.end());
+
+            db0.setUpdatePolicy(policies[u]);
+            parties.run([&]() -> Proto {
+                co_await db0.insertID(Xu, socket[0]);
+                co_await db0.respondOPRF(socket[0]);
+                co_await db0.shareUpdate_P0(socket[0]);
+            }, [&]() -> Proto {
+                co_await db1.respondOPRF(socket[1]);
+                co_await db1.insertID(Yu, Du, socket[1]);
+                co_await db1.shareUpdate_P1(socket[1]);
+            });
+
+            Xall.insert(Xall.end(), Xu.begin(), Xu.end());
+            Yall.insert(Yall.end(), Yu.begin(), Yu.end());
+            appendRows(Dall, Du);
+            checkCurrentState(db0, db1, Xall, Yall, Dall, dataByteSize);
+
+            u64 s0, s1;
+            parties.run([&]() -> Proto {
+                co_await db0.revealAggregate(id0, s0, socket[0]);
+            }, [&]() -> Proto {
+                co_await db1.revealAggregate(id1, s1, socket[1]);
+            });
+            std::unordered_map<block, u64> y2idx;
+            for (u64 j = 0; j < Yall.size(); ++j)
+                y2idx[Yall[j]] = j;
+            u64 expected = 0;
+            for (auto& x : Xall)
+            {
+                auto it = y2idx.find(x);
+                if (it == y2idx.end())
+                    continue;
+                u64 w;
+                std::memcpy(&w, Dall.data(it->second) + sum.mOffset, 8);
+                expected += w;
+            }
+            if (s0 != expected || s1 != expected)
+                throw RTE_LOC;
+        }
+    }
+}
+
+void pseudonymisedDB_export_test(const oc::CLP& cmd)
+{
+    const u64 n = cmd.getOr("n", 1000);
+    const u64 dataByteSize = cmd.getOr("bs", 16);
+
+    PRNG prng;
+    prng.SetSeed(oc::ZeroBlock);
+
+    TwoParties parties;
+    auto& socket = parties.socket;
+
+    PseudonymisedDB_P0 db0(dataByteSize, prng.get(), PrfType::AltMod, 1ull << 16);
+    PseudonymisedDB_P1 db1(dataByteSize, prng.get(), PrfType::AltMod, 1ull << 16);
+
+    auto dir = std::filesystem::temp_directory_path() / "uppid_db_export_test";
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+    std::array<std::string, 2> paths = { (dir / "p0.bin").string(), (dir / "p1.bin").string() };
+
+    std::vector<block> Xall, Yall;
+    Matrix<u8> Dall(0, dataByteSize);
+    std::set<block> usedX, usedY;
+
+    // export after every update; late matches and the rebuild change rows
+    // that are in the files already
+    std::vector<UpdatePolicy> policies = {
+        UpdatePolicy::Incremental, UpdatePolicy::Incremental, UpdatePolicy::Rebuild };
+    for (u64 u = 0; u < policies.size(); ++u)
+    {
+        std::vector<block> Xu, Yu;
+        Matrix<u8> Du;
+        auto size = u ? n / 4 : n;
+        makeBatch(size, size, dataByteSize, 0.25, prng, usedX, usedY, Xu, Yu, Du);
+        matchPreviousX(Xall, usedY, Xu, size / 5, Yu);
+        usedX.insert(Xu.begin(), Xu.end());
+        usedY.insert(Yu.begin(), Yu.end());
+
+        db0.setUpdatePolicy(policies[u]);
+        parties.run([&]() -> Proto {
+            co_await db0.insertID(Xu, socket[0]);
+            co_await db0.respondOPRF(socket[0]);
+            co_await db0.shareUpdate_P0(socket[0]);
+        }, [&]() -> Proto {
+            co_await db1.respondOPRF(socket[1]);
+            co_await db1.insertID(Yu, Du, socket[1]);
+            co_await db1.shareUpdate_P1(socket[1]);
+        });
+
+        Xall.insert(Xall.end(), Xu.begin(), Xu.end());
+        Yall.insert(Yall.end(), Yu.begin(), Yu.end());
+        appendRows(Dall, Du);
+        checkCurrentState(db0, db1, Xall, Yall, Dall, dataByteSize);
+
+        {
+            ShareExportWriter w0(paths[0], dataByteSize);
+            ShareExportWriter w1(paths[1], dataByteSize);
+            auto n0 = exportShares(db0, w0);
+            auto n1 = exportShares(db1, w1);
+            if (n0 != Xall.size() || n1 != Xall.size())
+                throw RTE_LOC;
+        }
+
+        // the files hold the current shares, not those of the earlier exports
+        std::array<oc::BitVector*, 2> mem = { &db0.getMemShare(), &db1.getMemShare() };
+        std::array<Matrix<u8>*, 2> data = { &db0.getDataShare(), &db1.getDataShare() };
+        for (u64 p = 0; p < 2; ++p)
+        {
+            ShareExportReader reader(paths[p]);
+            if (reader.rows() != Xall.size() || reader.epoch() != db0.updateEpoch())
+                throw RTE_LOC;
+
+            oc::BitVector m;
+            Matrix<u8> d;
+            reader.readMem(m, 0);
+            reader.readData(d, 0);
+            if (!(m == *mem[p]) || d.size() != data[p]->size() ||
+                std::memcmp(d.data(), data[p]->data(), d.size()))
+                throw RTE_LOC;
+        }
+    }
+
+    std::filesystem::remove_all(dir);
+}
+
+void pseudonymisedDB_multiKey_test(const oc::CLP& cmd)
+{
+    const u64 n = cmd.getOr("n", 400);
+    const u64 k = cmd.getOr("k", 3);
+    const u64 dataByteSize = cmd.getOr("bs", 16);
+
+    PRNG prng;
+    prng.SetSeed(oc::ZeroBlock);
+
+    TwoParties parties;
+    auto& socket = parties.socket;
+
+    PseudonymisedDB_P0 db0(dataByteSize, prng.get(), PrfType::AltMod, 1ull << 16, 0, k);
+    PseudonymisedDB_P1 db1(dataByteSize, prng.get(), PrfType::AltMod, 1ull << 16, 0, k);
+
+    // about one identifier in five is absent
+    auto randomId = [&] {
+        return prng.get<u8>() % 5 ? prng.get<block>() : oc::ZeroBlock;
+    };
+
+    // rows of both updates; rows of X share slots with a row of Y of either
+    // update (late matches) or with none. Each row of Y is used once.
+    const u64 numUpdates = 2;
+    std::vector<Matrix<block>> X(numUpdates), Y(numUpdates);
+    std::vector<Matrix<u8>> D(numUpdates);
+    std::vector<std::pair<u64, u64>> freeY;
+    for (u64 u = 0; u < numUpdates; ++u)
+    {
+        Y[u].resize(n, k);
+        for (auto& y : Y[u])
+            y = randomId();
+        D[u].resize(n, dataByteSize);
+        prng.get<u8>(D[u].data(), D[u].size());
+        for (u64 t = 0; t < n; ++t)
+            freeY.emplace_back(u, t);
+    }
+    myShuffle(freeY, prng);
+
+    for (u64 u = 0; u < numUpdates; ++u)
+    {
+        X[u].resize(n, k);
+        for (u64 i = 0; i < n; ++i)
+        {
+            bool match = prng.get<u8>() % 2 && freeY.size();
+            std::pair<u64, u64> y;
+            if (match)
+            {
+                y = freeY.back();
+                freeY.pop_back();
+            }
+            for (u64 j = 0; j < k; ++j)
+                X[u](i, j) = match && prng.get<u8>() % 3
+                    ? Y[y.first](y.second, j)
+                    : randomId();
+        }
+    }
+
+    std::vector<std::unordered_map<block, std::pair<u64, u64>>> slot(k);
+    for (u64 u = 0; u < numUpdates; ++u)
+    {
+        parties.run([&]() -> Proto {
+            co_await db0.insertID(oc::span<block>(X[u].data(), X[u].size()), socket[0]);
+            co_await db0.respondOPRF(socket[0]);
+            co_await db0.shareUpdate_P0(socket[0]);
+        }, [&]() -> Proto {
+            co_await db1.respondOPRF(socket[1]);
+            co_await db1.insertID(oc::span<block>(Y[u].data(), Y[u].size()), D[u], socket[1]);
+            co_await db1.shareUpdate_P1(socket[1]);
+        });
+
+        // multi-key tables are always rebuilt
+        if (!db0.lastUpdateMetrics().mRebuild || !db1.lastUpdateMetrics().mRebuild)
+            throw RTE_LOC;
+
+        for (u64 t = 0; t < n; ++t)
+            for (u64 j = 0; j < k; ++j)
+                if (Y[u](t, j) != oc::ZeroBlock)
+                    slot[j][Y[u](t, j)] = { u, t };
+
+        auto& mem0 = db0.getMemShare();
+        auto& mem1 = db1.getMemShare();
+        auto& data0 = db0.getDataShare();
+        auto& data1 = db1.getDataShare();
+        const u64 rows = (u + 1) * n;
+        if (mem0.size() != rows || mem1.size() != rows ||
+            data0.rows() != rows || data1.rows() != rows ||
+            db0.getUID().size() != rows * k)
+            throw RTE_LOC;
+
+        // the payload of the Y row matched by the lowest slot, zero if none
+        for (u64 r = 0; r < rows; ++r)
+        {
+            auto x = X[r / n].data(r % n);
+            const std::pair<u64, u64>* y = nullptr;
+            for (u64 j = 0; j < k && !y; ++j)
+            {
+                if (x[j] == oc::ZeroBlock)
+                    continue;
+                auto it = slot[j].find(x[j]);
+                if (it != slot[j].end())
+                    y = &it->second;
+            }
+
+            if (bool(mem0[r] ^ mem1[r]) != bool(y))
+                throw RTE_LOC;
+            for (u64 b = 0; b < dataByteSize; ++b)
+            {
+                u8 expected = y ? D[y->first](y->second, b) : 0;
+                if ((data0(r, b) ^ data1(r, b)) != expected)
+                    throw RTE_LOC;
+            }
+        }
+    }
+}
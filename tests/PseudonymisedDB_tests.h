@@ -1,5 +1,31 @@
 #pragma once
 
 #include "cryptoTools/Common/CLP.h"
+#include "cryptoTools/Common/Matrix.h"
+#include "PseudonymisedDB.h"
 
-void pseudonymisedDB_test(const oc::CLP& cmd);
\ No newline at end of file
+#include <vector>
+
+// Throws unless the shared table of db0/db1 holds, for each row of Xall,
+// membership [x in Yall] and the payload row of Dall matching x.
+void checkCurrentState(
+    uppid::PseudonymisedDB_P0& db0,
+    uppid::PseudonymisedDB_P1& db1,
+    const std::vector<oc::block>& Xall,
+    const std::vector<oc::block>& Yall,
+    const oc::Matrix<oc::u8>& Dall,
+    oc::u64 dataByteSize);
+
+
+void pseudonymisedDB_test(const oc::CLP& cmd);
+void pseudonymisedDB_keyRotation_test(const oc::CLP& cmd);
+void pseudonymisedDB_count_test(const oc::CLP& cmd);
+void pseudonymisedDB_resume_test(const oc::CLP& cmd);
+void pseudonymisedDB_rebuild_test(const oc::CLP& cmd);
+void pseudonymisedDB_ownPayload_test(const oc::CLP& cmd);
+void pseudonymisedDB_innerJoin_test(const oc::CLP& cmd);
+void pseudonymisedDB_wan_test(const oc::CLP& cmd);
+void pseudonymisedDB_lateMatch_test(const oc::CLP& cmd);
+void pseudonymisedDB_width_test(const oc::CLP& cmd);
+void pseudonymisedDB_export_test(const oc::CLP& cmd);
+void pseudonymisedDB_multiKey_test(const oc::CLP& cmd);
@@ -0,0 +1,74 @@
+#include "SecureBitSum.h"
+#include "SecureBitSum_tests.h"
+#include "cryptoTools/Common/Matrix.h"
+#include "cryptoTools/Crypto/PRNG.h"
+
+#include <iostream>
+
+using namespace oc;
+using namespace uppid;
+
+void secureBitSum_test(const oc::CLP& cmd)
+{
+    const u64 n = cmd.getOr("n", 1ull << cmd.getOr("nn", 10)) + 3;
+
+    PRNG prng;
+    prng.SetSeed(oc::ZeroBlock);
+
+    oc::BitVector b0(n), b1(n);
+    b0.randomize(prng);
+    b1.randomize(prng);
+
+    macoro::thread_pool pool0;
+    auto e0 = pool0.make_work();
+    pool0.create_thread();
+    macoro::thread_pool pool1;
+    auto e1 = pool1.make_work();
+    pool1.create_thread();
+
+    auto socket = coproto::LocalAsyncSocket::makePair();
+    socket[0].setExecutor(pool0);
+    socket[1].setExecutor(pool1);
+
+    SecureBitSum sum0, sum1;
+    sum0.init(prng.get());
+    sum1.init(prng.get());
+
+    u64 s0, s1;
+    auto r = macoro::sync_wait(
+        macoro::when_all_ready(
+            sum0.count(0, b0, s0, socket[0]) | macoro::start_on(pool0),
+            sum1.count(1, b1, s1, socket[1]) | macoro::start_on(pool1)));
+    std::get<0>(r).result();
+    std::get<1>(r).result();
+
+    if (s0 + s1 != (b0 ^ b1).hammingWeight())
+        throw RTE_LOC;
+
+    // column sums of XOR-shared words
+    const u64 cols = 3;
+    Matrix<u64> w0(n, cols), w1(n, cols);
+    prng.get(w0.data(), w0.size());
+    prng.get(w1.data(), w1.size());
+    std::vector<u64> sums0(cols), sums1(cols);
+    r = macoro::sync_wait(
+        macoro::when_all_ready(
+            sum0.sumWords(0, MatrixView<const u64>(w0.data(), n, cols), sums0, socket[0]) | macoro::start_on(pool0),
+            sum1.sumWords(1, MatrixView<const u64>(w1.data(), n, cols), sums1, socket[1]) | macoro::start_on(pool1)));
+    std::get<0>(r).result();
+    std::get<1>(r).result();
+
+    for (u64 j = 0; j < cols; ++j)
+    {
+        u64 expected = 0;
+        for (u64 i = 0; i < n; ++i)
+            expected += w0(i, j) ^ w1(i, j);
+        if (sums0[j] + sums1[j] != expected)
+            throw RTE_LOC;
+    }
+
+    if (cmd.isSet("v"))
+        std::cout << "comm "
+                  << double(socket[0].bytesSent() + socket[1].bytesSent()) / 1024 / 1024
+                  << "MB\n";
+}
@@ -0,0 +1,87 @@
+#include "SecureCompaction.h"
+#include "SecureCompaction_tests.h"
+#include "cryptoTools/Common/Matrix.h"
+#include "cryptoTools/Crypto/PRNG.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+using namespace oc;
+using namespace uppid;
+
+void secureCompaction_test(const oc::CLP& cmd)
+{
+    const u64 n = cmd.getOr("n", 1ull << cmd.getOr("nn", 10)) + 3;
+    const u64 bytes = cmd.getOr("bs", 16);
+    const double matchFrac = cmd.getOr("p", 0.05);
+
+    PRNG prng;
+    prng.SetSeed(oc::ZeroBlock);
+
+    // a few percent of the rows match
+    oc::BitVector m(n), m0(n), m1(n);
+    for (u64 i = 0; i < n; ++i)
+        m[i] = prng.get<u32>() < matchFrac * ~u32(0);
+    m0.randomize(prng);
+    m1 = m ^ m0;
+
+    Matrix<u8> d(n, bytes), d0(n, bytes), d1(n, bytes);
+    prng.get<u8>(d.data(), d.size());
+    prng.get<u8>(d0.data(), d0.size());
+    for (u64 i = 0; i < d.size(); ++i)
+        d1.data()[i] = d.data()[i] ^ d0.data()[i];
+
+    macoro::thread_pool pool0;
+    auto e0 = pool0.make_work();
+    pool0.create_thread();
+    macoro::thread_pool pool1;
+    auto e1 = pool1.make_work();
+    pool1.create_thread();
+
+    auto socket = coproto::LocalAsyncSocket::makePair();
+    socket[0].setExecutor(pool0);
+    socket[1].setExecutor(pool1);
+
+    SecureCompaction c0, c1;
+    c0.init(prng.get(), 1ull << 16);
+    c1.init(prng.get(), 1ull << 16);
+
+    Matrix<u8> out0, out1;
+    u64 count0, count1;
+    auto r = macoro::sync_wait(
+        macoro::when_all_ready(
+            c0.compact(0, m0, MatrixView<const u8>(d0.data(), n, bytes), out0, count0, socket[0]) | macoro::start_on(pool0),
+            c1.compact(1, m1, MatrixView<const u8>(d1.data(), n, bytes), out1, count1, socket[1]) | macoro::start_on(pool1)));
+    std::get<0>(r).result();
+    std::get<1>(r).result();
+
+    const u64 count = m.hammingWeight();
+    if (count0 != count || count1 != count ||
+        out0.rows() != count || out1.rows() != count ||
+        out0.cols() != bytes || out1.cols() != bytes)
+        throw RTE_LOC;
+
+    // the matched rows, in some order
+    std::vector<std::string> expected, got;
+    for (u64 i = 0; i < n; ++i)
+        if (m[i])
+            expected.emplace_back((const char*)d.data(i), bytes);
+    for (u64 i = 0; i < count; ++i)
+    {
+        std::string row(bytes, 0);
+        for (u64 b = 0; b < bytes; ++b)
+            row[b] = char(out0(i, b) ^ out1(i, b));
+        got.push_back(std::move(row));
+    }
+    std::sort(expected.begin(), expected.end());
+    std::sort(got.begin(), got.end());
+    if (expected != got)
+        throw RTE_LOC;
+
+    if (cmd.isSet("v"))
+        std::cout << count << " of " << n << " rows, comm "
+                  << double(socket[0].bytesSent() + socket[1].bytesSent()) / 1024 / 1024
+                  << "MB\n";
+}
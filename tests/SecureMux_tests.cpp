@@ -0,0 +1,66 @@
+#include "SecureMux.h"
+#include "SecureMux_tests.h"
+#include "cryptoTools/Common/Matrix.h"
+#include "cryptoTools/Crypto/PRNG.h"
+#include "cryptoTools/Common/Timer.h"
+
+#include <iostream>
+
+using namespace oc;
+using namespace uppid;
+
+void secureMux_test(const oc::CLP& cmd)
+{
+    const u64 n = cmd.getOr("n", 1ull << cmd.getOr("nn", 10)) + 3; // odd tail for the kernels
+    const u64 blocksPerRow = cmd.getOr("bpr", 1);
+
+    PRNG prng;
+    prng.SetSeed(oc::ZeroBlock);
+
+    oc::BitVector m0(n), m1(n);
+    m0.randomize(prng);
+    m1.randomize(prng);
+
+    Matrix<block> a0(n, blocksPerRow), a1(n, blocksPerRow);
+    prng.get(a0.data(), a0.size());
+    prng.get(a1.data(), a1.size());
+    Matrix<block> in0 = a0, in1 = a1;
+
+    macoro::thread_pool pool0;
+    auto e0 = pool0.make_work();
+    pool0.create_thread();
+    macoro::thread_pool pool1;
+    auto e1 = pool1.make_work();
+    pool1.create_thread();
+
+    auto socket = coproto::LocalAsyncSocket::makePair();
+    socket[0].setExecutor(pool0);
+    socket[1].setExecutor(pool1);
+
+    SecureMux mux0, mux1;
+    mux0.init(prng.get());
+    mux1.init(prng.get());
+
+    auto r = macoro::sync_wait(
+        macoro::when_all_ready(
+            mux0.apply(0, m0, a0, socket[0]) | macoro::start_on(pool0),
+            mux1.apply(1, m1, a1, socket[1]) | macoro::start_on(pool1)));
+    std::get<0>(r).result();
+    std::get<1>(r).result();
+
+    for (u64 i = 0; i < n; ++i)
+    {
+        bool m = m0[i] ^ m1[i];
+        for (u64 j = 0; j < blocksPerRow; ++j)
+        {
+            auto expected = m ? (in0(i, j) ^ in1(i, j)) : oc::ZeroBlock;
+            if ((a0(i, j) ^ a1(i, j)) != expected)
+                throw RTE_LOC;
+        }
+    }
+
+    if (cmd.isSet("v"))
+        std::cout << "comm "
+                  << double(socket[0].bytesSent() + socket[1].bytesSent()) / 1024 / 1024
+                  << "MB\n";
+}
@@ -0,0 +1,139 @@
+#include "SessionManager.h"
+#include "SessionManager_tests.h"
+#include "cryptoTools/Common/Matrix.h"
+#include "cryptoTools/Crypto/PRNG.h"
+#include "cryptoTools/Common/Timer.h"
+
+#include <unordered_map>
+#include <vector>
+#include <iostream>
+
+using namespace oc;
+using namespace uppid;
+
+void sessionManager_test(const oc::CLP& cmd)
+{
+    const u64 n = cmd.getOr("n", 1ull << cmd.getOr("nn", 8));
+    const u64 numClients = cmd.getOr("c", 3);
+    const u64 numThreads = cmd.getOr("t", 2);
+    const u64 dataByteSize = 16;
+
+    PRNG prng;
+    prng.SetSeed(oc::ZeroBlock);
+
+    // P_1 data, shared by every session
+    std::vector<block> Y(n);
+    prng.get(Y.data(), n);
+    Matrix<u8> D(n, dataByteSize);
+    prng.get<u8>(D.data(), D.size());
+
+    std::unordered_map<block, u64> y2idx;
+    for (u64 j = 0; j < n; ++j)
+        y2idx[Y[j]] = j;
+
+    // every client holds half of Y plus fresh elements
+    std::vector<std::vector<block>> X(numClients);
+    for (u64 c = 0; c < numClients; ++c)
+    {
+        X[c].resize(n);
+        for (u64 i = 0; i < n; ++i)
+            X[c][i] = (i % 2) ? Y[(i + c) % n] : prng.get<block>();
+    }
+
+    macoro::thread_pool pool0;
+    auto e0 = pool0.make_work();
+    pool0.create_thread();
+
+    SessionManager_P1 server(dataByteSize, numThreads, prng.get(), PrfType::AltMod, 1ull << 20);
+
+    std::vector<std::unique_ptr<PseudonymisedDB_P0>> clients;
+    std::vector<decltype(coproto::LocalAsyncSocket::makePair())> sockets;
+    std::vector<u64> sessionIds;
+    for (u64 c = 0; c < numClients; ++c)
+    {
+        sockets.push_back(coproto::LocalAsyncSocket::makePair());
+        sockets.back()[0].setExecutor(pool0);
+        clients.emplace_back(new PseudonymisedDB_P0(dataByteSize, prng.get(), PrfType::AltMod, 1ull << 20));
+        sessionIds.push_back(server.openSession(sockets.back()[1]));
+    }
+
+    if (server.numSessions() != numClients)
+        throw RTE_LOC;
+
+    oc::Timer timer;
+    timer.setTimePoint("start");
+
+    // 1) insert on both sides, all sessions concurrently
+    {
+        std::vector<std::future<void>> fs;
+        std::vector<std::future<void>> cs;
+        for (u64 c = 0; c < numClients; ++c)
+        {
+            fs.push_back(std::async(std::launch::async, [&, c]() {
+                server.respondOPRF(sessionIds[c]).get();
+                server.insertID(sessionIds[c], Y, D).get();
+            }));
+            cs.push_back(std::async(std::launch::async, [&, c]() {
+                auto p0 = [&]() -> Proto {
+                    co_await clients[c]->insertID(X[c], sockets[c][0]);
+                    co_await clients[c]->respondOPRF(sockets[c][0]);
+                };
+                macoro::sync_wait(p0() | macoro::start_on(pool0));
+            }));
+        }
+        for (auto& f : fs) f.get();
+        for (auto& f : cs) f.get();
+    }
+    timer.setTimePoint("InsertPID");
+
+    // 2) share update, all sessions concurrently
+    {
+        std::vector<std::future<void>> fs;
+        std::vector<std::future<void>> cs;
+        for (u64 c = 0; c < numClients; ++c)
+        {
+            fs.push_back(server.shareUpdate(sessionIds[c]));
+            cs.push_back(std::async(std::launch::async, [&, c]() {
+                macoro::sync_wait(
+                    clients[c]->shareUpdate_P0(sockets[c][0]) | macoro::start_on(pool0));
+            }));
+        }
+        for (auto& f : fs) f.get();
+        for (auto& f : cs) f.get();
+    }
+    timer.setTimePoint("UpdatePayload");
+
+    // check every session independently
+    for (u64 c = 0; c < numClients; ++c)
+    {
+        auto& db1 = server.getDB(sessionIds[c]);
+        auto& mem0 = clients[c]->getMemShare();
+        auto& mem1 = db1.getMemShare();
+        auto& val0 = clients[c]->getDataShare();
+        auto& val1 = db1.getDataShare();
+
+        if (mem0.size() != n || mem1.size() != n)
+            throw RTE_LOC;
+
+        for (u64 i = 0; i < n; ++i)
+        {
+            auto iter = y2idx.find(X[c][i]);
+            bool inY = iter != y2idx.end();
+            if (bool(mem0[i] ^ mem1[i]) != inY)
+                throw RTE_LOC;
+
+            if (inY)
+            {
+                for (u64 b = 0; b < dataByteSize; ++b)
+                    if ((val0(i, b) ^ val1(i, b)) != D(iter->second, b))
+                        throw RTE_LOC;
+            }
+        }
+    }
+
+    for (u64 c = 0; c < numClients; ++c)
+        server.closeSession(sessionIds[c]);
+
+    if (cmd.isSet("v"))
+        std::cout << "\n" << timer << "\n";
+}
@@ -0,0 +1,155 @@
+#include "ShardedPseudonymisedDB.h"
+#include "ShardedPseudonymisedDB_tests.h"
+#include "cryptoTools/Common/Matrix.h"
+#include "cryptoTools/Crypto/PRNG.h"
+#include "cryptoTools/Common/Timer.h"
+
+#include <unordered_map>
+#include <vector>
+#include <iostream>
+
+using namespace oc;
+using namespace uppid;
+
+namespace
+{
+    // X: half of the rows hit Y, the rest are fresh
+    void makeShardBatch(
+        u64 n, u64 dataByteSize, PRNG& prng,
+        std::vector<block>& X, std::vector<block>& Y, Matrix<u8>& D)
+    {
+        Y.resize(n);
+        prng.get(Y.data(), n);
+        D.resize(n, dataByteSize);
+        prng.get<u8>(D.data(), D.size());
+
+        X.resize(n);
+        for (u64 i = 0; i < n; ++i)
+            X[i] = (i % 2) ? Y[n - 1 - i] : prng.get<block>();
+    }
+
+    void checkShardedState(
+        ShardedPseudonymisedDB_P0& db0,
+        ShardedPseudonymisedDB_P1& db1,
+        const std::vector<block>& Xall,
+        const std::vector<block>& Yall,
+        const Matrix<u8>& Dall)
+    {
+        std::unordered_map<block, u64> y2idx;
+        for (u64 j = 0; j < Yall.size(); ++j)
+            y2idx[Yall[j]] = j;
+
+        if (db0.size() != Xall.size())
+            throw RTE_LOC;
+
+        // every shard covers all of its UIDs, on both sides
+        for (u64 s = 0; s < db0.numShards(); ++s)
+        {
+            auto rows = db0.getShard(s).getUID().size();
+            if (db0.getShard(s).getMemShare().size() != rows ||
+                db1.getShard(s).getMemShare().size() != rows)
+                throw RTE_LOC;
+        }
+
+        // the i-th row of P_0 is found at the same shard and row on P_1's side,
+        // since the two parties have the same number of rows in each shard
+        for (u64 i = 0; i < Xall.size(); ++i)
+        {
+            auto [s, r] = db0.getRowLocation(i);
+            auto& mem0 = db0.getShard(s).getMemShare();
+            auto& mem1 = db1.getShard(s).getMemShare();
+            auto& val0 = db0.getShard(s).getDataShare();
+            auto& val1 = db1.getShard(s).getDataShare();
+
+            auto iter = y2idx.find(Xall[i]);
+            bool inY = iter != y2idx.end();
+            if (bool(mem0[r] ^ mem1[r]) != inY)
+                throw RTE_LOC;
+
+            if (inY)
+            {
+                for (u64 b = 0; b < Dall.cols(); ++b)
+                    if ((val0(r, b) ^ val1(r, b)) != Dall(iter->second, b))
+                        throw RTE_LOC;
+            }
+        }
+    }
+}
+
+void shardedPseudonymisedDB_test(const oc::CLP& cmd)
+{
+    const u64 n = cmd.getOr("n", 1ull << cmd.getOr("nn", 10));
+    const u64 numShards = cmd.getOr("k", 4);
+    const u64 dataByteSize = 16;
+
+    PRNG prng;
+    prng.SetSeed(oc::ZeroBlock);
+
+    macoro::thread_pool pool0;
+    auto e0 = pool0.make_work();
+    pool0.create_thread();
+    macoro::thread_pool pool1;
+    auto e1 = pool1.make_work();
+    pool1.create_thread();
+
+    auto socket = coproto::LocalAsyncSocket::makePair();
+    socket[0].setExecutor(pool0);
+    socket[1].setExecutor(pool1);
+
+    ShardedPseudonymisedDB_P0 db0(numShards, dataByteSize, prng.get(), PrfType::AltMod, 1ull << 20);
+    ShardedPseudonymisedDB_P1 db1(numShards, dataByteSize, prng.get(), PrfType::AltMod, 1ull << 20);
+
+    oc::Timer timer;
+    timer.setTimePoint("start");
+
+    auto run = [&](auto p0, auto p1) {
+        auto r = macoro::sync_wait(
+            macoro::when_all_ready(
+                p0() | macoro::start_on(pool0),
+                p1() | macoro::start_on(pool1)));
+        std::get<0>(r).result();
+        std::get<1>(r).result();
+    };
+
+    // P_0 alone first: no shard of P_1 has rows, so every shard appends its
+    // rows as unmatched
+    std::vector<block> X0(n / 4);
+    prng.get(X0.data(), X0.size());
+    run([&]() -> Proto {
+        co_await db0.insertID(X0, socket[0]);
+        co_await db0.shareUpdate_P0(socket[0]);
+    }, [&]() -> Proto {
+        co_await db1.respondOPRF(socket[1]);
+        co_await db1.shareUpdate_P1(socket[1]);
+    });
+    checkShardedState(db0, db1, X0, {}, Matrix<u8>(0, dataByteSize));
+    timer.setTimePoint("P_0 only update");
+
+    // then a batch of both, in which Y also hits some of those rows, on
+    // threads pinned to the node of each shard
+    db0.setAllocPolicy(AllocPolicy{}, true);
+    db1.setAllocPolicy(AllocPolicy{}, true);
+    std::vector<block> X, Y;
+    Matrix<u8> D;
+    makeShardBatch(n, dataByteSize, prng, X, Y, D);
+    for (u64 i = 0; i < X0.size() / 2; ++i)
+        Y[2 * i] = X0[i];
+
+    run([&]() -> Proto {
+        co_await db0.insertID(X, socket[0]);
+        co_await db0.respondOPRF(socket[0]);
+        co_await db0.shareUpdate_P0(socket[0]);
+    }, [&]() -> Proto {
+        co_await db1.respondOPRF(socket[1]);
+        co_await db1.insertID(Y, D, socket[1]);
+        co_await db1.shareUpdate_P1(socket[1]);
+    });
+    timer.setTimePoint("Sharded update");
+
+    std::vector<block> Xall = X0;
+    Xall.insert(Xall.end(), X.begin(), X.end());
+    checkShardedState(db0, db1, Xall, Y, D);
+
+    if (cmd.isSet("v"))
+        std::cout << "\n" << timer << "\n";
+}
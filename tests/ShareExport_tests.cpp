@@ -0,0 +1,133 @@
+#include "ShareExport.h"
+#include "ShareExport_tests.h"
+#include "cryptoTools/Common/Matrix.h"
+#include "cryptoTools/Crypto/PRNG.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+using namespace oc;
+using namespace uppid;
+
+namespace
+{
+    void checkRows(
+        const ShareExportReader& reader,
+        const oc::BitVector& mem,
+        const oc::Matrix<oc::u8>& data,
+        const std::vector<oc::block>& uids,
+        u64 begin)
+    {
+        oc::BitVector m;
+        oc::Matrix<oc::u8> d;
+        std::vector<oc::block> u;
+        reader.readMem(m, begin);
+        reader.readData(d, begin);
+        reader.readUids(u, begin);
+
+        auto n = reader.rows() - begin;
+        if (m.size() != n || d.rows() != n || u.size() != n)
+            throw RTE_LOC;
+        for (u64 i = 0; i < n; ++i)
+        {
+            if (m[i] != mem[begin + i] || u[i] != uids[begin + i] ||
+                std::memcmp(d.data(i), data.data(begin + i), data.cols()))
+                throw RTE_LOC;
+        }
+    }
+}
+
+void shareExport_test(const oc::CLP& cmd)
+{
+    const u64 n1 = cmd.getOr("n", 1000);
+    const u64 n2 = n1 + n1 / 3 + 5;
+    const u64 dataByteSize = cmd.getOr("bs", 16);
+    const u64 chunkRows = cmd.getOr("c", 37); // not a multiple of 8
+
+    PRNG prng(oc::ZeroBlock);
+    oc::BitVector mem(n2);
+    mem.randomize(prng);
+    oc::Matrix<oc::u8> data(n2, dataByteSize);
+    prng.get(data.data(), data.size());
+    std::vector<oc::block> uids(n2);
+    prng.get(uids.data(), uids.size());
+
+    auto dir = std::filesystem::temp_directory_path() / "uppid_export_test";
+    std::filesystem::create_directories(dir);
+    auto path = (dir / "shares.bin").string();
+    std::filesystem::remove(path);
+
+    // first export: rows [0, n1)
+    {
+        oc::BitVector mem1;
+        mem1.append(mem.data(), n1);
+        ShareExportWriter w(path, dataByteSize, true, chunkRows);
+        if (w.append(mem1, oc::MatrixView<u8>(data.data(), n1, dataByteSize), { uids.data(), n1 }) != n1)
+            throw RTE_LOC;
+    }
+
+    // a crash in the middle of the next export leaves a partial chunk
+    {
+        std::ofstream f(path, std::ios::binary | std::ios::app);
+        ShareChunkHeader h = {};
+        h.mMagic = ShareChunkHeader::Magic;
+        h.mFirstRow = n1;
+        h.mNumRows = chunkRows;
+        h.mBytes = (chunkRows + 7) / 8;
+        f.write((const char*)&h, sizeof(h));
+    }
+
+    // incremental export resumes at n1
+    {
+        ShareExportWriter w(path, dataByteSize, true, chunkRows);
+        if (w.rows() != n1)
+            throw RTE_LOC;
+        if (w.append(mem, data, uids) != n2 - n1)
+            throw RTE_LOC;
+        w.sync();
+    }
+
+    // an update changed the exported rows, the next export writes them again
+    mem.randomize(prng);
+    prng.get(data.data(), data.size());
+    {
+        ShareExportWriter w(path, dataByteSize, true, chunkRows);
+        if (w.append(mem, data, uids, 1, n2) != n2 || w.epoch() != 1)
+            throw RTE_LOC;
+    }
+
+    ShareExportReader reader(path);
+    if (reader.rows() != n2 || reader.epoch() != 1 ||
+        reader.dataByteSize() != dataByteSize || !reader.hasUids())
+        throw RTE_LOC;
+    for (auto& c : reader.chunks())
+        if (c.mOffset % 64)
+            throw RTE_LOC;
+
+    checkRows(reader, mem, data, uids, 0);
+    checkRows(reader, mem, data, uids, n1);
+
+    // a flipped payload byte is caught by the checksum
+    {
+        auto c = reader.chunks().back();
+        std::fstream f(path, std::ios::binary | std::ios::in | std::ios::out);
+        f.seekp(c.mOffset);
+        char b = 0;
+        f.read(&b, 1);
+        b ^= 1;
+        f.seekp(c.mOffset);
+        f.write(&b, 1);
+    }
+    bool threw = false;
+    try { ShareExportReader corrupt(path); }
+    catch (...) { threw = true; }
+    if (!threw)
+        throw RTE_LOC;
+
+    std::filesystem::remove_all(dir);
+
+    if (cmd.isSet("v"))
+        std::cout << "exported " << n2 << " rows in " << reader.chunks().size() << " chunks\n";
+}
@@ -0,0 +1,95 @@
+#include "StarJoin.h"
+#include "StarJoin_tests.h"
+#include "cryptoTools/Common/Matrix.h"
+#include "cryptoTools/Crypto/PRNG.h"
+
+#include <unordered_map>
+#include <iostream>
+
+using namespace oc;
+using namespace uppid;
+
+void starJoin_test(const oc::CLP& cmd)
+{
+    const u64 nx = cmd.getOr("nx", 1ull << cmd.getOr("nn", 8));
+    const u64 ny = cmd.getOr("ny", nx);
+    const u64 numProviders = cmd.getOr("k", 3);
+    const u64 dataByteSize = cmd.getOr("bs", 16);
+
+    PRNG prng(oc::ZeroBlock);
+
+    std::vector<block> X(nx);
+    for (auto& x : X)
+        x = prng.get<block>();
+
+    macoro::thread_pool pool0;
+    auto e0 = pool0.make_work();
+    pool0.create_thread();
+    macoro::thread_pool pool1;
+    auto e1 = pool1.make_work();
+    pool1.create_thread();
+
+    StarJoin_P0 hub(dataByteSize, prng.get());
+    hub.setInput(X);
+
+    for (u64 k = 0; k < numProviders; ++k)
+    {
+        // provider k knows a different part of X
+        std::vector<block> Y(ny);
+        std::unordered_map<block, u64> y2idx;
+        for (u64 j = 0; j < ny; ++j)
+        {
+            Y[j] = prng.get<u8>() % 2 ? X[prng.get<u64>() % nx] : prng.get<block>();
+            if (y2idx.count(Y[j]))
+                Y[j] = prng.get<block>();
+            y2idx[Y[j]] = j;
+        }
+        Matrix<u8> D(ny, dataByteSize);
+        prng.get<u8>(D.data(), D.size());
+
+        auto socket = coproto::LocalAsyncSocket::makePair();
+        socket[0].setExecutor(pool0);
+        socket[1].setExecutor(pool1);
+
+        StarJoin_P1 provider(dataByteSize, prng.get());
+
+        u64 idx;
+        auto r = macoro::sync_wait(macoro::when_all_ready(
+            hub.join(idx, socket[0]) | macoro::start_on(pool0),
+            provider.join(Y, D, socket[1]) | macoro::start_on(pool1)));
+        std::get<0>(r).result();
+        std::get<1>(r).result();
+
+        if (idx != k || hub.numProviders() != k + 1)
+            throw RTE_LOC;
+
+        auto& mem0 = hub.getMemShare(idx);
+        auto& mem1 = provider.getMemShare();
+        auto& data0 = hub.getDataShare(idx);
+        auto& data1 = provider.getDataShare();
+        if (mem0.size() != nx || mem1.size() != nx ||
+            data0.rows() != nx || data1.rows() != nx)
+            throw RTE_LOC;
+
+        for (u64 i = 0; i < nx; ++i)
+        {
+            auto it = y2idx.find(X[i]);
+            if ((mem0[i] ^ mem1[i]) != (it != y2idx.end()))
+                throw RTE_LOC;
+            if (it == y2idx.end())
+                continue;
+            for (u64 b = 0; b < dataByteSize; ++b)
+                if ((data0(i, b) ^ data1(i, b)) != D(it->second, b))
+                    throw RTE_LOC;
+        }
+    }
+
+    // the pseudonyms of X differ from provider to provider
+    for (u64 k = 1; k < numProviders; ++k)
+        for (u64 i = 0; i < nx; ++i)
+            if (hub.getUID(k)[i] == hub.getUID(0)[i])
+                throw RTE_LOC;
+
+    if (cmd.isSet("v"))
+        std::cout << "joined " << nx << " rows with " << numProviders << " providers" << std::endl;
+}
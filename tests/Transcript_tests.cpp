@@ -0,0 +1,108 @@
+#include "Transcript.h"
+#include "Transcript_tests.h"
+#include "PseudonymisedDB.h"
+#include "cryptoTools/Common/Matrix.h"
+#include "cryptoTools/Crypto/PRNG.h"
+#include "cryptoTools/Common/Timer.h"
+
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+using namespace oc;
+using namespace uppid;
+
+void transcript_test(const oc::CLP& cmd)
+{
+    const u64 n = cmd.getOr("n", 1000);
+    const u64 dataByteSize = 16;
+    const block seed0 = oc::block(0, 1), seed1 = oc::block(0, 2);
+
+    auto dir = std::filesystem::temp_directory_path() / "uppid_transcript_test";
+    std::filesystem::create_directories(dir);
+    auto path = (dir / "p0.trn").string();
+
+    PRNG prng(oc::ZeroBlock);
+    std::vector<block> X(n), Y(n);
+    prng.get(X.data(), n);
+    prng.get(Y.data(), n);
+    for (u64 i = 0; i < n / 4; ++i)
+        Y[i] = X[2 * i];
+    Matrix<u8> D(n, dataByteSize);
+    prng.get(D.data(), D.size());
+
+    macoro::thread_pool pool0;
+    auto e0 = pool0.make_work();
+    pool0.create_thread();
+
+    macoro::thread_pool pool1;
+    auto e1 = pool1.make_work();
+    pool1.create_thread();
+
+    // P_0's side of one insert and update
+    auto runP0 = [&](PseudonymisedDB_P0& db, Socket& chl) -> Proto {
+        co_await db.insertID(X, chl);
+        co_await db.respondOPRF(chl);
+        co_await db.shareUpdate_P0(chl);
+    };
+
+    // recorded run, both parties
+    PseudonymisedDB_P0 db0(dataByteSize, seed0, PrfType::AltMod, 1ull << 16);
+    PseudonymisedDB_P1 db1(dataByteSize, seed1, PrfType::AltMod, 1ull << 16);
+    {
+        auto inner = coproto::LocalAsyncSocket::makePair();
+        inner[0].setExecutor(pool0);
+        inner[1].setExecutor(pool1);
+        auto stats = std::make_shared<TranscriptStats>();
+        Socket chl0 = makeRecordingSocket(inner[0], path, stats);
+        Socket chl1 = makeRecordingSocket(inner[1]);
+        chl0.setExecutor(pool0);
+        chl1.setExecutor(pool1);
+
+        Timer timer;
+        auto begin = timer.setTimePoint("");
+        auto r = macoro::sync_wait(macoro::when_all_ready(
+            runP0(db0, chl0) | macoro::start_on(pool0),
+            [&]() -> Proto {
+                co_await db1.respondOPRF(chl1);
+                co_await db1.insertID(Y, D, chl1);
+                co_await db1.shareUpdate_P1(chl1);
+            }() | macoro::start_on(pool1)));
+        std::get<0>(r).result();
+        std::get<1>(r).result();
+        auto end = timer.setTimePoint("");
+
+        if (std::filesystem::file_size(path) != sizeof(TranscriptHeader) + stats->mBytesReceived)
+            throw RTE_LOC;
+
+        if (cmd.isSet("v"))
+            std::cout << "recorded: " << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count()
+                      << "ms, " << stats->mBytesReceived << " bytes in\n";
+    }
+
+    // P_0 alone, replayed with the same seed and input
+    PseudonymisedDB_P0 replayed(dataByteSize, seed0, PrfType::AltMod, 1ull << 16);
+    {
+        auto stats = std::make_shared<TranscriptStats>();
+        Socket chl = makeReplaySocket(path, stats);
+        chl.setExecutor(pool0);
+
+        Timer timer;
+        auto begin = timer.setTimePoint("");
+        macoro::sync_wait(runP0(replayed, chl) | macoro::start_on(pool0));
+        auto end = timer.setTimePoint("");
+
+        if (cmd.isSet("v"))
+            std::cout << "replayed: " << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count()
+                      << "ms, " << stats->mBytesSent << " bytes out\n";
+    }
+
+    // the replayed party computed exactly what it computed in the recorded run
+    if (replayed.getUID() != db0.getUID() ||
+        !(replayed.getMemShare() == db0.getMemShare()) ||
+        std::memcmp(replayed.getDataShare().data(), db0.getDataShare().data(), 
+            db0.getDataShare().size()))
+        throw RTE_LOC;
+
+    std::filesystem::remove_all(dir);
+}
@@ -2,6 +2,21 @@
 #include "DoublePrf_tests.h"
 #include "SsLeftJoin_tests.h"
 #include "PseudonymisedDB_tests.h"
+#include "SessionManager_tests.h"
+#include "ShardedPseudonymisedDB_tests.h"
+#include "UpdateQueue_tests.h"
+#include "SecureMux_tests.h"
+#include "OutOfCoreSsLeftJoin_tests.h"
+#include "IdIngest_tests.h"
+#include "ShareExport_tests.h"
+#include "Kernels_tests.h"
+#include "MultiKeySsLeftJoin_tests.h"
+#include "SecureBitSum_tests.h"
+#include "Aggregates_tests.h"
+#include "Transcript_tests.h"
+#include "CostModel_tests.h"
+#include "StarJoin_tests.h"
+#include "SecureCompaction_tests.h"
 
 #include <functional>
 
@@ -11,5 +26,33 @@ namespace uppidtests {
     t.add("doublePrf_DDH_test               ", doublePrf_DDH_test);
     t.add("ssLeftJoin_test                  ", ssLeftJoin_test);
     t.add("pseudonymisedDB_test             ", pseudonymisedDB_test);
+    t.add("pseudonymisedDB_keyRotation_test ", pseudonymisedDB_keyRotation_test);
+    t.add("pseudonymisedDB_count_test       ", pseudonymisedDB_count_test);
+    t.add("pseudonymisedDB_resume_test      ", pseudonymisedDB_resume_test);
+    t.add("pseudonymisedDB_lateMatch_test   ", pseudonymisedDB_lateMatch_test);
+    t.add("pseudonymisedDB_rebuild_test     ", pseudonymisedDB_rebuild_test);
+    t.add("pseudonymisedDB_ownPayload_test  ", pseudonymisedDB_ownPayload_test);
+    t.add("pseudonymisedDB_innerJoin_test   ", pseudonymisedDB_innerJoin_test);
+    t.add("pseudonymisedDB_wan_test         ", pseudonymisedDB_wan_test);
+    t.add("pseudonymisedDB_width_test       ", pseudonymisedDB_width_test);
+    t.add("pseudonymisedDB_export_test      ", pseudonymisedDB_export_test);
+    t.add("pseudonymisedDB_multiKey_test    ", pseudonymisedDB_multiKey_test);
+    t.add("sessionManager_test              ", sessionManager_test);
+    t.add("shardedPseudonymisedDB_test      ", shardedPseudonymisedDB_test);
+    t.add("updateQueue_test                 ", updateQueue_test);
+    t.add("updateQueue_resume_test          ", updateQueue_resume_test);
+    t.add("secureMux_test                   ", secureMux_test);
+    t.add("outOfCoreSsLeftJoin_test         ", outOfCoreSsLeftJoin_test);
+    t.add("idIngest_test                    ", idIngest_test);
+    t.add("shareExport_test                 ", shareExport_test);
+    t.add("kernels_test                     ", kernels_test);
+    t.add("multiKeySsLeftJoin_test          ", multiKeySsLeftJoin_test);
+    t.add("multiKeySsLeftJoin_bench         ", multiKeySsLeftJoin_bench);
+    t.add("secureBitSum_test                ", secureBitSum_test);
+    t.add("standingAggregates_test          ", standingAggregates_test);
+    t.add("transcript_test                  ", transcript_test);
+    t.add("costModel_test                   ", costModel_test);
+    t.add("starJoin_test                    ", starJoin_test);
+    t.add("secureCompaction_test            ", secureCompaction_test);
     });
 }
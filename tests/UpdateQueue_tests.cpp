@@ -0,0 +1,208 @@
+#include "UpdateQueue.h"
+#include "UpdateQueue_tests.h"
+#include "FaultySocket.h"
+#include "cryptoTools/Common/Matrix.h"
+#include "cryptoTools/Crypto/PRNG.h"
+#include "cryptoTools/Common/Timer.h"
+
+#include <array>
+#include <unordered_map>
+#include <vector>
+#include <iostream>
+
+using namespace oc;
+using namespace uppid;
+
+void updateQueue_test(const oc::CLP& cmd)
+{
+    const u64 n = cmd.getOr("n", 1ull << cmd.getOr("nn", 8));   // rows per enqueue
+    const u64 rounds = cmd.getOr("r", 4);
+    const u64 batch = cmd.getOr("b", 2 * n);                    // flush threshold
+    const u64 dataByteSize = 16;
+
+    PRNG prng;
+    prng.SetSeed(oc::ZeroBlock);
+
+    macoro::thread_pool pool0;
+    auto e0 = pool0.make_work();
+    pool0.create_thread();
+    macoro::thread_pool pool1;
+    auto e1 = pool1.make_work();
+    pool1.create_thread();
+
+    auto socket = coproto::LocalAsyncSocket::makePair();
+    socket[0].setExecutor(pool0);
+    socket[1].setExecutor(pool1);
+
+    PseudonymisedDB_P0 db0(dataByteSize, prng.get(), PrfType::AltMod, 1ull << 20);
+    PseudonymisedDB_P1 db1(dataByteSize, prng.get(), PrfType::AltMod, 1ull << 20);
+
+    UpdateQueueParams params;
+    params.mMaxBatchSize = batch;
+    params.mMaxStaleness = std::chrono::hours(1);
+
+    UpdateQueue_P0 queue0(db0, params);
+    UpdateQueue_P1 queue1(db1, params);
+
+    std::vector<block> Xall, Yall;
+    Matrix<u8> Dall(0, dataByteSize);
+
+    auto poll = [&](bool force) {
+        auto r = macoro::sync_wait(
+            macoro::when_all_ready(
+                queue0.poll(socket[0], force) | macoro::start_on(pool0),
+                queue1.poll(socket[1], force) | macoro::start_on(pool1)));
+        std::get<0>(r).result();
+        std::get<1>(r).result();
+    };
+
+    for (u64 r = 0; r < rounds; ++r)
+    {
+        // Y: fresh, X: half of them hit this round's Y
+        std::vector<block> X(n), Y(n);
+        Matrix<u8> D(n, dataByteSize);
+        prng.get(Y.data(), n);
+        prng.get<u8>(D.data(), D.size());
+        for (u64 i = 0; i < n; ++i)
+            X[i] = (i % 2) ? Y[i] : prng.get<block>();
+
+        auto seq0 = queue0.enqueue(X);
+        queue1.enqueue(Y, D);
+
+        Xall.insert(Xall.end(), X.begin(), X.end());
+        Yall.insert(Yall.end(), Y.begin(), Y.end());
+        auto oldRows = Dall.rows();
+        Dall.resize(oldRows + n, dataByteSize);
+        std::memcpy(Dall.data(oldRows), D.data(), D.size());
+
+        poll(false);
+
+        // flushed exactly when the batch threshold was reached
+        bool flushed = Xall.size() % batch == 0;
+        if (queue0.isFresh(seq0) != flushed)
+            throw RTE_LOC;
+        if (flushed && (queue0.pending() || queue1.pending()))
+            throw RTE_LOC;
+        if (db0.getMemShare().size() != queue0.watermark())
+            throw RTE_LOC;
+    }
+
+    poll(true);
+    if (queue0.watermark() != Xall.size() || queue1.watermark() != Yall.size())
+        throw RTE_LOC;
+
+    std::unordered_map<block, u64> y2idx;
+    for (u64 j = 0; j < Yall.size(); ++j)
+        y2idx[Yall[j]] = j;
+
+    auto& mem0 = db0.getMemShare();
+    auto& mem1 = db1.getMemShare();
+    auto& val0 = db0.getDataShare();
+    auto& val1 = db1.getDataShare();
+    if (mem0.size() != Xall.size() || mem1.size() != Xall.size())
+        throw RTE_LOC;
+
+    for (u64 i = 0; i < Xall.size(); ++i)
+    {
+        auto iter = y2idx.find(Xall[i]);
+        bool inY = iter != y2idx.end();
+        if (bool(mem0[i] ^ mem1[i]) != inY)
+            throw RTE_LOC;
+
+        if (inY)
+        {
+            for (u64 b = 0; b < dataByteSize; ++b)
+                if ((val0(i, b) ^ val1(i, b)) != Dall(iter->second, b))
+                    throw RTE_LOC;
+        }
+    }
+}
+
+void updateQueue_resume_test(const oc::CLP& cmd)
+{
+    const u64 n = cmd.getOr("n", 500);
+    const u64 dataByteSize = 16;
+
+    PRNG prng;
+    prng.SetSeed(oc::ZeroBlock);
+
+    macoro::thread_pool pool0;
+    auto e0 = pool0.make_work();
+    pool0.create_thread();
+    macoro::thread_pool pool1;
+    auto e1 = pool1.make_work();
+    pool1.create_thread();
+
+    std::array<coproto::Socket, 2> socket;
+    auto reconnect = [&] {
+        auto s = coproto::LocalAsyncSocket::makePair();
+        s[0].setExecutor(pool0);
+        s[1].setExecutor(pool1);
+        socket = { s[0], s[1] };
+    };
+    reconnect();
+
+    PseudonymisedDB_P0 db0(dataByteSize, prng.get(), PrfType::AltMod, 1ull << 16);
+    PseudonymisedDB_P1 db1(dataByteSize, prng.get(), PrfType::AltMod, 1ull << 16);
+    UpdateQueue_P0 queue0(db0);
+    UpdateQueue_P1 queue1(db1);
+
+    std::vector<block> Xall, Yall;
+    auto enqueue = [&] {
+        std::vector<block> X(n), Y(n);
+        Matrix<u8> D(n, dataByteSize);
+        prng.get(Y.data(), n);
+        prng.get<u8>(D.data(), D.size());
+        for (u64 i = 0; i < n; ++i)
+            X[i] = (i % 2) ? Y[i] : prng.get<block>();
+        queue0.enqueue(X);
+        queue1.enqueue(Y, D);
+        Xall.insert(Xall.end(), X.begin(), X.end());
+        Yall.insert(Yall.end(), Y.begin(), Y.end());
+    };
+
+    // false if either party failed
+    auto poll = [&] {
+        auto r = macoro::sync_wait(
+            macoro::when_all_ready(
+                queue0.poll(socket[0], true) | macoro::start_on(pool0),
+                queue1.poll(socket[1], true) | macoro::start_on(pool1)));
+        bool ok = true;
+        try { std::get<0>(r).result(); } catch (...) { ok = false; }
+        try { std::get<1>(r).result(); } catch (...) { ok = false; }
+        return ok;
+    };
+
+    enqueue();
+    auto before = socket[0].bytesSent();
+    if (!poll())
+        throw RTE_LOC;
+    const u64 pollBytes = socket[0].bytesSent() - before;
+
+    // break the connection late in shareUpdate, after the batch was inserted
+    enqueue();
+    socket = FaultySocket::makePair(pollBytes * 9 / 10, pool0, pool1);
+    if (poll())
+        throw RTE_LOC;
+    if (queue0.watermark() == Xall.size() && queue1.watermark() == Yall.size())
+        throw RTE_LOC;
+
+    // the next poll resumes shareUpdate without inserting the batch again
+    reconnect();
+    if (!poll())
+        throw RTE_LOC;
+    if (queue0.watermark() != Xall.size() || queue1.watermark() != Yall.size() ||
+        queue0.pending() || queue1.pending())
+        throw RTE_LOC;
+    if (db0.getMemShare().size() != Xall.size() || db1.getMemShare().size() != Xall.size())
+        throw RTE_LOC;
+
+    std::unordered_map<block, u64> y2idx;
+    for (u64 j = 0; j < Yall.size(); ++j)
+        y2idx[Yall[j]] = j;
+    auto& mem0 = db0.getMemShare();
+    auto& mem1 = db1.getMemShare();
+    for (u64 i = 0; i < Xall.size(); ++i)
+        if (bool(mem0[i] ^ mem1[i]) != bool(y2idx.count(Xall[i])))
+            throw RTE_LOC;
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+#include "cryptoTools/Common/CLP.h"
+
+void updateQueue_test(const oc::CLP& cmd);
+void updateQueue_resume_test(const oc::CLP& cmd);
@@ -0,0 +1,93 @@
+#include "Aggregates.h"
+#include "Kernels.h"
+#include <cstring> // memcpy
+
+using namespace std;
+using namespace oc;
+
+namespace uppid
+{
+    oc::u64 StandingAggregates::add(const AggregateSpec& spec, oc::u64 dataByteSize)
+    {
+        if (spec.mOp == AggregateOp::Sum &&
+            (spec.mBytes == 0 || spec.mBytes > sizeof(u64) ||
+             spec.mOffset + spec.mBytes > dataByteSize))
+            throw RTE_LOC;
+
+        mSpecs.push_back(spec);
+        mShares.push_back(0);
+        return mSpecs.size() - 1;
+    }
+
+    Proto StandingAggregates::accumulate(
+        oc::u64 partyIdx,
+        const oc::BitVector& mem,
+        oc::MatrixView<const oc::u8> data,
+        bool zeroShared,
+        Socket& chl,
+        std::vector<oc::u64> ids)
+    {
+        const u64 rows = mem.size();
+        if (data.rows() != rows)
+            throw RTE_LOC;
+        if (ids.empty())
+            for (u64 id = 0; id < mSpecs.size(); ++id)
+                ids.push_back(id);
+        if (rows == 0 || ids.empty())
+            co_return;
+
+        std::vector<u64> counts, sums;
+        for (auto id : ids)
+            (mSpecs.at(id).mOp == AggregateOp::Count ? counts : sums).push_back(id);
+
+        if (counts.size())
+        {
+            u64 delta;
+            co_await mBitSum.count(partyIdx, mem, delta, chl);
+            for (auto id : counts)
+                mShares[id] += delta;
+        }
+
+        if (sums.empty())
+            co_return;
+
+        // only the summed fields, one word each
+        const u64 numWords = sums.size();
+        oc::MatrixView<u64> words(mScratch.get<u64>(ScratchWords, rows * numWords).data(), rows, numWords);
+        for (u64 i = 0; i < rows; ++i)
+        {
+            for (u64 j = 0; j < numWords; ++j)
+            {
+                auto& s = mSpecs[sums[j]];
+                words(i, j) = 0;
+                std::memcpy(&words(i, j), data.data(i) + s.mOffset, s.mBytes);
+            }
+        }
+
+        if (!zeroShared)
+        {
+            // non-members must add zero
+            const u64 wordBytes = numWords * sizeof(u64);
+            const u64 bpr = (wordBytes + 15) / 16;
+            auto a = mScratch.get<oc::block>(ScratchRows, rows * bpr);
+            packRows((u8*)words.data(), rows, wordBytes, a.data());
+            co_await mMux.apply(partyIdx, mem, 
+                oc::MatrixView<oc::block>(a.data(), rows, bpr), chl);
+            unpackRows(a.data(), rows, wordBytes, (u8*)words.data());
+        }
+
+        std::vector<u64> delta(numWords);
+        co_await mBitSum.sumWords(partyIdx, 
+            oc::MatrixView<const u64>(words.data(), rows, numWords), delta, chl);
+        for (u64 j = 0; j < numWords; ++j)
+            mShares[sums[j]] += delta[j];
+    }
+
+    Proto StandingAggregates::reveal(oc::u64 id, oc::u64& value, Socket& chl)
+    {
+        u64 mine = share(id), theirs;
+        co_await chl.send(std::move(mine));
+        co_await chl.recv(theirs);
+        value = share(id) + theirs;
+    }
+}
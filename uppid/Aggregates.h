@@ -0,0 +1,108 @@
+#pragma once
+#include "SecureMux.h"
+#include "SecureBitSum.h"
+
+namespace uppid
+{
+    enum class AggregateOp
+    {
+        // number of matched rows
+        Count,
+        // sum of an integer field of the payload over the matched rows
+        Sum
+    };
+
+    struct AggregateSpec
+    {
+        AggregateOp mOp = AggregateOp::Count;
+
+        // Sum only: little-endian unsigned integer at payload bytes
+        // [mOffset, mOffset + mBytes), mBytes <= 8
+        oc::u64 mOffset = 0;
+        oc::u64 mBytes = 8;
+    };
+
+    // Aggregates over the rows of a share table, kept as additive shares
+    // (mod 2^64) and advanced by the rows an update adds or changes, so the
+    // cost of an update does not depend on the size of the table.
+    //
+    // COUNT adds the matches of the delta rows (SecureBitSum on the membership
+    // shares). SUM zero-shares the summed fields of the delta rows with the
+    // membership bits (SecureMux), unless they already are, then adds them up
+    // (SecureBitSum::sumWords). Both parties must register the same
+    // aggregates in the same order and accumulate the same rows.
+    class StandingAggregates : public oc::TimerAdapter
+    {
+        SecureMux mMux;
+        SecureBitSum mBitSum;
+
+        // per-call buffers, kept across calls
+        enum Scratch : oc::u64
+        {
+            ScratchWords,
+            ScratchRows,
+            NumScratch
+        };
+        ScratchArena mScratch{ NumScratch };
+
+        std::vector<AggregateSpec> mSpecs;
+        std::vector<oc::u64> mShares;
+
+    public:
+        void init(oc::block seed = oc::ZeroBlock)
+        {
+            oc::PRNG prng(seed);
+            mMux.init(prng.get());
+            mBitSum.init(prng.get());
+        }
+
+        void setAllocPolicy(const AllocPolicy& policy)
+        {
+            mMux.setAllocPolicy(policy);
+            mBitSum.setAllocPolicy(policy);
+            mScratch.setPolicy(policy);
+        }
+
+        PageReport pageReport() const
+        {
+            PageReport r = mScratch.pageReport();
+            r += mMux.pageReport();
+            r += mBitSum.pageReport();
+            return r;
+        }
+
+        // Returns the id of the aggregate, which starts at zero.
+        oc::u64 add(const AggregateSpec& spec, oc::u64 dataByteSize);
+
+        oc::u64 size() const { return mSpecs.size(); }
+        const AggregateSpec& spec(oc::u64 id) const { return mSpecs.at(id); }
+
+        // my additive share of aggregate id
+        oc::u64 share(oc::u64 id) const { return mShares.at(id); }
+
+        // all shares, to undo an accumulate that did not finish
+        const std::vector<oc::u64>& shares() const { return mShares; }
+        void setShares(const std::vector<oc::u64>& shares)
+        {
+            if (shares.size() != mShares.size())
+                throw RTE_LOC;
+            mShares = shares;
+        }
+
+        /**
+         * Add the rows (mem, data) to every aggregate in ids (all if empty).
+         * zeroShared: data already is a share of mem[i] * payload[i], e.g. the
+         * output of the mux in shareUpdate.
+         */
+        Proto accumulate(
+            oc::u64 partyIdx,
+            const oc::BitVector& mem,
+            oc::MatrixView<const oc::u8> data,
+            bool zeroShared,
+            Socket& chl,
+            std::vector<oc::u64> ids = {});
+
+        // Open aggregate id to both parties.
+        Proto reveal(oc::u64 id, oc::u64& value, Socket& chl);
+    };
+}
@@ -0,0 +1,101 @@
+#include "CostModel.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+using namespace oc;
+
+namespace uppid
+{
+    // Least squares fit of seconds = beta . (1, a_1, ..., a_{N-1}) to the
+    // observations (a_1, ..., a_{N-1}, seconds). Returns false if the normal
+    // equations are (close to) singular.
+    template<u64 N>
+    static bool fit(
+        const std::deque<std::array<double, N>>& obs,
+        std::array<double, N>& beta)
+    {
+        if (obs.size() < N)
+            return false;
+
+        // normal equations M beta = v, solved by Gaussian elimination
+        double M[N][N + 1] = {};
+        for (auto& o : obs)
+        {
+            double row[N];
+            row[0] = 1;
+            for (u64 i = 1; i < N; ++i)
+                row[i] = o[i - 1];
+            for (u64 i = 0; i < N; ++i)
+            {
+                for (u64 j = 0; j < N; ++j)
+                    M[i][j] += row[i] * row[j];
+                M[i][N] += row[i] * o[N - 1];
+            }
+        }
+
+        double scale = 0;
+        for (u64 i = 0; i < N; ++i)
+            scale = std::max(scale, std::abs(M[i][i]));
+
+        for (u64 c = 0; c < N; ++c)
+        {
+            u64 p = c;
+            for (u64 r = c + 1; r < N; ++r)
+                if (std::abs(M[r][c]) > std::abs(M[p][c]))
+                    p = r;
+            if (std::abs(M[p][c]) <= 1e-12 * scale)
+                return false;
+            std::swap(M[p], M[c]);
+
+            for (u64 r = 0; r < N; ++r)
+            {
+                if (r == c)
+                    continue;
+                auto f = M[r][c] / M[c][c];
+                for (u64 j = c; j <= N; ++j)
+                    M[r][j] -= f * M[c][j];
+            }
+        }
+
+        for (u64 i = 0; i < N; ++i)
+            beta[i] = std::max(0.0, M[i][N] / M[i][i]);
+        return true;
+    }
+
+    double CostModel::incremental(oc::u64 x, oc::u64 xNew, oc::u64 y, oc::u64 yNew) const
+    {
+        // SSLJ (X, Y') is skipped on the first update
+        auto prev = x ? sslj(yNew, x) + mux(x) : 0.0;
+        auto upd = sslj(y + yNew, xNew);
+        return std::max(prev, upd);
+    }
+
+    double CostModel::rebuild(oc::u64 x, oc::u64 xNew, oc::u64 y, oc::u64 yNew) const
+    {
+        return sslj(y + yNew, x + xNew);
+    }
+
+    void CostModel::observeSslj(oc::u64 senderSize, oc::u64 receiverSize, double seconds)
+    {
+        mSsljObs.push_back({ double(senderSize), double(receiverSize), seconds });
+        while (mSsljObs.size() > mWindow)
+            mSsljObs.pop_front();
+
+        std::array<double, 3> beta;
+        if (fit<3>(mSsljObs, beta))
+            mSslj = { beta[0], beta[1], beta[2] };
+    }
+
+    void CostModel::observeMux(oc::u64 rows, double seconds)
+    {
+        mMuxObs.push_back({ double(rows), seconds });
+        while (mMuxObs.size() > mWindow)
+            mMuxObs.pop_front();
+
+        std::array<double, 2> beta;
+        if (fit<2>(mMuxObs, beta))
+            mMux = { beta[0], beta[1] };
+    }
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include "cryptoTools/Common/Defines.h"
+
+#include <array>
+#include <deque>
+
+namespace uppid
+{
+    // Linear cost model (seconds) of the sub-protocols of shareUpdate, used
+    // to choose between the incremental update and a rebuild of the tables.
+    //
+    //   incremental: SSLJ (X, Y') + mux (X)  in parallel with  SSLJ (X', Y \cup Y')
+    //   rebuild:     SSLJ (X \cup X', Y \cup Y')
+    //
+    // The SSLJ term covers CPSI and P&S: CPSI grows with both sets, P&S with
+    // the receiver's table. The OPRF of insertID is paid either way and is
+    // left out. The defaults are rough single-core LAN figures; observe()
+    // refits them from measured runs.
+    class CostModel
+    {
+    public:
+        // seconds = mFixed + mPerSender |sender| + mPerReceiver |receiver|
+        struct Sslj
+        {
+            double mFixed = 0.2;
+            double mPerSender = 2e-6;
+            double mPerReceiver = 6e-6;
+        };
+
+        // seconds = mFixed + mPerRow rows
+        struct Mux
+        {
+            double mFixed = 0.05;
+            double mPerRow = 1.5e-6;
+        };
+
+        Sslj mSslj;
+        Mux mMux;
+
+        // number of recent observations the fit uses
+        oc::u64 mWindow = 64;
+
+        double sslj(oc::u64 senderSize, oc::u64 receiverSize) const
+        {
+            return mSslj.mFixed + mSslj.mPerSender * senderSize + mSslj.mPerReceiver * receiverSize;
+        }
+
+        double mux(oc::u64 rows) const
+        {
+            return mMux.mFixed + mMux.mPerRow * rows;
+        }
+
+        // x = |X|, xNew = |X'|, y = |Y|, yNew = |Y'|
+        double incremental(oc::u64 x, oc::u64 xNew, oc::u64 y, oc::u64 yNew) const;
+        double rebuild(oc::u64 x, oc::u64 xNew, oc::u64 y, oc::u64 yNew) const;
+
+        // Record a measured run. The coefficients are refit by least squares
+        // over the last mWindow observations; an underdetermined fit keeps
+        // the current ones.
+        void observeSslj(oc::u64 senderSize, oc::u64 receiverSize, double seconds);
+        void observeMux(oc::u64 rows, double seconds);
+
+    private:
+        std::deque<std::array<double, 3>> mSsljObs;
+        std::deque<std::array<double, 2>> mMuxObs;
+    };
+}
@@ -4,6 +4,10 @@
 #include "Kunlun/mpc/oprf/ddh_oprf.hpp"
 #include "Kunlun/crypto/setup.hpp"
 
+#include <atomic>
+#include <future>
+#include <thread>
+
 using namespace std;
 using namespace oc;
 using namespace secJoin;
@@ -16,6 +20,41 @@ namespace uppid
         BigInt dhKey;
     };
 
+    // inputs per AltModPrf::eval call of the local evaluation
+    static constexpr u64 LocalBatch = 1ull << 14;
+
+    // out = F_key(in). Batches of LocalBatch inputs are handed out to
+    // numThreads threads, each with its own expanded key.
+    static void evalParallel(
+        const AltModPrf::KeyType& key,
+        oc::span<const oc::block> in,
+        oc::span<oc::block> out,
+        u64 numThreads)
+    {
+        if (in.size() != out.size())
+            throw RTE_LOC;
+
+        const u64 numBatches = (in.size() + LocalBatch - 1) / LocalBatch;
+        numThreads = std::max<u64>(1, std::min<u64>(numThreads, numBatches));
+
+        std::atomic<u64> next(0);
+        auto work = [&] {
+            AltModPrf prf(key);
+            for (u64 b; (b = next++) < numBatches;) {
+                auto begin = b * LocalBatch;
+                auto n = std::min<u64>(LocalBatch, in.size() - begin);
+                prf.eval(in.subspan(begin, n), out.subspan(begin, n));
+            }
+        };
+
+        std::vector<std::thread> threads;
+        for (u64 t = 1; t < numThreads; ++t)
+            threads.emplace_back(work);
+        work();
+        for (auto& t : threads)
+            t.join();
+    }
+
     DoublePrf::DoublePrf() = default;
     DoublePrf::~DoublePrf() = default;
 
@@ -43,40 +82,38 @@ namespace uppid
         std::vector<oc::block>& UID, 
         Socket& chl)
     {
-        co_await(chl.send(input.size()));
+        co_await recv(input, {}, UID, chl);
+    }
+
+    Proto DoublePrf::recv(
+        oc::span<oc::block> input, 
+        oc::span<const oc::block> myPrf, 
+        std::vector<oc::block>& UID, 
+        Socket& chl)
+    {
+        if (myPrf.size() && (myPrf.size() != input.size() || mPrfType != PrfType::AltMod))
+            throw RTE_LOC;
+
+        if (!mWan || mPrfType != PrfType::DDH)
+            co_await(chl.send(input.size()));
         UID.resize(input.size());
 
         if (mPrfType == PrfType::AltMod) {
-            AltModPrf altModPrf(mAmKey);
-            altModPrf.eval(input, UID);
-
-            CorGenerator ole;
-            ole.init(chl.fork(), mPrng, 0, 1, mOteBatch, false);
-            oc::SilentOtExtSender keyOtSender;
-            std::vector<std::array<oc::block, 2>> sk(AltModPrf::KeySize);
-            keyOtSender.configure(AltModPrf::KeySize);
-            co_await keyOtSender.send(sk, mPrng, chl);
-
-            AltModWPrfReceiver recver;
-            recver.init(
-                input.size(), ole, 
-                AltModPrfKeyMode::SenderOnly, 
-                AltModPrfInputMode::ReceiverOnly, 
-                {}, sk);
-            
-            vector<oc::block> OprfMyShare(input.size());
-            vector<oc::block> OprfTheirShare(input.size());
-
-            co_await macoro::when_all_ready(
-                ole.start(),
-                recver.evaluate(input, OprfMyShare, chl, mPrng)
-            );
+            // a pending retireKeys evaluates under the fresh key only
+            if (mPendingRetire) {
+                if (myPrf.size())
+                    throw RTE_LOC;
+                co_await recvAltMod(*mPendingKey, input, {}, UID, mNumThreads, chl);
+                co_return;
+            }
 
-            OprfTheirShare.resize(input.size());
-            co_await(chl.recv(OprfTheirShare));
+            co_await recvAltMod(mAmKey, input, myPrf, UID, mNumThreads, chl);
 
-            for (size_t i = 0; i < UID.size(); i++) {
-                UID[i] = OprfMyShare[i] ^ OprfTheirShare[i] ^ UID[i];
+            // keys of later epochs are applied on top, see rotateKey
+            for (auto& key : mRotatedKeys) {
+                auto prev = mScratch.get<oc::block>(ScratchRekey, UID.size());
+                std::copy(UID.begin(), UID.end(), prev.begin());
+                co_await recvAltMod(key, prev, {}, UID, mNumThreads, chl);
             }
         }
         else if (mPrfType == PrfType::DDH) {
@@ -133,42 +170,31 @@ namespace uppid
 
     Proto DoublePrf::send(Socket& chl)
     {
-        u64 theirSize;
-        co_await(chl.recv(theirSize));
+        // in WAN mode the DDH request carries the size
+        const bool sized = !mWan || mPrfType != PrfType::DDH;
+        u64 theirSize = 0;
+        if (sized)
+            co_await(chl.recv(theirSize));
 
         if (mPrfType == PrfType::AltMod) {
-            CorGenerator ole;
-            ole.init(chl.fork(), mPrng, 1, 1, mOteBatch, 0);
-            oc::SilentOtExtReceiver keyOtReceiver;
-            std::vector<oc::block> rk(AltModPrf::KeySize);
-            keyOtReceiver.configure(AltModPrf::KeySize);
-            oc::BitVector kk_bv;
-
-            kk_bv.append((u8*)mAmKey.data(), AltModPrf::KeySize);
-
-            co_await keyOtReceiver.receive(kk_bv, rk, mPrng, chl);
-
-            AltModWPrfSender sender;
-            sender.init(
-                theirSize, ole, 
-                AltModPrfKeyMode::SenderOnly, 
-                AltModPrfInputMode::ReceiverOnly, 
-                mAmKey, rk); 
-
-            vector<oc::block> theirOprfShare(theirSize);
-
-            co_await macoro::when_all_ready(
-                ole.start(),
-                sender.evaluate({}, theirOprfShare, chl, mPrng)
-            );
+            if (mPendingRetire) {
+                co_await sendAltMod(*mPendingKey, theirSize, chl);
+                co_return;
+            }
 
-            co_await(chl.send(std::move(theirOprfShare)));
+            co_await sendAltMod(mAmKey, theirSize, chl);
+            for (auto& key : mRotatedKeys)
+                co_await sendAltMod(key, theirSize, chl);
         }   
         else if (mPrfType == PrfType::DDH) {
             // H(x_i)^r, x_i: their input
-            std::vector<ECPoint> maskedValue(theirSize); 
             std::vector<u8> buffer;
             co_await chl.recvResize(buffer);
+            if (!sized)
+                theirSize = buffer.size() / POINT_BYTE_LEN;
+            if (buffer.size() != theirSize * POINT_BYTE_LEN)
+                throw RTE_LOC;
+            std::vector<ECPoint> maskedValue(theirSize); 
             for (size_t i = 0; i < theirSize; i++) 
             {
                 EC_POINT_oct2point(group, 
@@ -190,4 +216,159 @@ namespace uppid
             co_await chl.send(std::move(buffer));
         }
     };
-}
\ No newline at end of file
+
+    Proto DoublePrf::recvAltMod(
+        const AltModPrf::KeyType& key,
+        oc::span<oc::block> input,
+        oc::span<const oc::block> myPrf,
+        oc::span<oc::block> UID,
+        u64 numThreads,
+        Socket& chl)
+    {
+        // The local half does not depend on the key OTs, the OLEs or the
+        // OPRF, so it is computed next to them.
+        std::future<void> local;
+        if (myPrf.size())
+            std::copy(myPrf.begin(), myPrf.end(), UID.begin());
+        else
+            local = std::async(std::launch::async, [&] {
+                evalParallel(key, input, UID, numThreads);
+            });
+
+        CorGenerator ole;
+        ole.init(chl.fork(), mPrng, 0, 1, mOteBatch, false);
+        oc::SilentOtExtSender keyOtSender;
+        std::vector<std::array<oc::block, 2>> sk(AltModPrf::KeySize);
+        keyOtSender.configure(AltModPrf::KeySize);
+        co_await keyOtSender.send(sk, mPrng, chl);
+
+        AltModWPrfReceiver recver;
+        recver.init(
+            input.size(), ole, 
+            AltModPrfKeyMode::SenderOnly, 
+            AltModPrfInputMode::ReceiverOnly, 
+            {}, sk);
+        
+        auto OprfMyShare = mScratch.get<oc::block>(ScratchMyShare, input.size());
+        auto OprfTheirShare = mScratch.get<oc::block>(ScratchTheirShare, input.size());
+
+        co_await macoro::when_all_ready(
+            ole.start(),
+            recver.evaluate(input, OprfMyShare, chl, mPrng)
+        );
+
+        co_await(chl.recv(OprfTheirShare));
+
+        if (local.valid())
+            local.get();
+        for (size_t i = 0; i < UID.size(); i++) {
+            UID[i] = OprfMyShare[i] ^ OprfTheirShare[i] ^ UID[i];
+        }
+    }
+
+    Proto DoublePrf::sendAltMod(
+        const AltModPrf::KeyType& key,
+        u64 theirSize,
+        Socket& chl)
+    {
+        CorGenerator ole;
+        ole.init(chl.fork(), mPrng, 1, 1, mOteBatch, 0);
+        oc::SilentOtExtReceiver keyOtReceiver;
+        std::vector<oc::block> rk(AltModPrf::KeySize);
+        keyOtReceiver.configure(AltModPrf::KeySize);
+        oc::BitVector kk_bv;
+
+        kk_bv.append((u8*)key.data(), AltModPrf::KeySize);
+
+        co_await keyOtReceiver.receive(kk_bv, rk, mPrng, chl);
+
+        AltModWPrfSender sender;
+        sender.init(
+            theirSize, ole, 
+            AltModPrfKeyMode::SenderOnly, 
+            AltModPrfInputMode::ReceiverOnly, 
+            key, rk); 
+
+        auto theirOprfShare = mScratch.get<oc::block>(ScratchTheirShare, theirSize);
+
+        co_await macoro::when_all_ready(
+            ole.start(),
+            sender.evaluate({}, theirOprfShare, chl, mPrng)
+        );
+
+        co_await(chl.send(theirOprfShare));
+    }
+
+    void DoublePrf::evalLocal(
+        oc::span<const oc::block> input,
+        oc::span<oc::block> myPrf) const
+    {
+        if (mPrfType != PrfType::AltMod)
+            throw RTE_LOC;
+        evalParallel(mAmKey, input, myPrf, mNumThreads);
+    }
+
+    void DoublePrf::rotateKey()
+    {
+        if (mPrfType != PrfType::AltMod)
+            throw RTE_LOC;
+        mPendingKey = mPrng.get();
+        mPendingRetire = false;
+    }
+
+    void DoublePrf::retireKeys()
+    {
+        if (mPrfType != PrfType::AltMod)
+            throw RTE_LOC;
+        mPendingKey = mPrng.get();
+        mPendingRetire = true;
+    }
+
+    void DoublePrf::commitKey()
+    {
+        if (!mPendingKey)
+            throw RTE_LOC;
+        if (mPendingRetire) {
+            mAmKey = *mPendingKey;
+            mRotatedKeys.clear();
+        }
+        else
+            mRotatedKeys.push_back(*mPendingKey);
+        mPendingKey.reset();
+        mPendingRetire = false;
+    }
+
+    Proto DoublePrf::rekey(
+        oc::span<oc::block> UID,
+        oc::span<oc::block> rekeyed,
+        u64 chunkSize,
+        u64 numThreads,
+        Socket& chl)
+    {
+        if (!mPendingKey || mPendingRetire || chunkSize == 0 || rekeyed.size() != UID.size())
+            throw RTE_LOC;
+
+        co_await chl.send(std::vector<u64>{ UID.size(), chunkSize });
+
+        auto& key = *mPendingKey;
+        for (u64 begin = 0; begin < UID.size(); begin += chunkSize) {
+            auto n = std::min<u64>(chunkSize, UID.size() - begin);
+            co_await recvAltMod(key, UID.subspan(begin, n), {}, rekeyed.subspan(begin, n), numThreads, chl);
+        }
+    }
+
+    Proto DoublePrf::respondRekey(Socket& chl)
+    {
+        if (!mPendingKey || mPendingRetire)
+            throw RTE_LOC;
+
+        std::vector<u64> sizes;
+        co_await chl.recvResize(sizes);
+        if (sizes.size() != 2 || sizes[1] == 0)
+            throw RTE_LOC;
+
+        auto& key = *mPendingKey;
+        for (u64 begin = 0; begin < sizes[0]; begin += sizes[1])
+            co_await sendAltMod(key, std::min(sizes[1], sizes[0] - begin), chl);
+    }
+}
@@ -1,5 +1,9 @@
 #pragma once
 #include "secure-join/Prf/AltModPrfProto.h"
+#include "ScratchArena.h"
+
+#include <optional>
+#include <thread>
 
 namespace uppid
 {
@@ -19,12 +23,48 @@ namespace uppid
 
         // For AltMod
         oc::u64 mOteBatch;
+        oc::u64 mNumThreads = std::max(1u, std::thread::hardware_concurrency());
         secJoin::AltModPrf::KeyType mAmKey;
+        // keys drawn by rotateKey, oldest first
+        std::vector<secJoin::AltModPrf::KeyType> mRotatedKeys;
+
+        // key of a rotateKey / retireKeys that is not committed yet
+        std::optional<secJoin::AltModPrf::KeyType> mPendingKey;
+        bool mPendingRetire = false;
 
         // For DDH
         struct DdhImpl;
         std::unique_ptr<DdhImpl> mDdh;
 
+        // see setWanMode
+        bool mWan = false;
+
+        // OPRF output shares, reused across calls
+        enum Scratch : oc::u64
+        {
+            ScratchMyShare,
+            ScratchTheirShare,
+            ScratchRekey,
+            NumScratch
+        };
+        ScratchArena mScratch{ NumScratch };
+
+        // one OPRF round: UID = F_key(input) ^ F_theirKey(input), with
+        // F_key(input) taken from myPrf if it is not empty.
+        // input and UID must not overlap.
+        Proto recvAltMod(
+            const secJoin::AltModPrf::KeyType& key,
+            oc::span<oc::block> input,
+            oc::span<const oc::block> myPrf,
+            oc::span<oc::block> UID,
+            oc::u64 numThreads,
+            Socket& chl);
+
+        Proto sendAltMod(
+            const secJoin::AltModPrf::KeyType& key,
+            oc::u64 theirSize,
+            Socket& chl);
+
     public:
 
         DoublePrf();
@@ -46,6 +86,77 @@ namespace uppid
             std::vector<oc::block>& UID, 
             Socket& chl);
 
+        // Same, with my half F_myKey(input) already computed by evalLocal.
+        Proto recv(
+            oc::span<oc::block> input, 
+            oc::span<const oc::block> myPrf, 
+            std::vector<oc::block>& UID, 
+            Socket& chl);
+
         Proto send(Socket& chl);
+
+        // My half of the double PRF, myPrf = F_myKey(input), without any
+        // interaction (AltMod only). Lets a trusted loader compute it ahead
+        // of recv. With rotated keys it is the half of the first epoch.
+        void evalLocal(
+            oc::span<const oc::block> input,
+            oc::span<oc::block> myPrf) const;
+
+        // threads for the local PRF evaluation
+        void setNumThreads(oc::u64 numThreads)
+        {
+            mNumThreads = std::max<oc::u64>(1, numThreads);
+        }
+
+        // Key rotation (AltMod only). Both parties rotate together. A UID of
+        // epoch e is mapped to epoch e + 1 by another double PRF under the
+        // new keys, so rekey / respondRekey re-derive existing UIDs, and
+        // recv / send chain all epochs for new inputs (one OPRF per epoch).
+        //
+        // The new key stays pending, i.e. recv / send keep to the old
+        // epochs, until commitKey once both parties hold their re-derived
+        // UIDs. Without a commit the next rotateKey draws another key.
+        void rotateKey();
+        oc::u64 numKeyEpochs() const { return 1 + mRotatedKeys.size(); }
+
+        // Replace every epoch by one fresh key (AltMod only), so that recv /
+        // send cost a single OPRF again. UIDs of the old epochs do not map to
+        // the new one, recv re-derives them from the raw inputs. Both parties
+        // retire together. The fresh key is pending as in rotateKey, but recv
+        // / send run under it alone already, to re-derive the UIDs.
+        void retireKeys();
+
+        // make the pending key of rotateKey / retireKeys the current one
+        void commitKey();
+        bool hasPendingKey() const { return mPendingKey.has_value(); }
+
+        // rekeyed[i] = UID[i] mapped to the pending epoch of rotateKey,
+        // chunkSize UIDs per OPRF call. The two must not overlap. The local
+        // PRF is evaluated on numThreads threads.
+        Proto rekey(
+            oc::span<oc::block> UID,
+            oc::span<oc::block> rekeyed,
+            oc::u64 chunkSize,
+            oc::u64 numThreads,
+            Socket& chl);
+
+        // peer side of rekey
+        Proto respondRekey(Socket& chl);
+
+        void setAllocPolicy(const AllocPolicy& policy)
+        {
+            mScratch.setPolicy(policy);
+        }
+
+        PageReport pageReport() const { return mScratch.pageReport(); }
+
+        // WAN mode (DDH only): recv sends no input size, the peer reads it
+        // off the masked inputs. AltMod needs the size before its first
+        // message, which is sent in the same flight, so it is unchanged.
+        // Both parties must agree.
+        void setWanMode(bool wan)
+        {
+            mWan = wan;
+        }
     };
 }
\ No newline at end of file
@@ -0,0 +1,323 @@
+#include "IdIngest.h"
+#include "cryptoTools/Crypto/RandomOracle.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring> // memcpy
+#include <future>
+
+using namespace std;
+using namespace oc;
+
+namespace uppid
+{
+    static std::string normalize(std::string s, Normalize mode)
+    {
+        if (mode == Normalize::None)
+            return s;
+
+        if (mode == Normalize::Digits)
+        {
+            s.erase(std::remove_if(s.begin(), s.end(),
+                [](unsigned char c) { return !std::isdigit(c); }), s.end());
+            return s;
+        }
+
+        auto isSpace = [](unsigned char c) { return std::isspace(c); };
+        auto begin = std::find_if_not(s.begin(), s.end(), isSpace);
+        auto end = std::find_if_not(s.rbegin(), s.rend(), isSpace).base();
+        s = begin < end ? std::string(begin, end) : std::string();
+
+        if (mode == Normalize::Lower)
+            for (auto& c : s)
+                c = (char)std::tolower((unsigned char)c);
+        return s;
+    }
+
+    oc::block IdHasher::hash(oc::span<const std::string> fields) const
+    {
+        // every part is length-prefixed, so (domain, fields) is parsed uniquely
+        oc::RandomOracle ro(sizeof(oc::block));
+        u64 size = mDomain.size();
+        ro.Update(size);
+        ro.Update((const u8*)mDomain.data(), size);
+        for (auto& f : fields)
+        {
+            size = f.size();
+            ro.Update(size);
+            ro.Update((const u8*)f.data(), size);
+        }
+
+        oc::block h;
+        ro.Final(h);
+        return h;
+    }
+
+    IdFileReader::IdFileReader(const std::string& path, const IngestParams& params)
+        : mParams(params)
+        , mHasher(params.mDomain)
+        , mFile(path, MappedFile::Mode::Read)
+    {
+        if (mParams.mIdColumns.empty() || mParams.mBatchSize == 0)
+            throw RTE_LOC;
+
+        u64 maxColumn = 0;
+        for (auto c : mParams.mIdColumns)
+            maxColumn = std::max(maxColumn, c);
+        for (auto c : mParams.mDataColumns)
+            maxColumn = std::max(maxColumn, c);
+
+        if (mParams.mFormat == IdFormat::LengthPrefixed)
+        {
+            if (maxColumn >= mParams.mNumFields)
+                throw RTE_LOC;
+            mFieldsPerRecord = mParams.mNumFields;
+        }
+        else
+        {
+            mFieldsPerRecord = maxColumn + 1;
+            if (mParams.mHeader && nextRecordCsv())
+                mFields.clear();
+        }
+    }
+
+    bool IdFileReader::nextRecordCsv()
+    {
+        auto data = (const char*)mFile.data();
+        auto size = mFile.size();
+        auto delim = mParams.mDelimiter;
+
+        // skip blank lines
+        while (mPos < size && (data[mPos] == '\n' || data[mPos] == '\r'))
+            ++mPos;
+        if (mPos >= size)
+            return false;
+
+        u64 n = 0;
+        while (true)
+        {
+            Field f{ mPos, 0, false };
+            if (mPos < size && data[mPos] == '"')
+            {
+                f.mQuoted = true;
+                f.mBegin = ++mPos;
+                while (mPos < size)
+                {
+                    if (data[mPos] == '"')
+                    {
+                        if (mPos + 1 < size && data[mPos + 1] == '"')
+                        {
+                            mPos += 2;
+                            continue;
+                        }
+                        break;
+                    }
+                    ++mPos;
+                }
+                f.mSize = mPos - f.mBegin;
+
+                // closing quote and anything up to the delimiter is dropped
+                while (mPos < size && data[mPos] != delim && data[mPos] != '\n')
+                    ++mPos;
+            }
+            else
+            {
+                while (mPos < size && data[mPos] != delim && data[mPos] != '\n')
+                    ++mPos;
+                f.mSize = mPos - f.mBegin;
+                if (f.mSize && data[f.mBegin + f.mSize - 1] == '\r')
+                    --f.mSize;
+            }
+
+            if (n++ < mFieldsPerRecord)
+                mFields.push_back(f);
+
+            if (mPos >= size || data[mPos] == '\n')
+            {
+                mPos = std::min(mPos + 1, size);
+                break;
+            }
+            ++mPos; // delimiter
+        }
+
+        // missing trailing fields are empty
+        for (; n < mFieldsPerRecord; ++n)
+            mFields.push_back({ 0, 0, false });
+        return true;
+    }
+
+    bool IdFileReader::nextRecordBinary()
+    {
+        auto data = mFile.data();
+        auto size = mFile.size();
+        if (mPos >= size)
+            return false;
+
+        for (u64 i = 0; i < mParams.mNumFields; ++i)
+        {
+            u32 len;
+            if (mPos + sizeof(len) > size)
+                throw RTE_LOC;
+            std::memcpy(&len, data + mPos, sizeof(len));
+            mPos += sizeof(len);
+
+            if (mPos + len > size)
+                throw RTE_LOC;
+            mFields.push_back({ mPos, len, false });
+            mPos += len;
+        }
+        return true;
+    }
+
+    std::string IdFileReader::fieldValue(const Field& f) const
+    {
+        auto begin = (const char*)mFile.data() + f.mBegin;
+        if (!f.mQuoted)
+            return std::string(begin, f.mSize);
+
+        // "" -> "
+        std::string s;
+        s.reserve(f.mSize);
+        for (u64 i = 0; i < f.mSize; ++i)
+        {
+            s.push_back(begin[i]);
+            if (begin[i] == '"')
+                ++i;
+        }
+        return s;
+    }
+
+    bool IdFileReader::next(std::vector<oc::block>& ids, oc::Matrix<oc::u8>& data)
+    {
+        const u64 batchBegin = mPos;
+        const bool csv = mParams.mFormat == IdFormat::Csv;
+
+        mFields.clear();
+        u64 rows = 0;
+        while (rows < mParams.mBatchSize && (csv ? nextRecordCsv() : nextRecordBinary()))
+            ++rows;
+        if (rows == 0)
+            return false;
+
+        // start reading the next batch, assuming records of similar size
+        mFile.willNeed(mPos, mPos - batchBegin);
+
+        const u64 cols = data.cols();
+        ids.resize(rows);
+        if (cols)
+            data.resize(rows, cols, oc::AllocType::Uninitialized);
+
+        auto work = [&](u64 begin, u64 end) {
+            std::vector<std::string> fields(mParams.mIdColumns.size());
+            for (u64 i = begin; i < end; ++i)
+            {
+                auto record = &mFields[i * mFieldsPerRecord];
+                for (u64 c = 0; c < fields.size(); ++c)
+                {
+                    auto mode = c < mParams.mNormalize.size() ? mParams.mNormalize[c] : Normalize::None;
+                    fields[c] = normalize(fieldValue(record[mParams.mIdColumns[c]]), mode);
+                }
+                ids[i] = mHasher.hash(fields);
+
+                if (cols)
+                {
+                    auto row = data.data(i);
+                    std::memset(row, 0, cols);
+                    u64 offset = 0;
+                    for (auto c : mParams.mDataColumns)
+                    {
+                        auto v = fieldValue(record[c]);
+                        auto n = std::min<u64>(v.size(), cols - offset);
+                        std::memcpy(row + offset, v.data(), n);
+                        offset += n;
+                    }
+                }
+            }
+        };
+
+        const u64 numThreads = std::max<u64>(1, std::min(mParams.mNumThreads, rows));
+        std::vector<std::thread> threads;
+        for (u64 t = 1; t < numThreads; ++t)
+            threads.emplace_back(work, rows * t / numThreads, rows * (t + 1) / numThreads);
+        work(0, rows / numThreads);
+        for (auto& t : threads)
+            t.join();
+
+        // this batch is done, its pages can go
+        mFile.dontNeed(batchBegin, mPos - batchBegin);
+        mRowsRead += rows;
+        return true;
+    }
+
+    Proto ingest_P0(PseudonymisedDB_P0& db, IdFileReader& reader, Socket& chl)
+    {
+        const u64 cols = db.getData().cols();
+        std::vector<oc::block> ids, nextIds;
+        oc::Matrix<oc::u8> data(0, cols), nextData(0, cols);
+
+        bool more = reader.next(ids, data);
+        while (more)
+        {
+            // hash the next batch while this one is inserted
+            auto prefetch = std::async(std::launch::async,
+                [&] { return reader.next(nextIds, nextData); });
+
+            co_await chl.send(u8(1));
+            if (cols)
+                co_await db.insertID(ids, data, chl);
+            else
+                co_await db.insertID(ids, chl);
+
+            more = prefetch.get();
+            std::swap(ids, nextIds);
+            std::swap(data, nextData);
+        }
+        co_await chl.send(u8(0));
+    }
+
+    Proto ingest_P1(PseudonymisedDB_P1& db, IdFileReader& reader, Socket& chl)
+    {
+        const u64 cols = db.getData().cols();
+        std::vector<oc::block> ids, nextIds;
+        oc::Matrix<oc::u8> data(0, cols), nextData(0, cols);
+
+        bool more = reader.next(ids, data);
+        while (more)
+        {
+            auto prefetch = std::async(std::launch::async,
+                [&] { return reader.next(nextIds, nextData); });
+
+            co_await chl.send(u8(1));
+            co_await db.insertID(ids, data, chl);
+
+            more = prefetch.get();
+            std::swap(ids, nextIds);
+            std::swap(data, nextData);
+        }
+        co_await chl.send(u8(0));
+    }
+
+    Proto serveIngest_P0(PseudonymisedDB_P0& db, Socket& chl)
+    {
+        while (true)
+        {
+            u8 more;
+            co_await chl.recv(more);
+            if (!more)
+                break;
+            co_await db.respondOPRF(chl);
+        }
+    }
+
+    Proto serveIngest_P1(PseudonymisedDB_P1& db, Socket& chl)
+    {
+        while (true)
+        {
+            u8 more;
+            co_await chl.recv(more);
+            if (!more)
+                break;
+            co_await db.respondOPRF(chl);
+        }
+    }
+}
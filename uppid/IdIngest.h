@@ -0,0 +1,119 @@
+#pragma once
+#include "PseudonymisedDB.h"
+#include "MappedFile.h"
+
+#include <string>
+#include <thread>
+
+namespace uppid
+{
+    enum class IdFormat
+    {
+        // delimiter separated text, one record per line. Fields may be
+        // double-quoted, with "" for a literal quote.
+        Csv,
+        // binary records of mNumFields fields, each a little-endian u32
+        // length followed by that many bytes
+        LengthPrefixed
+    };
+
+    // Normalization of an identifier field before hashing.
+    enum class Normalize
+    {
+        // bytes as they are
+        None,
+        // strip surrounding whitespace
+        Trim,
+        // strip surrounding whitespace and lower-case ASCII (e-mail addresses)
+        Lower,
+        // keep the decimal digits only (national ids, phone numbers)
+        Digits
+    };
+
+    struct IngestParams
+    {
+        IdFormat mFormat = IdFormat::Csv;
+
+        // Csv only
+        char mDelimiter = ',';
+        bool mHeader = true;
+
+        // LengthPrefixed only
+        oc::u64 mNumFields = 1;
+
+        // Fields that make up the identifier, and how each one is normalized
+        // (missing entries mean Normalize::None).
+        std::vector<oc::u64> mIdColumns = { 0 };
+        std::vector<Normalize> mNormalize;
+
+        // Fields copied into the payload row, concatenated and zero-padded /
+        // truncated to the payload width (P_0: its ownDataByteSize).
+        std::vector<oc::u64> mDataColumns;
+
+        // Identifiers hashed under different domains never collide.
+        std::string mDomain = "uppid.id.v1";
+
+        oc::u64 mBatchSize = 1ull << 20;
+        oc::u64 mNumThreads = std::thread::hardware_concurrency();
+    };
+
+    // Hash of one normalized identifier: H(domain, |f_1|, f_1, |f_2|, f_2, ...),
+    // truncated to a block.
+    class IdHasher
+    {
+        std::string mDomain;
+
+    public:
+        IdHasher(const std::string& domain = IngestParams().mDomain)
+            : mDomain(domain)
+        {}
+
+        oc::block hash(oc::span<const std::string> fields) const;
+    };
+
+    // Reads identifiers (and payloads) from a file in batches. The file is
+    // memory-mapped; records are split serially and normalized and hashed on
+    // mNumThreads threads.
+    class IdFileReader
+    {
+        IngestParams mParams;
+        IdHasher mHasher;
+        MappedFile mFile;
+        oc::u64 mPos = 0;
+        oc::u64 mRowsRead = 0;
+
+        struct Field
+        {
+            oc::u64 mBegin, mSize;
+            bool mQuoted;
+        };
+
+        // fields of the records of the current batch, mNumFields per record
+        std::vector<Field> mFields;
+        oc::u64 mFieldsPerRecord = 0;
+
+        bool nextRecordCsv();
+        bool nextRecordBinary();
+        std::string fieldValue(const Field& f) const;
+
+    public:
+        IdFileReader(const std::string& path, const IngestParams& params);
+
+        // Read up to mBatchSize records. Returns false at the end of the file.
+        // data is resized to (#rows, data.cols()) if mDataColumns is not empty.
+        bool next(std::vector<oc::block>& ids, oc::Matrix<oc::u8>& data);
+
+        oc::u64 rowsRead() const { return mRowsRead; }
+    };
+
+    // Stream the identifiers of a file into the DB, one insertID per batch.
+    // The next batch is hashed while the current one is inserted. Before every
+    // batch a continue flag is sent, so the peer serves the OPRF calls with
+    // serveIngest_P0/P1 without knowing the number of batches.
+    Proto ingest_P0(PseudonymisedDB_P0& db, IdFileReader& reader, Socket& chl);
+    Proto ingest_P1(PseudonymisedDB_P1& db, IdFileReader& reader, Socket& chl);
+
+    // Peer side of ingest_P1 / ingest_P0: respondOPRF until the stream ends.
+    Proto serveIngest_P0(PseudonymisedDB_P0& db, Socket& chl);
+    Proto serveIngest_P1(PseudonymisedDB_P1& db, Socket& chl);
+}
@@ -0,0 +1,187 @@
+#include "Kernels.h"
+#include "KernelsImpl.h"
+#include "cryptoTools/Crypto/AES.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+
+using namespace oc;
+
+namespace uppid
+{
+    // highest first
+    static const KernelTable* const allKernels[] = { &kernelsAvx512, &kernelsAvx2, &kernelsSse };
+
+    static bool cpuSupports(const KernelTable* k)
+    {
+        __builtin_cpu_init();
+        if (k == &kernelsAvx512)
+            return 
+                __builtin_cpu_supports("avx512f") &&
+                __builtin_cpu_supports("avx512dq") &&
+                __builtin_cpu_supports("avx512vl") &&
+                __builtin_cpu_supports("avx2");
+        if (k == &kernelsAvx2)
+            return __builtin_cpu_supports("avx2");
+        return true;
+    }
+
+    static const KernelTable* detectKernels()
+    {
+        // the best supported one, or the best one not above the requested one
+        auto requested = std::getenv("UPPID_KERNEL_ISA");
+        bool reached = requested == nullptr;
+        for (auto k : allKernels)
+        {
+            reached = reached || std::strcmp(requested, k->mName) == 0;
+            if (reached && cpuSupports(k))
+                return k;
+        }
+        return &kernelsSse;
+    }
+
+    static std::atomic<const KernelTable*>& kernelSlot()
+    {
+        static std::atomic<const KernelTable*> k(detectKernels());
+        return k;
+    }
+
+    static const KernelTable& kernels()
+    {
+        return *kernelSlot().load(std::memory_order_relaxed);
+    }
+
+    const char* kernelIsa()
+    {
+        return kernels().mName;
+    }
+
+    std::vector<std::string> supportedKernelIsas()
+    {
+        std::vector<std::string> names;
+        for (auto i = std::size(allKernels); i-- > 0;)
+            if (cpuSupports(allKernels[i]))
+                names.push_back(allKernels[i]->mName);
+        return names;
+    }
+
+    void setKernelIsa(const std::string& name)
+    {
+        for (auto k : allKernels)
+        {
+            if (name == k->mName)
+            {
+                if (!cpuSupports(k))
+                    throw RTE_LOC;
+                kernelSlot().store(k, std::memory_order_relaxed);
+                return;
+            }
+        }
+        throw RTE_LOC;
+    }
+
+    void xorBlocks(
+        oc::block* dst,
+        const oc::block* src,
+        oc::u64 n)
+    {
+        kernels().xorBlocks(dst, src, n);
+    }
+
+    void xorBytes(
+        oc::u8* dst,
+        const oc::u8* src,
+        oc::u64 n)
+    {
+        const u64 numBlk = n / sizeof(oc::block);
+        kernels().xorBlocks((oc::block*)dst, (const oc::block*)src, numBlk);
+        for (u64 i = numBlk * sizeof(oc::block); i < n; ++i)
+            dst[i] ^= src[i];
+    }
+
+    void xorBlocks3(
+        oc::block* dst,
+        const oc::block* a,
+        const oc::block* b,
+        const oc::block* c,
+        oc::u64 n)
+    {
+        kernels().xorBlocks3(dst, a, b, c, n);
+    }
+
+    void maskRows(
+        const oc::u8* bits,
+        oc::block* rows,
+        oc::u64 numRows,
+        oc::u64 blocksPerRow)
+    {
+        kernels().maskRows(bits, rows, numRows, blocksPerRow);
+    }
+
+    void maskedXorRows(
+        const oc::u8* bits,
+        const oc::block* src,
+        oc::block* dst,
+        oc::u64 numRows,
+        oc::u64 blocksPerRow)
+    {
+        kernels().maskedXorRows(bits, src, dst, numRows, blocksPerRow);
+    }
+
+    void selectRows(
+        const oc::u8* bits,
+        const oc::block* x0,
+        const oc::block* x1,
+        oc::block* dst,
+        oc::u64 numRows,
+        oc::u64 blocksPerRow)
+    {
+        kernels().selectRows(bits, x0, x1, dst, numRows, blocksPerRow);
+    }
+
+    void unpackBits(
+        const oc::u8* bits,
+        oc::u8* bytes,
+        oc::u64 n)
+    {
+        kernels().unpackBits(bits, bytes, n);
+    }
+
+    void packBits(
+        const oc::u8* bytes,
+        oc::u8* bits,
+        oc::u64 n)
+    {
+        kernels().packBits(bytes, bits, n);
+    }
+
+    void packRows(
+        const oc::u8* src,
+        oc::u64 numRows,
+        oc::u64 colsBytes,
+        oc::block* dst)
+    {
+        kernels().packRows(src, numRows, colsBytes, dst);
+    }
+
+    void unpackRows(
+        const oc::block* src,
+        oc::u64 numRows,
+        oc::u64 colsBytes,
+        oc::u8* dst)
+    {
+        kernels().unpackRows(src, numRows, colsBytes, dst);
+    }
+
+    void expandRows(
+        const oc::block* keys,
+        oc::u64 keyStride,
+        oc::u64 numRows,
+        oc::u64 blocksPerRow,
+        oc::block* out)
+    {
+        kernels().expandRows(keys, keyStride, numRows, blocksPerRow, 
+            oc::mAesFixedKey.mRoundKey.data(), out);
+    }
+}
@@ -0,0 +1,107 @@
+#pragma once
+#include "cryptoTools/Common/Defines.h"
+
+#include <string>
+#include <vector>
+
+// Local hot loops shared by the protocols.
+// Rows are stored as blocksPerRow consecutive blocks, and bit i of a row
+// selection is bit (i % 8) of bits[i / 8], the BitVector layout.
+
+namespace uppid
+{
+    // The kernels are built for several instruction sets (sse, avx2,
+    // avx512) and the best one the CPU supports is picked on first use.
+    // The environment variable UPPID_KERNEL_ISA can ask for a lower one.
+
+    // name of the instruction set in use
+    const char* kernelIsa();
+
+    // instruction sets this CPU can run, lowest first
+    std::vector<std::string> supportedKernelIsas();
+
+    // switch to one of supportedKernelIsas(), throws otherwise
+    void setKernelIsa(const std::string& name);
+
+    // dst[k] ^= src[k]
+    void xorBlocks(
+        oc::block* dst,
+        const oc::block* src,
+        oc::u64 n);
+
+    // dst[k] ^= src[k] for n bytes: xorBlocks on the whole blocks, then the
+    // tail. Neither needs to be aligned.
+    void xorBytes(
+        oc::u8* dst,
+        const oc::u8* src,
+        oc::u64 n);
+
+    // dst[k] = a[k] ^ b[k] ^ c[k]
+    void xorBlocks3(
+        oc::block* dst,
+        const oc::block* a,
+        const oc::block* b,
+        const oc::block* c,
+        oc::u64 n);
+
+    // row i = bit i ? row i : 0
+    void maskRows(
+        const oc::u8* bits,
+        oc::block* rows,
+        oc::u64 numRows,
+        oc::u64 blocksPerRow);
+
+    // row i of dst ^= bit i ? row i of src : 0
+    void maskedXorRows(
+        const oc::u8* bits,
+        const oc::block* src,
+        oc::block* dst,
+        oc::u64 numRows,
+        oc::u64 blocksPerRow);
+
+    // row i of dst = bit i ? row i of x1 : row i of x0
+    void selectRows(
+        const oc::u8* bits,
+        const oc::block* x0,
+        const oc::block* x1,
+        oc::block* dst,
+        oc::u64 numRows,
+        oc::u64 blocksPerRow);
+
+    // bytes[i] = bit i, for i < n
+    void unpackBits(
+        const oc::u8* bits,
+        oc::u8* bytes,
+        oc::u64 n);
+
+    // bit i = bytes[i] & 1, for i < n
+    void packBits(
+        const oc::u8* bytes,
+        oc::u8* bits,
+        oc::u64 n);
+
+    // Copy rows of colsBytes bytes into rows of (colsBytes + 15) / 16
+    // blocks, zero padded.
+    void packRows(
+        const oc::u8* src,
+        oc::u64 numRows,
+        oc::u64 colsBytes,
+        oc::block* dst);
+
+    // Inverse of packRows, the padding is dropped.
+    void unpackRows(
+        const oc::block* src,
+        oc::u64 numRows,
+        oc::u64 colsBytes,
+        oc::u8* dst);
+
+    // Stretch one random OT message per row to blocksPerRow blocks: row i is
+    // k_i, H(k_i ^ 1), ..., H(k_i ^ (blocksPerRow - 1)) with the fixed-key
+    // hash H(x) = AES(x) ^ x. Key i is keys[i * keyStride].
+    void expandRows(
+        const oc::block* keys,
+        oc::u64 keyStride,
+        oc::u64 numRows,
+        oc::u64 blocksPerRow,
+        oc::block* out);
+}
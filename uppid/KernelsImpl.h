@@ -0,0 +1,395 @@
+// Bodies of the kernels declared in Kernels.h.
+//
+// This file is compiled once per instruction set: Kernels_<isa>.cpp define
+// UPPID_KERNEL_ISA / UPPID_KERNEL_TABLE and are built with the matching
+// -m flags, Kernels.cpp picks one of the tables at startup. Code in here
+// only works on raw vectors: an inline function of another header that is
+// emitted out of line in an AVX-512 copy could be picked by the linker for
+// every caller.
+
+#include "cryptoTools/Common/Defines.h"
+
+#include <cstring>
+#include <immintrin.h>
+#include <type_traits>
+
+namespace uppid
+{
+    struct KernelTable
+    {
+        const char* mName;
+
+        void (*xorBlocks)(oc::block*, const oc::block*, oc::u64);
+        void (*xorBlocks3)(oc::block*, const oc::block*, const oc::block*, const oc::block*, oc::u64);
+        void (*maskRows)(const oc::u8*, oc::block*, oc::u64, oc::u64);
+        void (*maskedXorRows)(const oc::u8*, const oc::block*, oc::block*, oc::u64, oc::u64);
+        void (*selectRows)(const oc::u8*, const oc::block*, const oc::block*, oc::block*, oc::u64, oc::u64);
+        void (*unpackBits)(const oc::u8*, oc::u8*, oc::u64);
+        void (*packBits)(const oc::u8*, oc::u8*, oc::u64);
+        void (*packRows)(const oc::u8*, oc::u64, oc::u64, oc::block*);
+        void (*unpackRows)(const oc::block*, oc::u64, oc::u64, oc::u8*);
+        void (*expandRows)(const oc::block*, oc::u64, oc::u64, oc::u64, const oc::block*, oc::block*);
+    };
+
+    extern const KernelTable kernelsSse, kernelsAvx2, kernelsAvx512;
+}
+
+#ifdef UPPID_KERNEL_ISA
+
+namespace uppid
+{
+    namespace UPPID_KERNEL_ISA
+    {
+        using oc::u8;
+        using oc::u64;
+        using oc::block;
+
+        // Calls f(std::integral_constant<u64, N>{}) if n is one of Ns, and
+        // f(std::integral_constant<u64, 0>{}) otherwise.
+        template<u64... Ns, typename F>
+        static inline void dispatchWidth(u64 n, F&& f)
+        {
+            bool fixed = ((n == Ns ? (f(std::integral_constant<u64, Ns>{}), true) : false) || ...);
+            if (!fixed)
+                f(std::integral_constant<u64, 0>{});
+        }
+
+        static inline bool getBit(const u8* bits, u64 i)
+        {
+            return (bits[i >> 3] >> (i & 7)) & 1;
+        }
+
+        static inline __m128i load(const block* p) { return _mm_loadu_si128((const __m128i*)p); }
+        static inline void store(block* p, __m128i v) { _mm_storeu_si128((__m128i*)p, v); }
+
+#ifdef __AVX512F__
+        // A zmm register holds four 1-block rows. Lane mask of the 8 u64 lanes
+        // for each 4-bit row selection.
+        static constexpr __mmask8 laneMask(u64 n)
+        {
+            __mmask8 m = 0;
+            for (u64 r = 0; r < 4; ++r)
+                if ((n >> r) & 1)
+                    m |= __mmask8(3u << (2 * r));
+            return m;
+        }
+        static constexpr __mmask8 laneMasks[16] = {
+            laneMask(0), laneMask(1), laneMask(2), laneMask(3),
+            laneMask(4), laneMask(5), laneMask(6), laneMask(7),
+            laneMask(8), laneMask(9), laneMask(10), laneMask(11),
+            laneMask(12), laneMask(13), laneMask(14), laneMask(15) };
+
+        static inline __m512i load4(const block* p) { return _mm512_loadu_si512((const void*)p); }
+        static inline void store4(block* p, __m512i v) { _mm512_storeu_si512((void*)p, v); }
+#endif
+
+#ifdef __AVX2__
+        static inline __m256i load2(const block* p) { return _mm256_loadu_si256((const __m256i*)p); }
+        static inline void store2(block* p, __m256i v) { _mm256_storeu_si256((__m256i*)p, v); }
+#endif
+
+        static void xorBlocks(
+            block* dst,
+            const block* src,
+            u64 n)
+        {
+            u64 k = 0;
+#if defined(__AVX512F__)
+            for (; k + 4 <= n; k += 4)
+                store4(dst + k, _mm512_xor_si512(load4(dst + k), load4(src + k)));
+#elif defined(__AVX2__)
+            for (; k + 2 <= n; k += 2)
+                store2(dst + k, _mm256_xor_si256(load2(dst + k), load2(src + k)));
+#endif
+            for (; k < n; ++k)
+                store(dst + k, _mm_xor_si128(load(dst + k), load(src + k)));
+        }
+
+        static void xorBlocks3(
+            block* dst,
+            const block* a,
+            const block* b,
+            const block* c,
+            u64 n)
+        {
+            u64 k = 0;
+#if defined(__AVX512F__)
+            for (; k + 4 <= n; k += 4)
+                store4(dst + k, _mm512_ternarylogic_epi64(
+                    load4(a + k), load4(b + k), load4(c + k), 0x96));
+#elif defined(__AVX2__)
+            for (; k + 2 <= n; k += 2)
+                store2(dst + k, _mm256_xor_si256(
+                    _mm256_xor_si256(load2(a + k), load2(b + k)), load2(c + k)));
+#endif
+            for (; k < n; ++k)
+                store(dst + k, _mm_xor_si128(_mm_xor_si128(load(a + k), load(b + k)), load(c + k)));
+        }
+
+        static void maskRows(
+            const u8* bits,
+            block* rows,
+            u64 numRows,
+            u64 blocksPerRow)
+        {
+            u64 i = 0;
+#ifdef __AVX512F__
+            if (blocksPerRow == 1)
+            {
+                for (; i + 8 <= numRows; i += 8)
+                {
+                    auto b = bits[i >> 3];
+                    store4(rows + i, _mm512_maskz_mov_epi64(laneMasks[b & 15], load4(rows + i)));
+                    store4(rows + i + 4, _mm512_maskz_mov_epi64(laneMasks[b >> 4], load4(rows + i + 4)));
+                }
+            }
+#endif
+            dispatchWidth<1, 2, 4>(blocksPerRow, [&](auto fixed) {
+                const u64 bpr = fixed() ? fixed() : blocksPerRow;
+                for (; i < numRows; ++i)
+                {
+                    if (!getBit(bits, i))
+                    {
+                        for (u64 j = 0; j < bpr; ++j)
+                            store(rows + i * bpr + j, _mm_setzero_si128());
+                    }
+                }
+            });
+        }
+
+        static void maskedXorRows(
+            const u8* bits,
+            const block* src,
+            block* dst,
+            u64 numRows,
+            u64 blocksPerRow)
+        {
+            u64 i = 0;
+#ifdef __AVX512F__
+            if (blocksPerRow == 1)
+            {
+                for (; i + 8 <= numRows; i += 8)
+                {
+                    auto b = bits[i >> 3];
+                    auto d0 = load4(dst + i);
+                    auto d1 = load4(dst + i + 4);
+                    store4(dst + i, _mm512_mask_xor_epi64(d0, laneMasks[b & 15], d0, load4(src + i)));
+                    store4(dst + i + 4, _mm512_mask_xor_epi64(d1, laneMasks[b >> 4], d1, load4(src + i + 4)));
+                }
+            }
+#endif
+            dispatchWidth<1, 2, 4>(blocksPerRow, [&](auto fixed) {
+                const u64 bpr = fixed() ? fixed() : blocksPerRow;
+                for (; i < numRows; ++i)
+                {
+                    if (getBit(bits, i))
+                    {
+                        for (u64 j = 0; j < bpr; ++j)
+                        {
+                            auto k = i * bpr + j;
+                            store(dst + k, _mm_xor_si128(load(dst + k), load(src + k)));
+                        }
+                    }
+                }
+            });
+        }
+
+        static void selectRows(
+            const u8* bits,
+            const block* x0,
+            const block* x1,
+            block* dst,
+            u64 numRows,
+            u64 blocksPerRow)
+        {
+            u64 i = 0;
+#ifdef __AVX512F__
+            if (blocksPerRow == 1)
+            {
+                for (; i + 8 <= numRows; i += 8)
+                {
+                    auto b = bits[i >> 3];
+                    store4(dst + i, _mm512_mask_mov_epi64(load4(x0 + i), laneMasks[b & 15], load4(x1 + i)));
+                    store4(dst + i + 4, _mm512_mask_mov_epi64(load4(x0 + i + 4), laneMasks[b >> 4], load4(x1 + i + 4)));
+                }
+            }
+#endif
+            dispatchWidth<1, 2, 4>(blocksPerRow, [&](auto fixed) {
+                const u64 bpr = fixed() ? fixed() : blocksPerRow;
+                for (; i < numRows; ++i)
+                {
+                    auto x = getBit(bits, i) ? x1 : x0;
+                    for (u64 j = 0; j < bpr; ++j)
+                        store(dst + i * bpr + j, load(x + i * bpr + j));
+                }
+            });
+        }
+
+        static void unpackBits(
+            const u8* bits,
+            u8* bytes,
+            u64 n)
+        {
+            // spread the 8 bits of a byte over the 8 bytes of a word
+            u64 i = 0;
+            for (; i + 8 <= n; i += 8)
+            {
+                u64 w = (bits[i >> 3] * 0x0101010101010101ull) & 0x8040201008040201ull;
+                w = ((w + 0x7F7F7F7F7F7F7F7Full) >> 7) & 0x0101010101010101ull;
+                std::memcpy(bytes + i, &w, 8);
+            }
+            for (; i < n; ++i)
+                bytes[i] = getBit(bits, i);
+        }
+
+        static void packBits(
+            const u8* bytes,
+            u8* bits,
+            u64 n)
+        {
+            u64 i = 0;
+#ifdef __AVX2__
+            for (; i + 32 <= n; i += 32)
+            {
+                auto v = _mm256_loadu_si256((const __m256i*)(bytes + i));
+                oc::u32 m = _mm256_movemask_epi8(_mm256_slli_epi16(v, 7));
+                std::memcpy(bits + (i >> 3), &m, 4);
+            }
+#endif
+            for (; i + 16 <= n; i += 16)
+            {
+                auto v = _mm_loadu_si128((const __m128i*)(bytes + i));
+                std::uint16_t m = _mm_movemask_epi8(_mm_slli_epi16(v, 7));
+                std::memcpy(bits + (i >> 3), &m, 2);
+            }
+            for (; i < n; i += 8)
+            {
+                u8 b = 0;
+                for (u64 j = 0; j < 8 && i + j < n; ++j)
+                    b |= u8(bytes[i + j] & 1) << j;
+                bits[i >> 3] = b;
+            }
+        }
+
+        static void packRows(
+            const u8* src,
+            u64 numRows,
+            u64 colsBytes,
+            block* dst)
+        {
+            const u64 bpr = (colsBytes + 15) / 16;
+            dispatchWidth<4, 8, 16, 32, 64>(colsBytes, [&](auto fixed) {
+                if constexpr (fixed() != 0)
+                {
+                    // whole rows with a constant size, no per-block staging
+                    constexpr u64 bytes = fixed();
+                    constexpr u64 blocks = (bytes + 15) / 16;
+                    for (u64 i = 0; i < numRows; ++i)
+                    {
+                        if constexpr (bytes % 16)
+                            store(dst + i * blocks + blocks - 1, _mm_setzero_si128());
+                        std::memcpy(dst + i * blocks, src + i * bytes, bytes);
+                    }
+                }
+                else
+                {
+                    for (u64 i = 0; i < numRows; ++i)
+                    {
+                        if (colsBytes % 16)
+                            store(dst + i * bpr + bpr - 1, _mm_setzero_si128());
+                        std::memcpy(dst + i * bpr, src + i * colsBytes, colsBytes);
+                    }
+                }
+            });
+        }
+
+        static void unpackRows(
+            const block* src,
+            u64 numRows,
+            u64 colsBytes,
+            u8* dst)
+        {
+            const u64 bpr = (colsBytes + 15) / 16;
+            dispatchWidth<4, 8, 16, 32, 64>(colsBytes, [&](auto fixed) {
+                constexpr u64 bytes = fixed();
+                constexpr u64 blocks = (bytes + 15) / 16;
+                for (u64 i = 0; i < numRows; ++i)
+                {
+                    if constexpr (bytes != 0)
+                        std::memcpy(dst + i * bytes, src + i * blocks, bytes);
+                    else
+                        std::memcpy(dst + i * colsBytes, src + i * bpr, colsBytes);
+                }
+            });
+        }
+
+        // p[k] = AES(p[k]) ^ p[k] for k < n, the n blocks interleaved
+        template<u64 N>
+        static inline void mmoHash(const __m128i* rk, block* const* p, u64 n)
+        {
+            __m128i x[N], y[N];
+            for (u64 k = 0; k < n; ++k)
+            {
+                x[k] = load(p[k]);
+                y[k] = _mm_xor_si128(x[k], rk[0]);
+            }
+            for (u64 r = 1; r < 10; ++r)
+                for (u64 k = 0; k < n; ++k)
+                    y[k] = _mm_aesenc_si128(y[k], rk[r]);
+            for (u64 k = 0; k < n; ++k)
+                store(p[k], _mm_xor_si128(_mm_aesenclast_si128(y[k], rk[10]), x[k]));
+        }
+
+        static void expandRows(
+            const block* keys,
+            u64 keyStride,
+            u64 numRows,
+            u64 blocksPerRow,
+            const block* roundKeys,
+            block* out)
+        {
+            __m128i rk[11];
+            for (u64 r = 0; r < 11; ++r)
+                rk[r] = load(roundKeys + r);
+
+            constexpr u64 batch = 8;
+            block* pending[batch];
+            u64 numPending = 0;
+
+            for (u64 i = 0; i < numRows; ++i)
+            {
+                auto key = load(keys + i * keyStride);
+                store(out + i * blocksPerRow, key);
+                for (u64 j = 1; j < blocksPerRow; ++j)
+                {
+                    auto p = out + i * blocksPerRow + j;
+                    store(p, _mm_xor_si128(key, _mm_set_epi64x(0, j)));
+                    pending[numPending++] = p;
+                    if (numPending == batch)
+                    {
+                        mmoHash<batch>(rk, pending, batch);
+                        numPending = 0;
+                    }
+                }
+            }
+            mmoHash<batch>(rk, pending, numPending);
+        }
+    }
+
+    extern const KernelTable UPPID_KERNEL_TABLE;
+    const KernelTable UPPID_KERNEL_TABLE = {
+        UPPID_KERNEL_NAME,
+        &UPPID_KERNEL_ISA::xorBlocks,
+        &UPPID_KERNEL_ISA::xorBlocks3,
+        &UPPID_KERNEL_ISA::maskRows,
+        &UPPID_KERNEL_ISA::maskedXorRows,
+        &UPPID_KERNEL_ISA::selectRows,
+        &UPPID_KERNEL_ISA::unpackBits,
+        &UPPID_KERNEL_ISA::packBits,
+        &UPPID_KERNEL_ISA::packRows,
+        &UPPID_KERNEL_ISA::unpackRows,
+        &UPPID_KERNEL_ISA::expandRows
+    };
+}
+
+#endif
@@ -0,0 +1,5 @@
+// Kernels built with the avx2 flags, see uppid/CMakeLists.txt.
+#define UPPID_KERNEL_ISA avx2
+#define UPPID_KERNEL_NAME "avx2"
+#define UPPID_KERNEL_TABLE kernelsAvx2
+#include "KernelsImpl.h"
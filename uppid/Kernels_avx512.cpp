@@ -0,0 +1,5 @@
+// Kernels built with the avx512 flags, see uppid/CMakeLists.txt.
+#define UPPID_KERNEL_ISA avx512
+#define UPPID_KERNEL_NAME "avx512"
+#define UPPID_KERNEL_TABLE kernelsAvx512
+#include "KernelsImpl.h"
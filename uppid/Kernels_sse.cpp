@@ -0,0 +1,5 @@
+// Kernels built with the sse flags, see uppid/CMakeLists.txt.
+#define UPPID_KERNEL_ISA sse
+#define UPPID_KERNEL_NAME "sse"
+#define UPPID_KERNEL_TABLE kernelsSse
+#include "KernelsImpl.h"
@@ -0,0 +1,155 @@
+#include "MappedFile.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+using namespace oc;
+
+namespace uppid
+{
+    static void throwErrno(const std::string& what, const std::string& path)
+    {
+        throw std::runtime_error(what + " " + path + ": " + std::strerror(errno));
+    }
+
+    // madvise/msync need a page aligned start
+    static void pageRange(u64 base, u64 offset, u64 bytes, u64 size, u64& begin, u64& len)
+    {
+        static const u64 pageSize = sysconf(_SC_PAGESIZE);
+        auto end = std::min(offset + bytes, size);
+        begin = offset / pageSize * pageSize;
+        len = end > begin ? end - begin : 0;
+        begin += base;
+    }
+
+    MappedFile::MappedFile(MappedFile&& o) noexcept
+        : mPath(std::move(o.mPath))
+        , mFd(std::exchange(o.mFd, -1))
+        , mData(std::exchange(o.mData, nullptr))
+        , mSize(std::exchange(o.mSize, 0))
+        , mWritable(o.mWritable)
+    {}
+
+    MappedFile& MappedFile::operator=(MappedFile&& o) noexcept
+    {
+        if (this != &o)
+        {
+            close();
+            mPath = std::move(o.mPath);
+            mFd = std::exchange(o.mFd, -1);
+            mData = std::exchange(o.mData, nullptr);
+            mSize = std::exchange(o.mSize, 0);
+            mWritable = o.mWritable;
+        }
+        return *this;
+    }
+
+    void MappedFile::open(const std::string& path, Mode mode, oc::u64 size)
+    {
+        close();
+        mPath = path;
+        mWritable = mode != Mode::Read;
+
+        int flags = mWritable ? O_RDWR : O_RDONLY;
+        if (mode == Mode::Create)
+            flags |= O_CREAT | O_TRUNC;
+
+        mFd = ::open(path.c_str(), flags, 0600);
+        if (mFd < 0)
+            throwErrno("failed to open", path);
+
+        if (mode == Mode::Create)
+        {
+            if (ftruncate(mFd, size))
+                throwErrno("failed to size", path);
+            mSize = size;
+        }
+        else
+        {
+            struct stat st;
+            if (fstat(mFd, &st))
+                throwErrno("failed to stat", path);
+            mSize = st.st_size;
+        }
+
+        map();
+    }
+
+    void MappedFile::map()
+    {
+        if (mSize == 0)
+            return;
+
+        auto prot = PROT_READ | (mWritable ? PROT_WRITE : 0);
+        auto ptr = mmap(nullptr, mSize, prot, MAP_SHARED, mFd, 0);
+        if (ptr == MAP_FAILED)
+            throwErrno("failed to map", mPath);
+        mData = (u8*)ptr;
+    }
+
+    void MappedFile::unmap()
+    {
+        if (mData)
+            munmap(mData, mSize);
+        mData = nullptr;
+    }
+
+    void MappedFile::close()
+    {
+        unmap();
+        if (mFd >= 0)
+            ::close(mFd);
+        mFd = -1;
+        mSize = 0;
+    }
+
+    void MappedFile::resize(oc::u64 size)
+    {
+        if (!isOpen() || !mWritable)
+            throw RTE_LOC;
+
+        unmap();
+        if (ftruncate(mFd, size))
+            throwErrno("failed to size", mPath);
+        mSize = size;
+        map();
+    }
+
+    void MappedFile::willNeed(oc::u64 offset, oc::u64 bytes)
+    {
+        u64 begin, len;
+        pageRange(u64(mData), offset, bytes, mSize, begin, len);
+        if (len)
+            madvise((void*)begin, len, MADV_WILLNEED);
+    }
+
+    void MappedFile::dontNeed(oc::u64 offset, oc::u64 bytes)
+    {
+        u64 begin, len;
+        pageRange(u64(mData), offset, bytes, mSize, begin, len);
+        if (len)
+            madvise((void*)begin, len, MADV_DONTNEED);
+    }
+
+    void MappedFile::flushAsync(oc::u64 offset, oc::u64 bytes)
+    {
+        u64 begin, len;
+        pageRange(u64(mData), offset, bytes, mSize, begin, len);
+        if (len && mWritable)
+            msync((void*)begin, len, MS_ASYNC);
+    }
+
+    void MappedFile::flush()
+    {
+        if (mData && mWritable && msync(mData, mSize, MS_SYNC))
+            throwErrno("failed to flush", mPath);
+    }
+}
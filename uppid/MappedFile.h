@@ -0,0 +1,81 @@
+#pragma once
+#include "cryptoTools/Common/Defines.h"
+
+#include <string>
+
+namespace uppid
+{
+    // A file mapped into memory (MAP_SHARED). Writes through the mapping end up
+    // in the file; the kernel pages data in and out, so the file may be much
+    // larger than RAM.
+    class MappedFile
+    {
+        std::string mPath;
+        int mFd = -1;
+        oc::u8* mData = nullptr;
+        oc::u64 mSize = 0;
+        bool mWritable = false;
+
+        void map();
+        void unmap();
+
+    public:
+        enum class Mode
+        {
+            // existing file, read only
+            Read,
+            // existing file, read and write
+            ReadWrite,
+            // create or truncate, read and write
+            Create
+        };
+
+        MappedFile() = default;
+        MappedFile(const std::string& path, Mode mode, oc::u64 size = 0)
+        {
+            open(path, mode, size);
+        }
+        ~MappedFile() { close(); }
+
+        MappedFile(MappedFile&& o) noexcept;
+        MappedFile& operator=(MappedFile&& o) noexcept;
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        // With Mode::Create the file is sized to size bytes.
+        void open(const std::string& path, Mode mode, oc::u64 size = 0);
+
+        // Unmap and close. Dirty pages are still written back by the kernel.
+        void close();
+
+        // Grow or shrink the file and remap it. Previous pointers are invalid.
+        void resize(oc::u64 size);
+
+        bool isOpen() const { return mFd >= 0; }
+        const std::string& path() const { return mPath; }
+        oc::u64 size() const { return mSize; }
+        oc::u8* data() { return mData; }
+        const oc::u8* data() const { return mData; }
+
+        // The file viewed as an array of T; the size is rounded down.
+        template<typename T>
+        oc::span<T> as()
+        {
+            return oc::span<T>((T*)mData, mSize / sizeof(T));
+        }
+
+        // Hint that [offset, offset + bytes) is read soon; the kernel starts
+        // reading it in the background.
+        void willNeed(oc::u64 offset, oc::u64 bytes);
+
+        // Drop the pages of [offset, offset + bytes) from this mapping. The
+        // data stays in the file (dirty pages are written back first).
+        void dontNeed(oc::u64 offset, oc::u64 bytes);
+
+        // Start writing back [offset, offset + bytes) without waiting.
+        void flushAsync(oc::u64 offset, oc::u64 bytes);
+
+        // Write back everything and wait.
+        void flush();
+    };
+}
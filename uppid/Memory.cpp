@@ -0,0 +1,217 @@
+#include "Memory.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+using namespace oc;
+
+namespace uppid
+{
+    static constexpr u64 PageSize = 1ull << 12;
+    static constexpr u64 HugePageSize = 1ull << 21;
+
+    // from <linux/mempolicy.h>, which is not always installed
+    static constexpr int MpolBind = 2;
+    static constexpr unsigned MpolMfMove = 1u << 1;
+    static constexpr u64 MaxNumaNodes = 1024;
+
+    static u64 roundUp(u64 x, u64 m) { return (x + m - 1) / m * m; }
+
+    // Bind [ptr, ptr + bytes) to node. Failures are ignored: a kernel without
+    // NUMA support just keeps the default placement.
+    static void bindNode(void* ptr, u64 bytes, int node, bool move)
+    {
+        if (node < 0)
+            return;
+        if (u64(node) >= MaxNumaNodes)
+            throw RTE_LOC;
+
+        unsigned long mask[MaxNumaNodes / 64] = {};
+        mask[node / 64] |= 1ul << (node % 64);
+        syscall(SYS_mbind, ptr, bytes, MpolBind, mask, MaxNumaNodes, move ? MpolMfMove : 0);
+    }
+
+    oc::u8* allocPages(oc::u64 bytes, const AllocPolicy& policy, oc::u64& mappedBytes)
+    {
+        void* ptr = MAP_FAILED;
+        if (policy.mHugePages == HugePages::Explicit)
+        {
+            mappedBytes = roundUp(bytes, HugePageSize);
+            ptr = mmap(nullptr, mappedBytes, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        }
+
+        if (ptr == MAP_FAILED)
+        {
+            // whole huge pages so that the tail can be backed by one as well
+            mappedBytes = roundUp(bytes,
+                policy.mHugePages == HugePages::None ? PageSize : HugePageSize);
+            ptr = mmap(nullptr, mappedBytes, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (ptr == MAP_FAILED)
+                throw std::bad_alloc();
+
+            if (policy.mHugePages != HugePages::None)
+                madvise(ptr, mappedBytes, MADV_HUGEPAGE);
+        }
+
+        // nothing is touched yet, so binding places every page on first touch
+        bindNode(ptr, mappedBytes, policy.mNumaNode, false);
+        return (u8*)ptr;
+    }
+
+    void freePages(oc::u8* ptr, oc::u64 mappedBytes)
+    {
+        if (ptr)
+            munmap(ptr, mappedBytes);
+    }
+
+    void adviseRange(void* ptr, oc::u64 bytes, const AllocPolicy& policy)
+    {
+        if (policy.isDefault())
+            return;
+
+        auto begin = roundUp(u64(ptr), PageSize);
+        auto end = (u64(ptr) + bytes) / PageSize * PageSize;
+        if (end <= begin)
+            return;
+
+        if (policy.mHugePages != HugePages::None)
+            madvise((void*)begin, end - begin, MADV_HUGEPAGE);
+        bindNode((void*)begin, end - begin, policy.mNumaNode, true);
+    }
+
+    void AdvisedRange::update(void* ptr, oc::u64 bytes, const AllocPolicy& policy)
+    {
+        if (ptr != mPtr)
+        {
+            adviseRange(ptr, bytes, policy);
+            mPtr = ptr;
+            mBytes = bytes;
+        }
+        else if (bytes > mBytes)
+        {
+            adviseRange((u8*)ptr + mBytes, bytes - mBytes, policy);
+            mBytes = bytes;
+        }
+    }
+
+    PageReport pageReport(const void* ptr, oc::u64 bytes)
+    {
+        PageReport r;
+        if (bytes == 0)
+            return r;
+
+        std::ifstream smaps("/proc/self/smaps");
+        if (!smaps)
+            return r;
+
+        // smaps counts whole mappings. Those are scaled by the part of them
+        // that overlaps the range, i.e. assume their pages are spread evenly.
+        auto lo = u64(ptr), hi = u64(ptr) + bytes;
+        double frac = 0;
+        std::string line;
+        while (std::getline(smaps, line))
+        {
+            std::istringstream ss(line);
+            std::string key;
+            ss >> key;
+            if (key.empty())
+                continue;
+
+            if (key.back() != ':')
+            {
+                // mapping header "start-end perms offset dev inode path"
+                auto dash = key.find('-');
+                if (dash == std::string::npos)
+                    continue;
+                auto start = std::stoull(key.substr(0, dash), nullptr, 16);
+                auto end = std::stoull(key.substr(dash + 1), nullptr, 16);
+                auto oLo = std::max(start, lo), oHi = std::min(end, hi);
+                frac = oLo < oHi ? double(oHi - oLo) / double(end - start) : 0;
+                continue;
+            }
+
+            if (frac == 0)
+                continue;
+
+            u64 kb = 0;
+            ss >> kb;
+            auto scaled = u64(double(kb << 10) * frac);
+            if (key == "Rss:")
+                r.mResident += scaled;
+            else if (key == "AnonHugePages:")
+                r.mHuge += scaled;
+            else if (key == "Private_Hugetlb:" || key == "Shared_Hugetlb:")
+            {
+                // hugetlb pages are not part of Rss
+                r.mResident += scaled;
+                r.mHuge += scaled;
+            }
+            else if (key == "KernelPageSize:")
+                r.mKernelPageSize = std::max(r.mKernelPageSize, kb << 10);
+        }
+        return r;
+    }
+
+    oc::u64 numaNodeCount()
+    {
+        namespace fs = std::filesystem;
+        std::error_code ec;
+        u64 count = 0;
+        for (auto& entry : fs::directory_iterator("/sys/devices/system/node", ec))
+        {
+            auto name = entry.path().filename().string();
+            if (name.size() > 4 && name.compare(0, 4, "node") == 0 &&
+                std::isdigit((unsigned char)name[4]))
+                ++count;
+        }
+        return std::max<u64>(count, 1);
+    }
+
+    bool pinToNode(int node)
+    {
+        if (node < 0)
+            return false;
+
+        // e.g. "0-15,32-47"
+        std::ifstream in("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+        std::string list;
+        if (!std::getline(in, list))
+            return false;
+
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        std::stringstream ss(list);
+        std::string range;
+        u64 count = 0;
+        while (std::getline(ss, range, ','))
+        {
+            if (range.empty() || !std::isdigit((unsigned char)range[0]))
+                continue;
+            auto dash = range.find('-');
+            u64 first = std::stoull(range.substr(0, dash));
+            u64 last = dash == std::string::npos ? first : std::stoull(range.substr(dash + 1));
+            for (u64 c = first; c <= last && c < CPU_SETSIZE; ++c, ++count)
+                CPU_SET(c, &set);
+        }
+
+        return count && pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+    }
+
+    std::string toString(const PageReport& r)
+    {
+        std::stringstream ss;
+        ss << "resident " << (r.mResident >> 20) << " MiB, huge "
+            << (r.mHuge >> 20) << " MiB, max page " << (r.mKernelPageSize >> 10) << " KiB";
+        return ss.str();
+    }
+}
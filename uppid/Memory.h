@@ -0,0 +1,88 @@
+#pragma once
+#include "cryptoTools/Common/Defines.h"
+
+#include <algorithm>
+#include <string>
+
+namespace uppid
+{
+    enum class HugePages
+    {
+        // regular 4 KiB pages
+        None = 0,
+        // transparent huge pages, madvise(MADV_HUGEPAGE)
+        Transparent = 1,
+        // hugetlbfs pages, mmap(MAP_HUGETLB). Needs pages reserved in
+        // /proc/sys/vm/nr_hugepages; falls back to Transparent otherwise.
+        Explicit = 2
+    };
+
+    // How the large tables and scratch buffers are backed.
+    struct AllocPolicy
+    {
+        // no NUMA binding, pages go wherever they are first touched
+        static constexpr int AnyNode = -1;
+
+        HugePages mHugePages = HugePages::None;
+        int mNumaNode = AnyNode;
+
+        bool isDefault() const
+        {
+            return mHugePages == HugePages::None && mNumaNode == AnyNode;
+        }
+    };
+
+    // Pages of a memory range that are currently resident, by page size.
+    struct PageReport
+    {
+        oc::u64 mResident = 0;
+        oc::u64 mHuge = 0;
+        oc::u64 mKernelPageSize = 0;
+
+        PageReport& operator+=(const PageReport& o)
+        {
+            mResident += o.mResident;
+            mHuge += o.mHuge;
+            mKernelPageSize = std::max(mKernelPageSize, o.mKernelPageSize);
+            return *this;
+        }
+    };
+
+    // Anonymous mapping of at least bytes bytes that follows policy.
+    // Returns the mapped size in mappedBytes; pass it back to freePages.
+    oc::u8* allocPages(oc::u64 bytes, const AllocPolicy& policy, oc::u64& mappedBytes);
+
+    void freePages(oc::u8* ptr, oc::u64 mappedBytes);
+
+    // Apply policy to memory that is already allocated (e.g. a std::vector).
+    // Only whole pages inside the range are affected. Explicit huge pages
+    // cannot be retrofitted, they are treated as Transparent. Resident pages
+    // are migrated to the requested node.
+    void adviseRange(void* ptr, oc::u64 bytes, const AllocPolicy& policy);
+
+    // Tracks which prefix of a growing buffer already follows a policy, so
+    // that repeated calls only advise the memory that is new.
+    struct AdvisedRange
+    {
+        const void* mPtr = nullptr;
+        oc::u64 mBytes = 0;
+
+        void update(void* ptr, oc::u64 bytes, const AllocPolicy& policy);
+    };
+
+    // Resident and huge page bytes of [ptr, ptr + bytes), read from
+    // /proc/self/smaps. A mapping that only partly overlaps the range counts
+    // with the overlapping fraction of its pages, so ranges inside a larger
+    // heap mapping are estimates; allocPages ranges are exact.
+    PageReport pageReport(const void* ptr, oc::u64 bytes);
+
+    // Number of NUMA nodes, 1 if the system has no NUMA support.
+    oc::u64 numaNodeCount();
+
+    // Restrict the calling thread to the CPUs of node. Returns false if
+    // that fails, e.g. without NUMA support; the thread then keeps running
+    // anywhere.
+    bool pinToNode(int node);
+
+    std::string toString(const PageReport& r);
+}
@@ -0,0 +1,184 @@
+#include "MultiKeySsLeftJoin.h"
+#include "Kernels.h"
+
+#include <algorithm>
+#include <cstring> // memcpy
+
+using namespace std;
+using namespace oc;
+
+namespace uppid
+{
+    void MultiKeySsLeftJoinBase::init(
+        oc::u64 dataByteSize,
+        oc::u64 numKeys,
+        oc::block seed)
+    {
+        if (numKeys == 0)
+            throw RTE_LOC;
+        mNumKeys = numKeys;
+        mDataByteSize = dataByteSize;
+        mPrng.SetSeed(oc::mAesFixedKey.hashBlock(seed));
+        mMux.init(mPrng.get());
+    }
+
+    void MultiKeySsLeftJoinBase::flatten(
+        oc::MatrixView<const oc::block> ids,
+        std::vector<oc::block>& out)
+    {
+        const u64 k = mNumKeys;
+        if (ids.cols() != k)
+            throw RTE_LOC;
+
+        out.resize(ids.rows() * k);
+        for (u64 i = 0; i < ids.rows(); ++i)
+        {
+            for (u64 j = 0; j < k; ++j)
+            {
+                auto id = ids(i, j);
+                out[i * k + j] = id == oc::ZeroBlock
+                    ? mPrng.get<oc::block>()
+                    : oc::mAesFixedKey.hashBlock(id ^ oc::block(j, 0));
+            }
+        }
+
+        // the join takes sets, so every identifier may be in one row only
+        auto sorted = out;
+        std::sort(sorted.begin(), sorted.end());
+        if (std::adjacent_find(sorted.begin(), sorted.end()) != sorted.end())
+            throw RTE_LOC;
+    }
+
+    Proto MultiKeySsLeftJoinBase::combine(
+        oc::u64 partyIdx,
+        const oc::BitVector& flatMem,
+        const oc::Matrix<oc::u8>& flatData,
+        oc::BitVector& memShares,
+        oc::Matrix<oc::u8>& valueShares,
+        Socket& chl)
+    {
+        const u64 k = mNumKeys;
+        const u64 bs = mDataByteSize;
+        if (flatMem.size() % k || flatData.rows() != flatMem.size())
+            throw RTE_LOC;
+        const u64 n = flatMem.size() / k;
+
+        // payload || flag byte, the flag set by party 0 only
+        const u64 bpr = (bs + 1 + 15) / 16;
+        const u8 flag = partyIdx == 0;
+
+        auto outSpan = mScratch.get<oc::block>(ScratchOut, n * bpr);
+        auto rowSpan = mScratch.get<oc::block>(ScratchRows, n * bpr);
+        oc::MatrixView<oc::block> out(outSpan.data(), n, bpr);
+        oc::MatrixView<oc::block> rows(rowSpan.data(), n, bpr);
+        std::fill(outSpan.begin(), outSpan.end(), oc::ZeroBlock);
+
+        oc::BitVector mj(n);
+        for (u64 j = k; j-- > 0;)
+        {
+            // rows = (p_j || 1) ^ out, muxed down to m_j * rows
+            for (u64 i = 0; i < n; ++i)
+            {
+                auto row = rows.data(i);
+                auto bytes = (u8*)row;
+                row[bpr - 1] = oc::ZeroBlock;
+                std::memcpy(bytes, flatData.data(i * k + j), bs);
+                bytes[bs] = flag;
+                xorBlocks(row, out.data(i), bpr);
+                mj[i] = flatMem[i * k + j];
+            }
+
+            co_await mMux.apply(partyIdx, mj, rows, chl);
+
+            // out = m_j ? (p_j || 1) : out
+            xorBlocks(out.data(), rows.data(), n * bpr);
+        }
+
+        const u64 rowOffset = valueShares.rows();
+        if (rowOffset && valueShares.cols() != bs)
+            throw RTE_LOC;
+        valueShares.resize(rowOffset + n, bs, oc::AllocType::Uninitialized);
+        const u64 memOffset = memShares.size();
+        memShares.resize(memOffset + n);
+        for (u64 i = 0; i < n; ++i)
+        {
+            auto bytes = (const u8*)out.data(i);
+            std::memcpy(valueShares.data(rowOffset + i), bytes, bs);
+            memShares[memOffset + i] = bytes[bs] & 1;
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////
+    // sender
+
+    void MultiKeySsLeftJoinSender::init(
+        oc::u64 dataByteSize,
+        oc::u64 numKeys,
+        oc::block seed,
+        oc::u64 oteBatchSize)
+    {
+        MultiKeySsLeftJoinBase::init(dataByteSize, numKeys, seed);
+        mJoin.init(dataByteSize, seed, oteBatchSize);
+    }
+
+    Proto MultiKeySsLeftJoinSender::send(
+        oc::MatrixView<const oc::block> Y,
+        oc::MatrixView<oc::u8> datas,
+        oc::BitVector& memShares,
+        oc::Matrix<oc::u8>& valueShares,
+        Socket& chl)
+    {
+        const u64 k = mNumKeys;
+        const u64 bs = mDataByteSize;
+        if (datas.rows() != Y.rows() || datas.cols() != bs)
+            throw RTE_LOC;
+
+        std::vector<oc::block> flatY;
+        flatten(Y, flatY);
+
+        auto flatSpan = mScratch.get<u8>(ScratchFlatData, Y.rows() * k * bs);
+        oc::MatrixView<u8> flatData(flatSpan.data(), Y.rows() * k, bs);
+        for (u64 i = 0; i < Y.rows(); ++i)
+            for (u64 j = 0; j < k; ++j)
+                std::memcpy(flatData.data(i * k + j), datas.data(i), bs);
+
+        oc::BitVector flatMem;
+        oc::Matrix<oc::u8> flatShares(0, bs);
+        co_await mJoin.send(flatY, flatData, flatMem, flatShares, chl);
+        setTimePoint("join");
+
+        co_await combine(1, flatMem, flatShares, memShares, valueShares, chl);
+        setTimePoint("combine");
+    }
+
+    //////////////////////////////////////////////////////////////////
+    // receiver
+
+    void MultiKeySsLeftJoinReceiver::init(
+        oc::u64 dataByteSize,
+        oc::u64 numKeys,
+        oc::block seed,
+        oc::u64 oteBatchSize)
+    {
+        MultiKeySsLeftJoinBase::init(dataByteSize, numKeys, seed);
+        mJoin.init(dataByteSize, seed, oteBatchSize);
+    }
+
+    Proto MultiKeySsLeftJoinReceiver::recv(
+        oc::MatrixView<const oc::block> X,
+        oc::BitVector& memShares,
+        oc::Matrix<oc::u8>& valueShares,
+        Socket& chl)
+    {
+        std::vector<oc::block> flatX;
+        flatten(X, flatX);
+
+        oc::BitVector flatMem;
+        oc::Matrix<oc::u8> flatShares(0, mDataByteSize);
+        co_await mJoin.recv(flatX, flatMem, flatShares, chl);
+        setTimePoint("join");
+
+        co_await combine(0, flatMem, flatShares, memShares, valueShares, chl);
+        setTimePoint("combine");
+    }
+}
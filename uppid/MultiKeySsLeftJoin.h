@@ -0,0 +1,139 @@
+#pragma once
+#include "SsLeftJoin.h"
+#include "SecureMux.h"
+
+namespace uppid
+{
+    // Left join on rows with up to k identifiers (email, phone, ...): a row
+    // of X matches a row of Y if the identifiers of some slot j agree.
+    //
+    // All k|X| and k|Y| identifiers go through one SSLJ, slot j tweaked so it
+    // only meets slot j of the other side. The k per-slot results of a row are
+    // then folded from the last slot down, so the lowest matching slot wins:
+    //   out = 0,  out = m_j ? (p_j || 1) : out   for j = k-1, ..., 0
+    // Each step is one mux on n rows of the payload plus a flag byte, whose
+    // low bit ends up as the membership bit.
+    //
+    // The payload of a row of Y still goes into the join once per slot: which
+    // slot matched is only known inside the CPSI, and fetching a payload by
+    // a shared row index afterwards costs more than the copies.
+    //
+    // Identifiers are given as a (rows x k) matrix; oc::ZeroBlock marks an
+    // absent identifier. An identifier may occur in at most one row of
+    // each side.
+    struct MultiKeySsLeftJoinBase
+    {
+        oc::u64 mNumKeys = 0;
+        oc::u64 mDataByteSize = 0;
+        oc::PRNG mPrng;
+        SecureMux mMux;
+
+        // per-call buffers, kept across calls
+        enum Scratch : oc::u64
+        {
+            ScratchFlatData,
+            ScratchRows,
+            ScratchOut,
+            NumScratch
+        };
+        ScratchArena mScratch{ NumScratch };
+
+        void init(
+            oc::u64 dataByteSize,
+            oc::u64 numKeys,
+            oc::block seed);
+
+        // slot-tweaked identifiers, absent ones replaced by random dummies.
+        // Throws if an identifier occurs twice.
+        void flatten(
+            oc::MatrixView<const oc::block> ids,
+            std::vector<oc::block>& out);
+
+        // merge the k per-slot results of every row, appending to
+        // memShares and valueShares
+        Proto combine(
+            oc::u64 partyIdx,
+            const oc::BitVector& flatMem,
+            const oc::Matrix<oc::u8>& flatData,
+            oc::BitVector& memShares,
+            oc::Matrix<oc::u8>& valueShares,
+            Socket& chl);
+    };
+
+    class MultiKeySsLeftJoinSender : public MultiKeySsLeftJoinBase, oc::TimerAdapter
+    {
+        SsLeftJoinSender mJoin;
+
+    public:
+        // back the per-call buffers by policy (huge pages, NUMA node)
+        void setAllocPolicy(const AllocPolicy& policy)
+        {
+            mJoin.setAllocPolicy(policy);
+            mMux.setAllocPolicy(policy);
+            mScratch.setPolicy(policy);
+        }
+
+        PageReport pageReport() const
+        {
+            auto r = mJoin.mScratch.pageReport();
+            r += mMux.pageReport();
+            r += mScratch.pageReport();
+            return r;
+        }
+
+        void init(
+            oc::u64 dataByteSize,
+            oc::u64 numKeys,
+            oc::block seed = oc::ZeroBlock,
+            oc::u64 oteBatchSize = 1ull << 22);
+
+        /**
+         * input: Y (|Y| x k identifiers), datas
+         * output: memShares, valueShares, one row per row of X
+         * - memShares[i]   = (x[i] matches some y)
+         * - valueShares[i] = shares of the payload of the y matched by the
+         *                    lowest slot, zero if there is none
+         */
+        Proto send(
+            oc::MatrixView<const oc::block> Y,
+            oc::MatrixView<oc::u8> datas,
+            oc::BitVector& memShares,
+            oc::Matrix<oc::u8>& valueShares,
+            Socket& chl);
+    };
+
+    class MultiKeySsLeftJoinReceiver : public MultiKeySsLeftJoinBase, oc::TimerAdapter
+    {
+        SsLeftJoinReceiver mJoin;
+
+    public:
+        // back the per-call buffers by policy (huge pages, NUMA node)
+        void setAllocPolicy(const AllocPolicy& policy)
+        {
+            mJoin.setAllocPolicy(policy);
+            mMux.setAllocPolicy(policy);
+            mScratch.setPolicy(policy);
+        }
+
+        PageReport pageReport() const
+        {
+            auto r = mJoin.mScratch.pageReport();
+            r += mMux.pageReport();
+            r += mScratch.pageReport();
+            return r;
+        }
+
+        void init(
+            oc::u64 dataByteSize,
+            oc::u64 numKeys,
+            oc::block seed = oc::ZeroBlock,
+            oc::u64 oteBatchSize = 1ull << 22);
+
+        // See MultiKeySsLeftJoinSender::send.
+        Proto recv(
+            oc::MatrixView<const oc::block> X,
+            oc::BitVector& memShares,
+            oc::Matrix<oc::u8>& valueShares,
+            Socket& chl);
+    };
+}
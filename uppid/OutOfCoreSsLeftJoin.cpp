@@ -0,0 +1,252 @@
+#include "OutOfCoreSsLeftJoin.h"
+
+#include <cstring> // memcpy
+#include <filesystem>
+
+using namespace std;
+using namespace oc;
+
+namespace uppid
+{
+    // Name of a work file of the join that writes to out.
+    static std::string workFile(const OutOfCoreParams& params, const std::string& out, const char* ext)
+    {
+        auto name = std::filesystem::path(out).filename().string();
+        return (std::filesystem::path(params.mWorkDir) / (name + ext)).string();
+    }
+
+    // Counting sort of ids (and payload rows) into partition-major order,
+    // written to idFile (and payloadFile). If rowFile is given, it receives the
+    // original index of every binned row. Returns the k + 1 partition offsets.
+    static std::vector<u64> binRows(
+        oc::span<const oc::block> ids,
+        oc::MatrixView<oc::u8> payload,
+        u64 k,
+        MappedFile& idFile,
+        MappedFile* payloadFile,
+        MappedFile* rowFile)
+    {
+        std::vector<u64> offsets(k + 1, 0);
+        for (auto& id : ids)
+            ++offsets[partitionOf(id, k) + 1];
+        for (u64 p = 0; p < k; ++p)
+            offsets[p + 1] += offsets[p];
+
+        auto binnedIds = idFile.as<oc::block>();
+        auto cols = payload.cols();
+        auto cursor = offsets;
+        for (u64 i = 0; i < ids.size(); ++i)
+        {
+            auto j = cursor[partitionOf(ids[i], k)]++;
+            binnedIds[j] = ids[i];
+            if (payloadFile)
+                std::memcpy(payloadFile->data() + j * cols, payload.data(i), cols);
+            if (rowFile)
+                rowFile->as<u64>()[j] = i;
+        }
+        return offsets;
+    }
+
+    static std::vector<u64> prefixSum(const std::vector<u64>& counts)
+    {
+        std::vector<u64> offsets(counts.size() + 1, 0);
+        for (u64 p = 0; p < counts.size(); ++p)
+            offsets[p + 1] = offsets[p] + counts[p];
+        return offsets;
+    }
+
+    // Both parties learn the partition sizes of the other one.
+    static Proto exchangeCounts(
+        const std::vector<u64>& offsets,
+        std::vector<u64>& theirOffsets,
+        Socket& chl)
+    {
+        std::vector<u64> counts(offsets.size() - 1), theirCounts;
+        for (u64 p = 0; p < counts.size(); ++p)
+            counts[p] = offsets[p + 1] - offsets[p];
+
+        co_await chl.send(std::move(counts));
+        co_await chl.recvResize(theirCounts);
+        if (theirCounts.size() != offsets.size() - 1)
+            throw RTE_LOC;
+
+        theirOffsets = prefixSum(theirCounts);
+    }
+
+    // Copy the output of one partition to rows [begin, begin + n) of the
+    // output files and let the kernel write them back in the background.
+    static void writePartition(
+        const oc::BitVector& mem,
+        const oc::Matrix<oc::u8>& data,
+        u64 begin,
+        MappedFile& memFile,
+        MappedFile& dataFile)
+    {
+        auto n = mem.size();
+        auto cols = data.cols();
+        if (data.rows() != n)
+            throw RTE_LOC;
+
+        auto memOut = memFile.data() + begin;
+        for (u64 i = 0; i < n; ++i)
+            memOut[i] = mem[i];
+        std::memcpy(dataFile.data() + begin * cols, data.data(), n * cols);
+
+        memFile.flushAsync(begin, n);
+        dataFile.flushAsync(begin * cols, n * cols);
+        memFile.dontNeed(begin, n);
+        dataFile.dontNeed(begin * cols, n * cols);
+    }
+
+    //////////////////////////////////////////////////////////////////
+    // sender
+
+    void OutOfCoreSsLeftJoinSender::init(
+        oc::u64 dataByteSize,
+        const OutOfCoreParams& params,
+        oc::block seed,
+        oc::u64 oteBatchSize)
+    {
+        if (params.mNumPartitions == 0)
+            throw RTE_LOC;
+        mParams = params;
+        mDataByteSize = dataByteSize;
+        mJoin.init(dataByteSize, seed, oteBatchSize);
+    }
+
+    Proto OutOfCoreSsLeftJoinSender::send(
+        oc::span<oc::block> Y,
+        oc::MatrixView<oc::u8> datas,
+        const std::string& out,
+        Socket& chl)
+    {
+        const u64 k = mParams.mNumPartitions;
+        const u64 bs = mDataByteSize;
+        if (datas.rows() != Y.size() || datas.cols() != bs)
+            throw RTE_LOC;
+
+        MappedFile ids(workFile(mParams, out, ".ids"), MappedFile::Mode::Create, Y.size() * sizeof(block));
+        MappedFile payload(workFile(mParams, out, ".payload"), MappedFile::Mode::Create, Y.size() * bs);
+        auto offsets = binRows(Y, datas, k, ids, &payload, nullptr);
+        setTimePoint("bin");
+
+        std::vector<u64> theirOffsets;
+        co_await exchangeCounts(offsets, theirOffsets, chl);
+
+        // Newly sized files read as zero, so rows of skipped partitions hold a
+        // sharing of (not a member, zero payload).
+        const u64 outRows = theirOffsets[k];
+        MappedFile memFile(out + ".mem", MappedFile::Mode::Create, outRows);
+        MappedFile dataFile(out + ".data", MappedFile::Mode::Create, outRows * bs);
+
+        auto binnedIds = ids.as<oc::block>();
+        oc::BitVector mem;
+        oc::Matrix<oc::u8> data;
+        for (u64 p = 0; p < k; ++p)
+        {
+            auto begin = offsets[p], n = offsets[p + 1] - begin;
+            auto theirBegin = theirOffsets[p], theirN = theirOffsets[p + 1] - theirBegin;
+
+            // prefetch the next partition while this one is joined
+            if (p + 1 < k)
+            {
+                auto next = offsets[p + 1], nextN = offsets[p + 2] - next;
+                ids.willNeed(next * sizeof(block), nextN * sizeof(block));
+                payload.willNeed(next * bs, nextN * bs);
+            }
+
+            if (n == 0 || theirN == 0)
+                continue;
+
+            mem.resize(0);
+            data.resize(0, bs);
+            co_await mJoin.send(
+                binnedIds.subspan(begin, n),
+                oc::MatrixView<oc::u8>(payload.data() + begin * bs, n, bs),
+                mem, data, chl);
+
+            writePartition(mem, data, theirBegin, memFile, dataFile);
+            ids.dontNeed(begin * sizeof(block), n * sizeof(block));
+            payload.dontNeed(begin * bs, n * bs);
+        }
+        setTimePoint("join");
+
+        memFile.flush();
+        dataFile.flush();
+
+        ids.close();
+        payload.close();
+        std::filesystem::remove(workFile(mParams, out, ".ids"));
+        std::filesystem::remove(workFile(mParams, out, ".payload"));
+    }
+
+    //////////////////////////////////////////////////////////////////
+    // receiver
+
+    void OutOfCoreSsLeftJoinReceiver::init(
+        oc::u64 dataByteSize,
+        const OutOfCoreParams& params,
+        oc::block seed,
+        oc::u64 oteBatchSize)
+    {
+        if (params.mNumPartitions == 0)
+            throw RTE_LOC;
+        mParams = params;
+        mDataByteSize = dataByteSize;
+        mJoin.init(dataByteSize, seed, oteBatchSize);
+    }
+
+    Proto OutOfCoreSsLeftJoinReceiver::recv(
+        oc::span<oc::block> X,
+        const std::string& out,
+        Socket& chl)
+    {
+        const u64 k = mParams.mNumPartitions;
+        const u64 bs = mDataByteSize;
+
+        MappedFile ids(workFile(mParams, out, ".ids"), MappedFile::Mode::Create, X.size() * sizeof(block));
+        MappedFile rows(out + ".rows", MappedFile::Mode::Create, X.size() * sizeof(u64));
+        auto offsets = binRows(X, {}, k, ids, nullptr, &rows);
+        rows.flushAsync(0, rows.size());
+        setTimePoint("bin");
+
+        std::vector<u64> theirOffsets;
+        co_await exchangeCounts(offsets, theirOffsets, chl);
+
+        MappedFile memFile(out + ".mem", MappedFile::Mode::Create, X.size());
+        MappedFile dataFile(out + ".data", MappedFile::Mode::Create, X.size() * bs);
+
+        auto binnedIds = ids.as<oc::block>();
+        oc::BitVector mem;
+        oc::Matrix<oc::u8> data;
+        for (u64 p = 0; p < k; ++p)
+        {
+            auto begin = offsets[p], n = offsets[p + 1] - begin;
+            auto theirN = theirOffsets[p + 1] - theirOffsets[p];
+
+            if (p + 1 < k)
+            {
+                auto next = offsets[p + 1], nextN = offsets[p + 2] - next;
+                ids.willNeed(next * sizeof(block), nextN * sizeof(block));
+            }
+
+            if (n == 0 || theirN == 0)
+                continue;
+
+            mem.resize(0);
+            data.resize(0, bs);
+            co_await mJoin.recv(binnedIds.subspan(begin, n), mem, data, chl);
+
+            writePartition(mem, data, begin, memFile, dataFile);
+            ids.dontNeed(begin * sizeof(block), n * sizeof(block));
+        }
+        setTimePoint("join");
+
+        memFile.flush();
+        dataFile.flush();
+        rows.flush();
+
+        ids.close();
+        std::filesystem::remove(workFile(mParams, out, ".ids"));
+    }
+}
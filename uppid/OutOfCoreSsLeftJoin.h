@@ -0,0 +1,89 @@
+#pragma once
+#include "SsLeftJoin.h"
+#include "MappedFile.h"
+
+#include <string>
+
+namespace uppid
+{
+    // Out-of-core SSLJ for sets larger than RAM.
+    //
+    // Both parties bin their set (and payloads) by UID into partitions stored in
+    // memory-mapped files, then run SsLeftJoin one partition at a time. Only one
+    // partition's CPSI / P&S state is in memory at once. While a partition is
+    // joined, the next one is prefetched and the previous output rows are
+    // written back in the background.
+    //
+    // Output of both parties, |X| rows in partition-major order:
+    //   <out>.mem   one byte per row, a Boolean share of (x in Y)
+    //   <out>.data  dataByteSize bytes per row, a share of the payload of x
+    // The receiver also writes
+    //   <out>.rows  u64 per row, the index in X of that output row
+    //
+    // Leakage: on top of |X| and |Y|, the size of every partition of X and Y
+    // is revealed to the other party.
+
+    // Partition of a pseudonym, computed from its low 64 bits (the shards of
+    // ShardedPseudonymisedDB use the high ones).
+    inline oc::u64 partitionOf(const oc::block& uid, oc::u64 numPartitions)
+    {
+        auto prefix = uid.get<oc::u64>()[0];
+        return oc::u64((unsigned __int128)(prefix) * numPartitions >> 64);
+    }
+
+    struct OutOfCoreParams
+    {
+        // directory for the binned inputs, removed when the join is done
+        std::string mWorkDir = ".";
+
+        // more partitions = less RAM per step, more rounds and leakage
+        oc::u64 mNumPartitions = 16;
+    };
+
+    class OutOfCoreSsLeftJoinSender : public oc::TimerAdapter
+    {
+        SsLeftJoinSender mJoin;
+        OutOfCoreParams mParams;
+        oc::u64 mDataByteSize = 0;
+
+    public:
+        void init(
+            oc::u64 dataByteSize,
+            const OutOfCoreParams& params,
+            oc::block seed = oc::ZeroBlock,
+            oc::u64 oteBatchSize = 1ull << 22);
+
+        /**
+         * input: Y, datas (may themselves be memory-mapped)
+         * output: the files <out>.mem, <out>.data, see above
+         */
+        Proto send(
+            oc::span<oc::block> Y,
+            oc::MatrixView<oc::u8> datas,
+            const std::string& out,
+            Socket& chl);
+    };
+
+    class OutOfCoreSsLeftJoinReceiver : public oc::TimerAdapter
+    {
+        SsLeftJoinReceiver mJoin;
+        OutOfCoreParams mParams;
+        oc::u64 mDataByteSize = 0;
+
+    public:
+        void init(
+            oc::u64 dataByteSize,
+            const OutOfCoreParams& params,
+            oc::block seed = oc::ZeroBlock,
+            oc::u64 oteBatchSize = 1ull << 22);
+
+        /**
+         * input: X (may itself be memory-mapped)
+         * output: the files <out>.mem, <out>.data, <out>.rows, see above
+         */
+        Proto recv(
+            oc::span<oc::block> X,
+            const std::string& out,
+            Socket& chl);
+    };
+}
@@ -1,4 +1,7 @@
 #include "PseudonymisedDB.h"
+#include "Kernels.h"
+#include <array>
+#include <chrono>
 #include <cstring> // memcpy
 
 using namespace std;
@@ -18,106 +21,359 @@ namespace uppid
 
     // }
 
-    // helper: row-major Matrix<u8> <-> vector<block>
-
-    static inline void packToBlocks(
-        const oc::Matrix<oc::u8>& M,
-        oc::u64 rows,
-        oc::u64 colsBytes,
-        std::vector<oc::block>& out)
+    // Zero-share the payload shares of SSLJ (X, Y'): dataShare[i] becomes a
+    // share of memShare[i] * (payload[i] ^ base[i]). base is XORed onto the
+    // rows, which the mux then runs on in place if they are 16-byte aligned
+    // whole blocks and staged as blocks otherwise. The mux writes after its
+    // last message, and a failed one XORs base off again, so an interrupted
+    // mux leaves the join output as it was.
+    static Proto muxRows(
+        SecureMux& mux,
+        ScratchArena& scratch,
+        oc::u64 partyIdx,
+        const oc::BitVector& memShare,
+        oc::Matrix<oc::u8>& dataShare,
+        oc::MatrixView<const oc::u8> base,
+        Socket& chl)
     {
-        const oc::u64 numBlk = (colsBytes + 15) / 16;
-        out.resize(rows * numBlk);
+        const u64 rows = memShare.size();
+        const u64 cols = dataShare.cols();
+        const u64 numBlk = (cols + 15) / 16;
+        if (dataShare.rows() != rows || base.rows() != rows || base.cols() != cols)
+            throw RTE_LOC;
 
-        for (oc::u64 i = 0; i < rows; ++i)
+        bool inPlace = 
+            cols % sizeof(oc::block) == 0 &&
+            (std::uintptr_t)dataShare.data() % alignof(oc::block) == 0;
+
+        xorBytes(dataShare.data(), base.data(), dataShare.size());
+        try
         {
-            const oc::u8* rowPtr = M.data(i);
-            for (oc::u64 j = 0; j < numBlk; ++j)
-            {
-                alignas(16) oc::u8 buf[16] = {};
-                const oc::u64 off = j * 16;
-                const oc::u64 len = std::min<oc::u64>(16, colsBytes > off ? (colsBytes - off) : 0);
-                if (len) std::memcpy(buf, rowPtr + off, len);
-
-                oc::block b;
-                std::memcpy(&b, buf, 16);
-                out[i * numBlk + j] = b;
+            if (inPlace) {
+                co_await mux.apply(partyIdx, memShare, 
+                    oc::MatrixView<oc::block>((oc::block*)dataShare.data(), rows, numBlk), chl);
             }
+            else {
+                auto a = scratch.get<block>(ScratchMuxRows, rows * numBlk);
+                packRows(dataShare.data(), rows, cols, a.data());
+                co_await mux.apply(partyIdx, memShare, 
+                    oc::MatrixView<oc::block>(a.data(), rows, numBlk), chl);
+                unpackRows(a.data(), rows, cols, dataShare.data());
+            }
+        }
+        catch (...)
+        {
+            xorBytes(dataShare.data(), base.data(), dataShare.size());
+            throw;
         }
     }
 
-    static inline void unpackFromBlocks(
-        const std::vector<oc::block>& in,
-        oc::u64 rows,
-        oc::u64 colsBytes,
-        oc::Matrix<oc::u8>& M)
+    // Advance the aggregates by one shareUpdate: the rows of X that newly
+    // matched Y' (Y and Y' are disjoint, so they were not counted before) and
+    // the rows from firstNewRow on. The former are the merged rows of
+    // commitUpdate, computed here ahead of it.
+    static Proto accumulateUpdate(
+        StandingAggregates& aggregates,
+        ScratchArena& scratch,
+        oc::u64 partyIdx,
+        const oc::BitVector& memShare4PrevIDs,
+        const oc::Matrix<oc::u8>& dataShare4PrevIDs,
+        const oc::BitVector& memShare,
+        const oc::Matrix<oc::u8>& dataShare,
+        oc::u64 firstNewRow,
+        Socket& chl)
     {
-        const oc::u64 numBlk = (colsBytes + 15) / 16;
+        if (aggregates.size() == 0)
+            co_return;
+
+        const u64 cols = dataShare.cols();
+        const u64 prevRows = memShare4PrevIDs.size();
+        auto merged = scratch.get<u8>(ScratchMerged, prevRows * cols);
+        std::memcpy(merged.data(), dataShare4PrevIDs.data(), merged.size());
+        xorBytes(merged.data(), dataShare.data(), merged.size());
+        co_await aggregates.accumulate(partyIdx, memShare4PrevIDs,
+            oc::MatrixView<const oc::u8>(merged.data(), prevRows, cols),
+            false, chl);
+
+        const u64 numNew = memShare.size() - firstNewRow;
+        oc::BitVector newMem;
+        newMem.append((u8*)memShare.data(), numNew, firstNewRow);
+        co_await aggregates.accumulate(partyIdx, newMem,
+            oc::MatrixView<const oc::u8>(dataShare.data() + firstNewRow * cols, numNew, cols),
+            false, chl);
+    }
 
-        for (oc::u64 i = 0; i < rows; ++i)
-        {
-            oc::u8* rowPtr = M.data(i);
-            for (oc::u64 j = 0; j < numBlk; ++j)
-            {
-                alignas(16) oc::u8 buf[16];
-                std::memcpy(buf, &in[i * numBlk + j], 16);
+    // dst[i] ^= src[i] for the rows of src. dst may have more rows.
+    static void xorRowsPrefix(oc::Matrix<oc::u8>& dst, const oc::Matrix<oc::u8>& src)
+    {
+        if (src.rows() > dst.rows() || src.cols() != dst.cols())
+            throw RTE_LOC;
+        xorBytes(dst.data(), src.data(), src.size());
+    }
 
-                const oc::u64 off = j * 16;
-                const oc::u64 len = std::min<oc::u64>(16, colsBytes > off ? (colsBytes - off) : 0);
-                if (len) std::memcpy(rowPtr + off, buf, len);
-            }
+    // Cut share to the rows of X and make room for the rows SSLJ (X', Y \cup
+    // Y') appends, so that the concurrent mux of SSLJ (X, Y') reads the rows
+    // of X in place. newRows: the receiver's |X'|.
+    static void reserveAppend(oc::Matrix<oc::u8>& share, oc::u64 prevRows, oc::u64 newRows)
+    {
+        share.resize(prevRows + SsLeftJoinBase::tableRows(newRows), share.cols(), oc::AllocType::Uninitialized);
+        share.resize(prevRows, share.cols());
+    }
+
+    // Rows [begin, end) of share become PRG(seed), xor data if given: the
+    // shares of P_0's payloads of the new rows. P_1 holds the mask itself.
+    static void maskOwnRows(
+        oc::Matrix<oc::u8>& share,
+        oc::u64 begin,
+        oc::u64 end,
+        oc::block seed,
+        const oc::Matrix<oc::u8>* data)
+    {
+        const u64 cols = share.cols();
+        share.resize(end, cols, oc::AllocType::Uninitialized);
+        if (begin == end)
+            return;
+
+        oc::PRNG prng(seed);
+        prng.get<u8>(share.data(begin), (end - begin) * cols);
+        if (data)
+            xorBytes(share.data(begin), data->data(begin), (end - begin) * cols);
+    }
+
+    // Absent identifiers of a multi-key row stay oc::ZeroBlock, the PRF
+    // would turn them into pseudonyms that all agree.
+    static void keepAbsent(oc::span<const oc::block> input, std::vector<oc::block>& uid)
+    {
+        for (u64 i = 0; i < input.size(); ++i)
+            if (input[i] == oc::ZeroBlock)
+                uid[i] = oc::ZeroBlock;
+    }
+
+    static double secondsSince(std::chrono::steady_clock::time_point t0)
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    }
+
+    static u64 flightsOf(const std::shared_ptr<TranscriptStats>& stats)
+    {
+        return stats ? stats->mFlights : 0;
+    }
+
+    enum class Resume
+    {
+        // run the missing steps of the update (a new one if none is pending)
+        Run,
+        // the peer committed the pending update, commit it as well
+        Commit,
+        // I committed it, the peer catches up
+        Skip
+    };
+
+    // Exchange the update progress of both parties. Only the steps both
+    // finished are kept; a step redone from scratch also redoes those that
+    // consume its output. restart: my pending update is dropped because the
+    // peer has none.
+    //
+    // In WAN mode my set sizes of the update (those of the pending one, if
+    // any) go along, and sizes returns the peer's. fused: those are the
+    // sizes of the update that runs, i.e. neither party restarts; otherwise
+    // the sizes are exchanged again.
+    static Proto syncCheckpoint(
+        UpdateCheckpoint& cp,
+        oc::u64 epoch,
+        bool wan,
+        std::array<u64, 2>& sizes,
+        Resume& resume,
+        bool& restart,
+        bool& fused,
+        Socket& chl)
+    {
+        const u64 words = wan ? 5 : 3;
+        std::vector<u64> mine{ epoch, cp.mActive, cp.mDone, sizes[0], sizes[1] }, theirs(words);
+        mine.resize(words);
+        co_await chl.send(std::move(mine));
+        co_await chl.recv(theirs);
+        if (wan)
+            sizes = { theirs[3], theirs[4] };
+        fused = wan && bool(cp.mActive) == bool(theirs[1]);
+
+        resume = Resume::Run;
+        restart = false;
+        if (theirs[0] == epoch + 1)
+        {
+            // the peer got my ready flag, so every step is done here
+            if (!cp.mActive || cp.mDone != UpdateCheckpoint::AllSteps)
+                throw RTE_LOC;
+            resume = Resume::Commit;
         }
+        else if (epoch == theirs[0] + 1)
+            resume = Resume::Skip;
+        else if (epoch != theirs[0])
+            throw RTE_LOC;
+        else if (cp.mActive && theirs[1])
+        {
+            cp.mDone &= theirs[2];
+            if (!(cp.mDone & UpdateCheckpoint::JoinPrevious))
+                cp.mDone &= ~UpdateCheckpoint::MuxPrevious;
+        }
+        else
+            restart = cp.mActive;
+    }
+
+    // Both parties hold every step once this returns.
+    static Proto exchangeReady(Socket& chl)
+    {
+        u8 ready = 1;
+        co_await chl.send(std::move(ready));
+        co_await chl.recv(ready);
+        if (ready != 1)
+            throw RTE_LOC;
+    }
+
+    // dst[i] ^= src[i] for i < src.size(). dst may be longer.
+    static void xorPrefix(oc::BitVector& dst, const oc::BitVector& src)
+    {
+        if (src.size() > dst.size())
+            throw RTE_LOC;
+
+        const u64 fullBytes = src.size() / 8;
+        xorBytes(dst.data(), src.data(), fullBytes);
+        for (u64 i = fullBytes * 8; i < src.size(); ++i)
+            dst[i] = dst[i] ^ src[i];
     }
 
 
 
-    // P_0 by set X
+    // the table as an inner join: [dataShare | ownDataShare] of the matched rows
+    static Proto compactTable(
+        SecureCompaction& compaction,
+        ScratchArena& scratch,
+        oc::u64 partyIdx,
+        const oc::BitVector& memShare,
+        const oc::Matrix<oc::u8>& dataShare,
+        const oc::Matrix<oc::u8>& ownDataShare,
+        oc::Matrix<oc::u8>& rows,
+        oc::u64& count,
+        Socket& chl)
+    {
+        const u64 n = memShare.size();
+        const u64 cols = dataShare.cols() + ownDataShare.cols();
+        oc::MatrixView<oc::u8> table(scratch.get<u8>(ScratchTable, n * cols).data(), n, cols);
+        for (u64 i = 0; i < n; ++i)
+        {
+            std::memcpy(table.data(i), dataShare.data(i), dataShare.cols());
+            if (ownDataShare.cols())
+                std::memcpy(table.data(i) + dataShare.cols(), ownDataShare.data(i), ownDataShare.cols());
+        }
+
+        co_await compaction.compact(partyIdx, memShare,
+            oc::MatrixView<const oc::u8>(table.data(), n, cols), rows, count, chl);
+    }
+
+    // P_0 by set X, optionally with associated payload p_x
     PseudonymisedDB_P0::PseudonymisedDB_P0(        
         oc::u64 dataByteSize,
         oc::block randomSeed,
         PrfType prfType,
-        oc::u64 oteBatchSize)
+        oc::u64 oteBatchSize,
+        oc::u64 ownDataByteSize,
+        oc::u64 numKeys)
+        : mNumKeys(numKeys)
     {
         mDoublePrf.init(prfType, randomSeed, oteBatchSize);
         mSsljReceiver.init(dataByteSize, randomSeed, oteBatchSize);
         mSsljSender.init(dataByteSize, randomSeed, oteBatchSize);
-
-        myData.resize(0, dataByteSize);
+        mSsljReceiver4Upd.init(dataByteSize, randomSeed ^ oc::AllOneBlock, oteBatchSize);
+        mSsljSender4Upd.init(dataByteSize, randomSeed ^ oc::AllOneBlock, oteBatchSize);
+        mMultiKeyReceiver.init(dataByteSize, numKeys, randomSeed ^ oc::block(4, 0), oteBatchSize);
+        mMux.init(oc::mAesFixedKey.hashBlock(randomSeed));
+        mBitSum.init(oc::mAesFixedKey.hashBlock(randomSeed ^ oc::AllOneBlock));
+        mAggregates.init(oc::mAesFixedKey.hashBlock(randomSeed ^ oc::block(1, 0)));
+        mCompaction.init(oc::mAesFixedKey.hashBlock(randomSeed ^ oc::block(3, 0)), oteBatchSize);
+
+        myData.resize(0, ownDataByteSize);
         dataShare.resize(0, dataByteSize);
+        ownDataShare.resize(0, ownDataByteSize);
+    };
 
-        if (dataByteSize != 16)
-            throw RTE_LOC;
+    Proto PseudonymisedDB_P0::insertID(
+        oc::span<oc::block> input, 
+        Socket& chl)
+    {
+        co_await insertID(input, {}, {}, chl);
+    };
 
-        
+    Proto PseudonymisedDB_P0::insertID(
+        oc::span<oc::block> input, 
+        oc::MatrixView<oc::u8> inputData,
+        Socket& chl)
+    {
+        co_await insertID(input, {}, inputData, chl);
+    };
+
+    Proto PseudonymisedDB_P0::insertID(
+        oc::span<oc::block> input, 
+        oc::span<const oc::block> localPrf,
+        Socket& chl)
+    {
+        co_await insertID(input, localPrf, {}, chl);
     };
 
     Proto PseudonymisedDB_P0::insertID(
         oc::span<oc::block> input, 
-        // oc::MatrixView<oc::u8> inputData,
+        oc::span<const oc::block> localPrf,
+        oc::MatrixView<oc::u8> inputData,
         Socket& chl)
     {
+        if (input.size() % mNumKeys)
+            throw RTE_LOC;
+        if (myData.cols() && (inputData.rows() * mNumKeys != input.size() || inputData.cols() != myData.cols()))
+            throw RTE_LOC;
+
         std::vector<oc::block> updatedUID;
         
-        co_await mDoublePrf.recv(input, updatedUID, chl);
+        co_await mDoublePrf.recv(input, localPrf, updatedUID, chl);
+        if (mNumKeys > 1)
+            keepAbsent(input, updatedUID);
+
+        size_t oldRows = UID.size() / mNumKeys;
 
         UID.reserve(UID.size() + updatedUID.size());
         UID.insert(UID.end(), 
             std::make_move_iterator(updatedUID.begin()),
             std::make_move_iterator(updatedUID.end()));
-        // myData.resize(UID.size(), myData.cols(), oc::AllocType::Uninitialized);
-        // std::memcpy(
-        //     myData.data(myData.rows()), inputData.data(), inputData.size());
+        if (myData.cols())
+        {
+            myData.resize(UID.size() / mNumKeys, myData.cols(), oc::AllocType::Uninitialized);
+            std::memcpy(
+                myData.data(oldRows), inputData.data(), inputData.size());
+        }
+        adviseTables();
     };
 
     void PseudonymisedDB_P0::DinsertID(
-        oc::span<oc::block> input
+        oc::span<oc::block> input,
+        oc::MatrixView<oc::u8> inputData
     )
     {
+        if (input.size() % mNumKeys)
+            throw RTE_LOC;
+        if (myData.cols() && (inputData.rows() * mNumKeys != input.size() || inputData.cols() != myData.cols()))
+            throw RTE_LOC;
+
+        size_t oldRows = UID.size() / mNumKeys;
+
         UID.reserve(UID.size() + input.size());
         UID.insert(UID.end(), 
             std::make_move_iterator(input.begin()),
             std::make_move_iterator(input.end()));
-
+        if (myData.cols())
+        {
+            myData.resize(UID.size() / mNumKeys, myData.cols(), oc::AllocType::Uninitialized);
+            std::memcpy(
+                myData.data(oldRows), inputData.data(), inputData.size());
+        }
+        adviseTables();
     };
 
     Proto PseudonymisedDB_P0::respondOPRF(
@@ -127,108 +383,374 @@ namespace uppid
         co_return;
     };
 
+    Proto PseudonymisedDB_P0::rotateKey(
+        Socket& chl,
+        oc::u64 chunkSize,
+        oc::u64 numThreads)
+    {
+        // the shares of a pending update belong to the UIDs of now
+        if (mNumKeys != 1 || mCheckpoint.mActive)
+            throw RTE_LOC;
+
+        // P_0's UIDs first, then P_1's, into a spare buffer. UID and the key
+        // epochs only change once both parties hold all of theirs.
+        mDoublePrf.rotateKey();
+        std::vector<oc::block> uid(UID.size());
+        co_await mDoublePrf.rekey(UID, uid, chunkSize, numThreads, chl);
+        co_await mDoublePrf.respondRekey(chl);
+        co_await exchangeReady(chl);
+        mDoublePrf.commitKey();
+        std::swap(UID, uid);
+        adviseTables();
+    };
+
+    Proto PseudonymisedDB_P0::compactKeys(oc::span<oc::block> input, Socket& chl)
+    {
+        if (mNumKeys != 1 || mCheckpoint.mActive || input.size() != UID.size())
+            throw RTE_LOC;
+
+        // P_0's UIDs first, then P_1's. See rotateKey.
+        mDoublePrf.retireKeys();
+        std::vector<oc::block> uid;
+        co_await mDoublePrf.recv(input, uid, chl);
+        co_await mDoublePrf.send(chl);
+        co_await exchangeReady(chl);
+        mDoublePrf.commitKey();
+        std::swap(UID, uid);
+        adviseTables();
+    };
+
+    Proto PseudonymisedDB_P0::joinPrevious_P0(
+        oc::span<oc::block> previousIDs,
+        oc::MatrixView<const oc::u8> prevShares,
+        oc::BitVector& memShare4PrevIDs,
+        oc::Matrix<oc::u8>& dataShare4PrevIDs,
+        oc::u8& done,
+        std::optional<double>& ssljSeconds,
+        std::optional<double>& muxSeconds,
+        Socket& chl)
+    {
+        if (previousIDs.size() == 0) // if previous set is empty, skip
+        {
+            done |= UpdateCheckpoint::JoinPrevious | UpdateCheckpoint::MuxPrevious;
+            co_return;
+        }
+
+        if (!(done & UpdateCheckpoint::JoinPrevious))
+        {
+            // the join appends, so start from empty buffers (capacity is kept)
+            auto t0 = std::chrono::steady_clock::now();
+            memShare4PrevIDs.resize(0);
+            dataShare4PrevIDs.resize(0, dataShare.cols());
+            if (mWan)
+                mSsljReceiver.setPeerSize(mCheckpoint.mYSize - mCheckpoint.mPrevYSize);
+            co_await mSsljReceiver.recv(
+                previousIDs, memShare4PrevIDs, dataShare4PrevIDs, chl);         // SSLJ (X, Y'), provide X
+            done |= UpdateCheckpoint::JoinPrevious;
+            ssljSeconds = secondsSince(t0);
+        }
+
+        // naive secret share of CPSI are not zero-sharing, and neither are
+        // the rows of X that matched nothing so far. The secure mux turns
+        // them into shares of m' * (payload ^ row of X), see commitUpdate.
+        // It writes the rows after its last message, so an interrupted mux
+        // leaves the join output as it was.
+        if (!(done & UpdateCheckpoint::MuxPrevious))
+        {
+            auto t0 = std::chrono::steady_clock::now();
+            co_await muxRows(mMux, mScratch, 0, memShare4PrevIDs, dataShare4PrevIDs, prevShares, chl);
+            done |= UpdateCheckpoint::MuxPrevious;
+            muxSeconds = secondsSince(t0);
+        }
+    }
+
     Proto PseudonymisedDB_P0::shareUpdate_P0(Socket& chl)
     {
         
         // SSLJ Receiver is P_0 (permutation)
+        auto& cp = mCheckpoint;
+
+        // |X|, |X'|, replaced by |Y|, |Y'| in WAN mode
+        std::array<u64, 2> sizes = cp.mActive ?
+            std::array<u64, 2>{ cp.mPrevRows, cp.mNewRows } :
+            std::array<u64, 2>{ memShare.size(), UID.size() / mNumKeys - memShare.size() };
+
+        const u64 flights = flightsOf(mTranscriptStats);
+        Resume resume;
+        bool restart, fused;
+        co_await syncCheckpoint(cp, mUpdateEpoch, mWan, sizes, resume, restart, fused, chl);
+        if (resume == Resume::Skip)
+            co_return;
+        if (resume == Resume::Commit)
+        {
+            commitUpdate();
+            co_return;
+        }
+        if (restart)
+            rollbackUpdate();
 
-        PRNG prng;
-        prng.SetSeed(oc::OneBlock);
+        const auto start = std::chrono::steady_clock::now();
+        bool created = !cp.mActive;
+        if (created)
+        {
+            cp.mActive = true;
+            cp.mDone = 0;
+            cp.mPrevRows = memShare.size();
+            cp.mNewRows = UID.size() / mNumKeys - cp.mPrevRows;
+            cp.mAggregateShares = mAggregates.shares();
+            mMemShare4PrevIDs.resize(0);
+            mDataShare4PrevIDs.resize(0, dataShare.cols());
+        }
 
-        auto currentSize = memShare.size();
-        auto updatedSize = UID.size() - currentSize;
+        auto currentSize = cp.mPrevRows;
+        auto updatedSize = cp.mNewRows;
         
         oc::span<oc::block> previousIDs(UID.data(), currentSize);               // X
         oc::span<oc::block> updatedIDs(UID.data() + currentSize, updatedSize);  // X'
+        oc::span<oc::block> allIDs(UID.data(), currentSize + updatedSize);      // X \cup X'
 
-        co_await chl.send(previousIDs.size());
-        co_await chl.send(updatedIDs.size());
+        // |Y|, |Y'|, then the way of updating, chosen by P_0
+        std::array<u64, 2> ySizes = sizes;
+        if (!fused)
+        {
+            co_await chl.send(previousIDs.size());
+            co_await chl.send(updatedIDs.size());
+            co_await chl.recv(ySizes);
+        }
+        if (created)
+        {
+            cp.mPrevYSize = ySizes[0];
+            cp.mYSize = ySizes[0] + ySizes[1];
+
+            auto& m = mLastUpdate;
+            m = {};
+            m.mPrevRows = currentSize;
+            m.mNewRows = updatedSize;
+            m.mPrevYSize = ySizes[0];
+            m.mNewYSize = ySizes[1];
+            m.mKernelIsa = kernelIsa();
+            m.mIncrementalCost = mCostModel.incremental(currentSize, updatedSize, ySizes[0], ySizes[1]);
+            m.mRebuildCost = mCostModel.rebuild(currentSize, updatedSize, ySizes[0], ySizes[1]);
+            // multi-key rows of Y may both match a row of X, which the
+            // incremental merge cannot express
+            cp.mRebuild = 
+                mNumKeys > 1 ||
+                mUpdatePolicy == UpdatePolicy::Rebuild ||
+                (mUpdatePolicy == UpdatePolicy::Auto && currentSize && m.mRebuildCost < m.mIncrementalCost);
+            m.mRebuild = cp.mRebuild;
+        }
+        else if (cp.mPrevYSize != ySizes[0] || cp.mYSize != ySizes[0] + ySizes[1])
+            throw RTE_LOC;
+        co_await chl.send(u8(cp.mRebuild));
+
+        // my payloads of X' are in the right rows already, only mask them
+        if (ownDataShare.cols())
+        {
+            if (myData.rows() < currentSize + updatedSize)
+                throw RTE_LOC;
+            co_await chl.recv(cp.mOwnDataSeed);
+            maskOwnRows(ownDataShare, currentSize, currentSize + updatedSize, cp.mOwnDataSeed, &myData);
+        }
 
-        oc::BitVector memShare4PrevIDs;
-        oc::Matrix<oc::u8> dataShare4PrevIDs;
+        auto& memShare4PrevIDs = mMemShare4PrevIDs;
+        auto& dataShare4PrevIDs = mDataShare4PrevIDs;
 
-        if (currentSize != 0){ // if previous set is empty, skip
-            co_await mSsljReceiver.recv(
-                previousIDs, memShare4PrevIDs, dataShare4PrevIDs, chl);             // SSLJ (X, Y'), provide X
+        // SSLJ (X, Y') followed by the OT mux and SSLJ (X', Y \cup Y') do not
+        // depend on each other. Run them concurrently, each on its own channel.
+        auto prevChl = chl.fork();
+        auto updChl = chl.fork();
 
-            // Below computation (simple XOR) is correct only when Y ∩ Y' is empty.
-            // To support Y ∩ Y' nonempty case, 
-            // need to compute memShare OR memShare4PrevIDs.
-            memShare ^= memShare4PrevIDs;                                            // T xor T^new
-
-            // naive secret share of CPSI are not zero-sharing
-            // The following code constructs a simple OT-based GMW protocol to make that the share is zero.
-            const u64 rows = memShare4PrevIDs.size();
-            const u64 cols = 16;
-            const u64 numBlk = (cols + 15) / 16;
-            const u64 otCount = rows * numBlk;
-
-            std::vector<block> a0;
-            // matrix(u8) convert to block, we assume that item length is 128bit
-            packToBlocks(dataShare4PrevIDs, rows, cols, a0);
-
-            // ---------- OT#1: P1(sender) -> P0(receiver), choice = m0
-            oc::BitVector choice_m0(otCount);
-            for (u64 i = 0; i < rows; ++i) {
-                const bool m0 = memShare4PrevIDs[i];
-                for (u64 j = 0; j < numBlk; ++j) {
-                    choice_m0[i * numBlk + j] = m0;
+        if (cp.mRebuild)
+        {
+            // SSLJ (X \cup X', Y \cup Y') into the spare buffers, swapped in on commit
+            if (!(cp.mDone & UpdateCheckpoint::JoinPrevious))
+            {
+                auto t0 = std::chrono::steady_clock::now();
+                memShare4PrevIDs.resize(0);
+                dataShare4PrevIDs.resize(0, dataShare.cols());
+                if (mNumKeys > 1)
+                {
+                    co_await mMultiKeyReceiver.recv(
+                        oc::MatrixView<const oc::block>(UID.data(), currentSize + updatedSize, mNumKeys),
+                        memShare4PrevIDs, dataShare4PrevIDs, prevChl);
                 }
+                else
+                {
+                    if (mWan)
+                        mSsljReceiver.setPeerSize(cp.mYSize);
+                    co_await mSsljReceiver.recv(
+                        allIDs, memShare4PrevIDs, dataShare4PrevIDs, prevChl);
+                    mCostModel.observeSslj(cp.mYSize, allIDs.size(), secondsSince(t0));
+                }
+            }
+            cp.mDone |= UpdateCheckpoint::JoinPrevious | UpdateCheckpoint::MuxPrevious | UpdateCheckpoint::JoinUpdated;
+        }
+        else
+        {
+            // Each branch records its steps in its own flags, merged into
+            // the checkpoint once both returned, also if one of them failed.
+            u8 prevDone = cp.mDone, updDone = 0;
+            std::optional<double> prevSeconds, muxSeconds, updSeconds;
+
+            // T || T^add: SSLJ (X', Y \cup Y') appends its rows to memShare / dataShare in place.
+            auto joinUpdated = [&]() -> Proto {
+                if (cp.mDone & UpdateCheckpoint::JoinUpdated)
+                    co_return;
+                auto t0 = std::chrono::steady_clock::now();
+                memShare.resize(currentSize);                                   // drop a partial append
+                dataShare.resize(currentSize, dataShare.cols());
+                if (mWan)
+                    mSsljReceiver4Upd.setPeerSize(cp.mYSize);
+                co_await mSsljReceiver4Upd.recv(
+                    updatedIDs, memShare, dataShare, updChl);                   // SSLJ (X', Y \cup Y'), provide X'
+                updDone = UpdateCheckpoint::JoinUpdated;
+                updSeconds = secondsSince(t0);
+            };
+
+            // the rows of X stay where they are until commitUpdate
+            if (!(cp.mDone & UpdateCheckpoint::JoinUpdated))
+                reserveAppend(dataShare, currentSize, updatedSize);
+            const u8* prevRows = dataShare.data();
+
+            auto r = co_await macoro::when_all_ready(
+                joinPrevious_P0(
+                    previousIDs, oc::MatrixView<const oc::u8>(prevRows, currentSize, dataShare.cols()),
+                    memShare4PrevIDs, dataShare4PrevIDs, prevDone,
+                    prevSeconds, muxSeconds, prevChl),                          // SSLJ (X, Y'), provide X
+                joinUpdated());
+            cp.mDone |= prevDone | updDone;
+
+            // the steps that ran to the end refit the cost model
+            if (prevSeconds)
+                mCostModel.observeSslj(cp.mYSize - cp.mPrevYSize, currentSize, *prevSeconds);
+            if (muxSeconds)
+                mCostModel.observeMux(currentSize, *muxSeconds);
+            if (updSeconds)
+                mCostModel.observeSslj(cp.mYSize, updatedSize, *updSeconds);
+            std::get<0>(r).result();
+            std::get<1>(r).result();
+
+            if (dataShare.data() != prevRows)
+                throw RTE_LOC;
+        }
+
+        if (!(cp.mDone & UpdateCheckpoint::Aggregates))
+        {
+            if (cp.mRebuild)
+            {
+                // a rebuild recounts everything
+                mAggregates.setShares(std::vector<u64>(mAggregates.size()));
+                co_await mAggregates.accumulate(0, memShare4PrevIDs,
+                    oc::MatrixView<const oc::u8>(dataShare4PrevIDs.data(), dataShare4PrevIDs.rows(), dataShare4PrevIDs.cols()),
+                    false, chl);
+            }
+            else
+            {
+                mAggregates.setShares(cp.mAggregateShares);
+                co_await accumulateUpdate(mAggregates, mScratch, 0, 
+                    memShare4PrevIDs, dataShare4PrevIDs, memShare, dataShare, currentSize, chl);
             }
+            cp.mDone |= UpdateCheckpoint::Aggregates;
+        }
 
-            std::vector<block> t01(otCount); // receive M_{m0}
-            oc::SilentOtExtReceiver ot1Receiver;
-            ot1Receiver.configure(otCount);
-            co_await ot1Receiver.receiveChosen(choice_m0, t01, prng, chl);
+        co_await exchangeReady(chl);
+        commitUpdate();
+        mLastUpdate.mSeconds += secondsSince(start);
+        mLastUpdate.mFlights += flightsOf(mTranscriptStats) - flights;
+    }
 
-            // ---------- OT#2: P0(sender) -> P1(receiver), messages: N0=r10, N1=r10 ^ a0
-            std::vector<block> r10(otCount);
-            prng.get(r10.data(), otCount);
+    void PseudonymisedDB_P0::commitUpdate()
+    {
+        auto& cp = mCheckpoint;
+        if (cp.mRebuild) {
+            std::swap(memShare, mMemShare4PrevIDs);
+            std::swap(dataShare, mDataShare4PrevIDs);
+        }
+        else if (cp.mPrevRows != 0) {
+            // Below computation (simple XOR) is correct only when Y ∩ Y' is empty.
+            // To support Y ∩ Y' nonempty case, 
+            // need to compute memShare OR memShare4PrevIDs.
+            xorPrefix(memShare, mMemShare4PrevIDs);                              // T xor T^new
+            xorRowsPrefix(dataShare, mDataShare4PrevIDs);                        // p' where m' = 1
+        }
+        cp.mActive = false;
+        ++mUpdateEpoch;
+        if (cp.mRebuild || cp.mPrevRows != 0)
+            mRewriteEpoch = mUpdateEpoch;
+        adviseTables();
+    }
 
-            std::vector<std::array<block,2>> ot2Msgs(otCount);
-            for (u64 k = 0; k < otCount; ++k) {
-                ot2Msgs[k][0] = r10[k];
-                ot2Msgs[k][1] = r10[k] ^ a0[k];
-            }
+    void PseudonymisedDB_P0::rollbackUpdate()
+    {
+        auto& cp = mCheckpoint;
+        memShare.resize(cp.mPrevRows);
+        dataShare.resize(cp.mPrevRows, dataShare.cols());
+        ownDataShare.resize(cp.mPrevRows, ownDataShare.cols());
+        mAggregates.setShares(cp.mAggregateShares);
+        cp.mActive = false;
+    }
 
-            oc::SilentOtExtSender ot2Sender;
-            ot2Sender.configure(otCount);
-            co_await ot2Sender.sendChosen(ot2Msgs, prng, chl);
+    void PseudonymisedDB_P0::appendUnmatched(oc::u64 rows)
+    {
+        auto prev = memShare.size();
+        if (mCheckpoint.mActive || UID.size() / mNumKeys != prev + rows)
+            throw RTE_LOC;
 
-            // ---------- local term: l0 = m0 ? a0 : 0
-            for (u64 i = 0; i < rows; ++i) {
-                if (!memShare4PrevIDs[i]) {
-                    for (u64 j = 0; j < numBlk; ++j) {
-                        a0[i * numBlk + j] = oc::ZeroBlock;
-                    }
-                }
-            }
+        // unmatched rows leave the aggregates as they are
+        memShare.resize(prev + rows);
+        for (u64 i = prev; i < prev + rows; ++i)
+            memShare[i] = 0;
+        dataShare.resize(prev + rows, dataShare.cols());
+        if (ownDataShare.cols())
+        {
+            if (myData.rows() < prev + rows)
+                throw RTE_LOC;
+            ownDataShare.resize(prev + rows, ownDataShare.cols(), oc::AllocType::Uninitialized);
+            if (rows)
+                std::memcpy(ownDataShare.data(prev), myData.data(prev), rows * ownDataShare.cols());
+        }
+        ++mUpdateEpoch;
+        adviseTables();
+    }
 
-            // ---------- P0 final masked share:
-            // q0 = l0 ^ t01 ^ r10
-            for (u64 k = 0; k < otCount; ++k) {
-                a0[k] = a0[k] ^ t01[k] ^ r10[k];
-            }
+    Proto PseudonymisedDB_P0::membershipShares_P0(oc::BitVector& memShares, Socket& chl)
+    {
+        if (mNumKeys != 1)
+            throw RTE_LOC;
+        memShares.resize(0);
+        co_await mSsljReceiver.recvMembership(UID, memShares, true, chl);
+    }
 
-            // block -> matrix(u8)
-            unpackFromBlocks(a0, rows, cols, dataShare4PrevIDs);
+    Proto PseudonymisedDB_P0::countMatches_P0(oc::u64& countShare, Socket& chl)
+    {
+        if (mNumKeys != 1)
+            throw RTE_LOC;
 
+        // one flag per CPSI bin, |X cap Y| of them are set
+        oc::BitVector flags;
+        co_await mSsljReceiver.recvMembership(UID, flags, false, chl);
+        co_await mBitSum.count(0, flags, countShare, chl);
+    }
 
-        }
-        
-        oc::BitVector memShare4Upd;
-        oc::Matrix<oc::u8> dataShare4Upd;
-        co_await mSsljReceiver.recv(
-            updatedIDs, memShare4Upd, dataShare4Upd, chl);                        // SSLJ (X', Y \cup Y'), provide X'
-
-        // T || T^add
-        memShare.append(memShare4Upd);                                            
-        dataShare.resize(UID.size(), dataShare.cols(), AllocType::Uninitialized);
-        std::memcpy(
-            dataShare.data(currentSize), dataShare4Upd.data(), dataShare4Upd.size());
-        
+    Proto PseudonymisedDB_P0::innerJoin_P0(oc::Matrix<oc::u8>& rows, oc::u64& count, Socket& chl)
+    {
+        // the pending rows are not part of the table yet
+        if (mCheckpoint.mActive)
+            throw RTE_LOC;
+        co_await compactTable(mCompaction, mScratch, 0, memShare, dataShare, ownDataShare, rows, count, chl);
     }
 
+    Proto PseudonymisedDB_P0::registerAggregate_P0(
+        const AggregateSpec& spec, oc::u64& id, Socket& chl)
+    {
+        // the pending rows are folded in by the update itself
+        if (mCheckpoint.mActive)
+            throw RTE_LOC;
+        id = mAggregates.add(spec, dataShare.cols());
+        co_await mAggregates.accumulate(0, memShare,
+            oc::MatrixView<const oc::u8>(dataShare.data(), dataShare.rows(), dataShare.cols()),
+            false, chl, { id });
+    }
 
 
 
@@ -237,27 +759,50 @@ namespace uppid
         oc::u64 dataByteSize,
         oc::block randomSeed,
         PrfType prfType,
-        oc::u64 oteBatchSize)
+        oc::u64 oteBatchSize,
+        oc::u64 ownDataByteSize,
+        oc::u64 numKeys)
+        : mNumKeys(numKeys)
     {
         mDoublePrf.init(prfType, randomSeed, oteBatchSize);
         mSsljReceiver.init(dataByteSize, randomSeed, oteBatchSize);
         mSsljSender.init(dataByteSize, randomSeed, oteBatchSize);
+        mSsljReceiver4Upd.init(dataByteSize, randomSeed ^ oc::AllOneBlock, oteBatchSize);
+        mSsljSender4Upd.init(dataByteSize, randomSeed ^ oc::AllOneBlock, oteBatchSize);
+        mMultiKeySender.init(dataByteSize, numKeys, randomSeed ^ oc::block(4, 0), oteBatchSize);
+        mMux.init(oc::mAesFixedKey.hashBlock(randomSeed));
+        mBitSum.init(oc::mAesFixedKey.hashBlock(randomSeed ^ oc::AllOneBlock));
+        mAggregates.init(oc::mAesFixedKey.hashBlock(randomSeed ^ oc::block(1, 0)));
+        mCompaction.init(oc::mAesFixedKey.hashBlock(randomSeed ^ oc::block(3, 0)), oteBatchSize);
+        mPrng.SetSeed(oc::mAesFixedKey.hashBlock(randomSeed ^ oc::block(2, 0)));
         myData.resize(0, dataByteSize);
         dataShare.resize(0, dataByteSize);
+        ownDataShare.resize(0, ownDataByteSize);
 
         YSize = 0;
+    };
 
-        if (dataByteSize != 16)
-            throw RTE_LOC;
+    Proto PseudonymisedDB_P1::insertID(
+        oc::span<oc::block> input, 
+        oc::MatrixView<oc::u8> inputData,
+        Socket& chl)
+    {
+        co_await insertID(input, {}, inputData, chl);
     };
 
     Proto PseudonymisedDB_P1::insertID(
         oc::span<oc::block> input, 
+        oc::span<const oc::block> localPrf,
         oc::MatrixView<oc::u8> inputData,
         Socket& chl)
     {
+        if (input.size() % mNumKeys)
+            throw RTE_LOC;
+
         std::vector<oc::block> updatedUID;
-        co_await mDoublePrf.recv(input, updatedUID, chl);
+        co_await mDoublePrf.recv(input, localPrf, updatedUID, chl);
+        if (mNumKeys > 1)
+            keepAbsent(input, updatedUID);
 
         size_t oldRows = myData.rows();
 
@@ -265,9 +810,10 @@ namespace uppid
         UID.insert(UID.end(), 
             std::make_move_iterator(updatedUID.begin()),
             std::make_move_iterator(updatedUID.end()));
-        myData.resize(UID.size(), myData.cols(), oc::AllocType::Uninitialized);
+        myData.resize(UID.size() / mNumKeys, myData.cols(), oc::AllocType::Uninitialized);
         std::memcpy(
             myData.data(oldRows), inputData.data(), inputData.size());
+        adviseTables();
     };
 
     void PseudonymisedDB_P1::DinsertID(
@@ -275,16 +821,19 @@ namespace uppid
         oc::MatrixView<oc::u8> inputData
     )
     {
+        if (input.size() % mNumKeys)
+            throw RTE_LOC;
+
         UID.reserve(UID.size() + input.size());
         UID.insert(UID.end(), 
             std::make_move_iterator(input.begin()),
             std::make_move_iterator(input.end()));
         
         size_t oldRows = myData.rows();
-        myData.resize(UID.size(), myData.cols(), oc::AllocType::Uninitialized);
+        myData.resize(UID.size() / mNumKeys, myData.cols(), oc::AllocType::Uninitialized);
         std::memcpy(
             myData.data(oldRows), inputData.data(), inputData.size());
-
+        adviseTables();
     };
 
     Proto PseudonymisedDB_P1::respondOPRF(
@@ -294,28 +843,163 @@ namespace uppid
         co_return;
     };
 
+    Proto PseudonymisedDB_P1::rotateKey(
+        Socket& chl,
+        oc::u64 chunkSize,
+        oc::u64 numThreads)
+    {
+        if (mNumKeys != 1 || mCheckpoint.mActive)
+            throw RTE_LOC;
+
+        // See PseudonymisedDB_P0::rotateKey.
+        mDoublePrf.rotateKey();
+        std::vector<oc::block> uid(UID.size());
+        co_await mDoublePrf.respondRekey(chl);
+        co_await mDoublePrf.rekey(UID, uid, chunkSize, numThreads, chl);
+        co_await exchangeReady(chl);
+        mDoublePrf.commitKey();
+        std::swap(UID, uid);
+        adviseTables();
+    };
+
+    Proto PseudonymisedDB_P1::compactKeys(oc::span<oc::block> input, Socket& chl)
+    {
+        if (mNumKeys != 1 || mCheckpoint.mActive || input.size() != UID.size())
+            throw RTE_LOC;
+
+        mDoublePrf.retireKeys();
+        co_await mDoublePrf.send(chl);
+        std::vector<oc::block> uid;
+        co_await mDoublePrf.recv(input, uid, chl);
+        co_await exchangeReady(chl);
+        mDoublePrf.commitKey();
+        std::swap(UID, uid);
+        adviseTables();
+    };
+
+    Proto PseudonymisedDB_P1::joinPrevious_P1(
+        oc::span<oc::block> updatedIDs,
+        oc::MatrixView<oc::u8> updatedPayloads,
+        oc::MatrixView<const oc::u8> prevShares,
+        oc::BitVector& memShare4PrevIDs,
+        oc::Matrix<oc::u8>& dataShare4PrevIDs,
+        oc::u8& done,
+        Socket& chl)
+    {
+        if (!(done & UpdateCheckpoint::JoinPrevious))
+        {
+            // the join appends, so start from empty buffers (capacity is kept)
+            memShare4PrevIDs.resize(0);
+            dataShare4PrevIDs.resize(0, dataShare.cols());
+            if (mWan)
+                mSsljSender.setPeerSize(mCheckpoint.mPrevRows);
+            co_await mSsljSender.send(                                          // SSLJ (X, Y'), provide Y' with payload
+                updatedIDs, updatedPayloads, memShare4PrevIDs, dataShare4PrevIDs, chl);
+            done |= UpdateCheckpoint::JoinPrevious;
+        }
+
+        // See joinPrevious_P0.
+        if (!(done & UpdateCheckpoint::MuxPrevious))
+        {
+            co_await muxRows(mMux, mScratch, 1, memShare4PrevIDs, dataShare4PrevIDs, prevShares, chl);
+            done |= UpdateCheckpoint::MuxPrevious;
+        }
+    }
+
     Proto PseudonymisedDB_P1::shareUpdate_P1(Socket& chl)
     {
 
         // SSLJ Sender is P_1 (Y, payload)
         oc::Timer timer;
-        PRNG prng;
-        prng.SetSeed(oc::ZeroBlock);
+        auto& cp = mCheckpoint;
+
+        // |Y|, |Y'|, replaced by |X|, |X'| in WAN mode
+        std::array<u64, 2> sizes = cp.mActive ?
+            std::array<u64, 2>{ cp.mPrevYSize, cp.mYSize - cp.mPrevYSize } :
+            std::array<u64, 2>{ YSize, UID.size() / mNumKeys - YSize };
+
+        const u64 flights = flightsOf(mTranscriptStats);
+        Resume resume;
+        bool restart, fused;
+        co_await syncCheckpoint(cp, mUpdateEpoch, mWan, sizes, resume, restart, fused, chl);
+        if (resume == Resume::Skip)
+            co_return;
+        if (resume == Resume::Commit)
+        {
+            commitUpdate();
+            co_return;
+        }
+        if (restart)
+            rollbackUpdate();
 
-        u64 XSize;
-        u64 X_Size; // X' size
+        u64 XSize = sizes[0];
+        u64 X_Size = sizes[1]; // X' size
         
-        co_await chl.recv(XSize); // pervious X size
-        co_await chl.recv(X_Size); // new X' size
+        if (!fused)
+        {
+            co_await chl.recv(XSize); // pervious X size
+            co_await chl.recv(X_Size); // new X' size
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        bool created = !cp.mActive;
+        if (created)
+        {
+            cp.mActive = true;
+            cp.mDone = 0;
+            cp.mPrevRows = XSize;
+            cp.mNewRows = X_Size;
+            cp.mPrevYSize = YSize;
+            cp.mYSize = UID.size() / mNumKeys;
+            cp.mAggregateShares = mAggregates.shares();
+            mMemShare4PrevIDs.resize(0);
+            mDataShare4PrevIDs.resize(0, dataShare.cols());
+        }
+        else if (cp.mPrevRows != XSize || cp.mNewRows != X_Size)
+            throw RTE_LOC;
+
+        // my share of P_0's payloads of X' is the mask
+        if (ownDataShare.cols() && created)
+            cp.mOwnDataSeed = mPrng.get<oc::block>();
+        auto sendSeed = [&]() -> Proto {
+            if (ownDataShare.cols())
+                co_await chl.send(cp.mOwnDataSeed);
+        };
+
+        // P_0 picks incremental update or rebuild. The seed does not depend
+        // on it, so with the sizes already sent it goes in the same flight.
+        if (fused)
+            co_await sendSeed();
+        else
+            co_await chl.send(std::array<u64, 2>{ cp.mPrevYSize, cp.mYSize - cp.mPrevYSize });
+        u8 rebuild;
+        co_await chl.recv(rebuild);
+        if ((!created && cp.mRebuild != bool(rebuild)) || (mNumKeys > 1 && !rebuild))
+            throw RTE_LOC;
+        cp.mRebuild = rebuild;
+        if (!fused)
+            co_await sendSeed();
+        if (ownDataShare.cols())
+            maskOwnRows(ownDataShare, XSize, XSize + X_Size, cp.mOwnDataSeed, nullptr);
+
+        if (created)
+        {
+            auto& m = mLastUpdate;
+            m = {};
+            m.mPrevRows = XSize;
+            m.mNewRows = X_Size;
+            m.mPrevYSize = cp.mPrevYSize;
+            m.mNewYSize = cp.mYSize - cp.mPrevYSize;
+            m.mRebuild = cp.mRebuild;
+            m.mKernelIsa = kernelIsa();
+        }
 
         // auto currentSize = memShare.size();
-        auto currentSize = YSize;
-        auto updatedSize = UID.size() - currentSize;
-        
-        YSize = UID.size();
+        auto currentSize = cp.mPrevYSize;
+        auto updatedSize = cp.mYSize - currentSize;
 
         oc::span<oc::block> updatedIDs(UID.data() + currentSize, updatedSize);  // Y'
-        oc::span<oc::block> AllIDs(UID.data(), UID.size());                     // Y \cup Y'
+        oc::span<oc::block> AllIDs(UID.data(), cp.mYSize);                      // Y \cup Y'
 
         u64 cols = myData.cols();
         oc::MatrixView<oc::u8> updatedPayloads(                                 // Y'           payload
@@ -326,107 +1010,300 @@ namespace uppid
         
         oc::MatrixView<oc::u8> AllPayloads(                                     // Y \cup Y'    payload
             myData.data(),      
-            UID.size(),         
+            cp.mYSize,         
             cols
         );
 
-        oc::BitVector memShare4PrevIDs;
-        oc::Matrix<oc::u8> dataShare4PrevIDs;
-        
+        auto& memShare4PrevIDs = mMemShare4PrevIDs;
+        auto& dataShare4PrevIDs = mDataShare4PrevIDs;
+
+        // Forked in the same order as P_0: the first channel carries SSLJ (X, Y')
+        // and the OT mux, the second one SSLJ (X', Y \cup Y').
+        auto prevChl = chl.fork();
+        auto updChl = chl.fork();
+
         timer.setTimePoint("start");
-        if (currentSize != 0) // if previous set is empty, skip
+        if (cp.mRebuild)
         {
-            co_await mSsljSender.send(                                              // SSLJ (X, Y'), provide Y' with payload
-                updatedIDs, updatedPayloads, memShare4PrevIDs, dataShare4PrevIDs, chl);
+            // SSLJ (X \cup X', Y \cup Y') into the spare buffers, swapped in on commit
+            if (!(cp.mDone & UpdateCheckpoint::JoinPrevious))
+            {
+                memShare4PrevIDs.resize(0);
+                dataShare4PrevIDs.resize(0, dataShare.cols());
+                if (mNumKeys > 1)
+                {
+                    co_await mMultiKeySender.send(
+                        oc::MatrixView<const oc::block>(UID.data(), cp.mYSize, mNumKeys),
+                        AllPayloads, memShare4PrevIDs, dataShare4PrevIDs, prevChl);
+                }
+                else
+                {
+                    if (mWan)
+                        mSsljSender.setPeerSize(XSize + X_Size);
+                    co_await mSsljSender.send(
+                        AllIDs, AllPayloads, memShare4PrevIDs, dataShare4PrevIDs, prevChl);
+                }
+            }
+            cp.mDone |= UpdateCheckpoint::JoinPrevious | UpdateCheckpoint::MuxPrevious | UpdateCheckpoint::JoinUpdated;
+            timer.setTimePoint("SSLJ(X ∪ X', Y ∪ Y') end");
 
+            if (dataShare4PrevIDs.rows() != XSize + X_Size)
+                throw RTE_LOC;
+        }
+        else
+        {
+            // See shareUpdate_P0.
+            u8 prevDone = cp.mDone, updDone = 0;
+
+            if (!(cp.mDone & UpdateCheckpoint::JoinUpdated))
+                reserveAppend(dataShare, XSize, X_Size);
+            const u8* prevRows = dataShare.data();
+
+            auto joinPrevious = [&]() -> Proto {
+                if (XSize != 0) // if previous set is empty, skip
+                    co_await joinPrevious_P1(
+                        updatedIDs, updatedPayloads,
+                        oc::MatrixView<const oc::u8>(prevRows, XSize, dataShare.cols()),
+                        memShare4PrevIDs, dataShare4PrevIDs, prevDone, prevChl);
+                else
+                    prevDone |= UpdateCheckpoint::JoinPrevious | UpdateCheckpoint::MuxPrevious;
+            };
+
+            auto joinUpdated = [&]() -> Proto {
+                if (cp.mDone & UpdateCheckpoint::JoinUpdated)
+                    co_return;
+                // T || T^add: appended to memShare / dataShare in place
+                memShare.resize(XSize);                                         // drop a partial append
+                dataShare.resize(XSize, dataShare.cols());
+                if (mWan)
+                    mSsljSender4Upd.setPeerSize(X_Size);
+                co_await mSsljSender4Upd.send(
+                    AllIDs, AllPayloads, memShare, dataShare, updChl);          // SSLJ(X', Y \cup Y'), provide Y \cup Y' with payload
+                updDone = UpdateCheckpoint::JoinUpdated;
+            };
+
+            auto r = co_await macoro::when_all_ready(joinPrevious(), joinUpdated());
+            cp.mDone |= prevDone | updDone;
+            timer.setTimePoint("SSLJ(X, Y') || SSLJ(X', Y ∪ Y') end");
+            std::get<0>(r).result();
+            std::get<1>(r).result();
+
+            if (dataShare.rows() != XSize + X_Size || dataShare.data() != prevRows)
+                throw RTE_LOC;
+        }
+
+        if (!(cp.mDone & UpdateCheckpoint::Aggregates))
+        {
+            if (cp.mRebuild)
+            {
+                // a rebuild recounts everything
+                mAggregates.setShares(std::vector<u64>(mAggregates.size()));
+                co_await mAggregates.accumulate(1, memShare4PrevIDs,
+                    oc::MatrixView<const oc::u8>(dataShare4PrevIDs.data(), dataShare4PrevIDs.rows(), dataShare4PrevIDs.cols()),
+                    false, chl);
+            }
+            else
+            {
+                mAggregates.setShares(cp.mAggregateShares);
+                co_await accumulateUpdate(mAggregates, mScratch, 1, 
+                    memShare4PrevIDs, dataShare4PrevIDs, memShare, dataShare, XSize, chl);
+            }
+            cp.mDone |= UpdateCheckpoint::Aggregates;
+        }
+
+        co_await exchangeReady(chl);
+        commitUpdate();
+        mLastUpdate.mSeconds += secondsSince(start);
+        mLastUpdate.mFlights += flightsOf(mTranscriptStats) - flights;
+        // std::cout << timer << "\n";
+    }
+
+    void PseudonymisedDB_P1::commitUpdate()
+    {
+        auto& cp = mCheckpoint;
+        if (cp.mRebuild) {
+            std::swap(memShare, mMemShare4PrevIDs);
+            std::swap(dataShare, mDataShare4PrevIDs);
+        }
+        else if (cp.mPrevRows != 0) {
             // Below computation (simple XOR) is correct only when Y ∩ Y' is empty.
             // To support Y ∩ Y' nonempty case, 
             // need to compute memShare OR memShare4PrevIDs.
-            memShare ^= memShare4PrevIDs;                                           // T xor T^new
-
-            // naive secret share of CPSI are not zero-sharing
-            // The following code constructs a simple OT-based GMW protocol to make that the share is zero.
-            const u64 rows = memShare4PrevIDs.size();          
-            const u64 cols = 16;                    // payload bytes (== dataByteSize)
-            const u64 numBlk = (cols + 15) / 16;
-            const u64 otCount = rows * numBlk;
-
-            // matrix(u8) convert to block, we assume that item length is 128bit
-            std::vector<block> a1;
-            packToBlocks(dataShare4PrevIDs, rows, cols, a1);
-            
-            // ---------- OT#1: P1(sender) -> P0(receiver) , messages: N0=r10, N1=r10 ^ a0
-            std::vector<block> r01(otCount);
-            prng.get(r01.data(), otCount);
-
-            std::vector<std::array<block, 2>> ot1Msgs(otCount);
-
-            for (u64 k = 0; k < otCount; k++) {
-                ot1Msgs[k][0] = r01[k];
-                ot1Msgs[k][1] = r01[k] ^ a1[k];
-            }
-
-            oc::SilentOtExtSender ot1Sender;
-            ot1Sender.configure(otCount);
+            xorPrefix(memShare, mMemShare4PrevIDs);                             // T xor T^new
+            xorRowsPrefix(dataShare, mDataShare4PrevIDs);                       // p' where m' = 1
+        }
+        YSize = cp.mYSize;
+        cp.mActive = false;
+        ++mUpdateEpoch;
+        if (cp.mRebuild || cp.mPrevRows != 0)
+            mRewriteEpoch = mUpdateEpoch;
+        adviseTables();
+    }
 
-            co_await ot1Sender.sendChosen(ot1Msgs, prng, chl);
+    void PseudonymisedDB_P1::rollbackUpdate()
+    {
+        auto& cp = mCheckpoint;
+        memShare.resize(cp.mPrevRows);
+        dataShare.resize(cp.mPrevRows, dataShare.cols());
+        ownDataShare.resize(cp.mPrevRows, ownDataShare.cols());
+        mAggregates.setShares(cp.mAggregateShares);
+        cp.mActive = false;
+    }
 
-            // ---------- OT#2: P0(sender) -> P1(receiver), , choice = m1
+    void PseudonymisedDB_P1::appendUnmatched(oc::u64 rows)
+    {
+        if (mCheckpoint.mActive)
+            throw RTE_LOC;
 
-            oc::BitVector choice_m1(otCount);
-            for (u64 i = 0; i < rows; ++i) {
-                const bool m1 = memShare4PrevIDs[i];
-                for (u64 j = 0; j < numBlk; ++j) {
-                    choice_m1[i * numBlk + j] = m1;
-                }
-            }
+        auto prev = memShare.size();
+        memShare.resize(prev + rows);
+        for (u64 i = prev; i < prev + rows; ++i)
+            memShare[i] = 0;
+        dataShare.resize(prev + rows, dataShare.cols());
+        ownDataShare.resize(prev + rows, ownDataShare.cols());
+        ++mUpdateEpoch;
+        adviseTables();
+    }
 
-            std::vector<block> t10(otCount); // receive N_{m1}
-            oc::SilentOtExtReceiver ot2Receiver;
-            ot2Receiver.configure(otCount);
-            co_await ot2Receiver.receiveChosen(choice_m1, t10, prng, chl);
-
-            // ---------- local term: l1 = m1 ? a1 : 0  (m1 is P1 share bit)
-            for (u64 i = 0; i < rows; ++i) {
-                if (!memShare4PrevIDs[i]) {
-                    for (u64 j = 0; j < numBlk; ++j) {
-                        a1[i * numBlk + j] = oc::ZeroBlock;
-                    }
-                }
-            }
+    Proto PseudonymisedDB_P1::membershipShares_P1(oc::BitVector& memShares, Socket& chl)
+    {
+        if (mNumKeys != 1)
+            throw RTE_LOC;
+        memShares.resize(0);
+        co_await mSsljSender.sendMembership(UID, memShares, true, chl);
+    }
 
-            // ---------- P1 final masked share:
-            // q1 = l1 ^ r01 ^ t10  ==> XOR with P0's q0 yields m * payload; 0 if non-member
-            for (u64 k = 0; k < otCount; ++k) {
-                a1[k] = a1[k] ^ r01[k] ^ t10[k];
-            }
+    Proto PseudonymisedDB_P1::countMatches_P1(oc::u64& countShare, Socket& chl)
+    {
+        if (mNumKeys != 1)
+            throw RTE_LOC;
+        oc::BitVector flags;
+        co_await mSsljSender.sendMembership(UID, flags, false, chl);
+        co_await mBitSum.count(1, flags, countShare, chl);
+    }
 
-            // block -> matrix(u8)
-            unpackFromBlocks(a1, rows, cols, dataShare4PrevIDs);
+    Proto PseudonymisedDB_P1::innerJoin_P1(oc::Matrix<oc::u8>& rows, oc::u64& count, Socket& chl)
+    {
+        if (mCheckpoint.mActive)
+            throw RTE_LOC;
+        co_await compactTable(mCompaction, mScratch, 1, memShare, dataShare, ownDataShare, rows, count, chl);
+    }
 
+    Proto PseudonymisedDB_P1::registerAggregate_P1(
+        const AggregateSpec& spec, oc::u64& id, Socket& chl)
+    {
+        // the pending rows are folded in by the update itself
+        if (mCheckpoint.mActive)
+            throw RTE_LOC;
+        id = mAggregates.add(spec, dataShare.cols());
+        co_await mAggregates.accumulate(1, memShare,
+            oc::MatrixView<const oc::u8>(dataShare.data(), dataShare.rows(), dataShare.cols()),
+            false, chl, { id });
+    }
 
-        }
-        else{
-            // std::cout << "skip SSLJ(X, Y')\n";
-        }
-        timer.setTimePoint("SSLJ(X, Y') end");
 
-        oc::BitVector memShare4Upd;
-        oc::Matrix<oc::u8> dataShare4Upd;
 
-        co_await mSsljSender.send(
-            AllIDs, AllPayloads, memShare4Upd, dataShare4Upd, chl);             // SSLJ(X', Y \cup Y'), provide Y \cup Y' with payload
+    void PseudonymisedDB_P0::adviseTables()
+    {
+        mUidRange.update(UID.data(), UID.capacity() * sizeof(oc::block), mAllocPolicy);
+        mDataRange.update(myData.data(), myData.size(), mAllocPolicy);
+        mDataShareRange.update(dataShare.data(), dataShare.size(), mAllocPolicy);
+        mOwnDataShareRange.update(ownDataShare.data(), ownDataShare.size(), mAllocPolicy);
+    }
 
-        // T || T^add
-        memShare.append(memShare4Upd);                                          
-        dataShare.resize(XSize + X_Size, dataShare.cols(), AllocType::Uninitialized);
-        std::memcpy(
-            dataShare.data(XSize), dataShare4Upd.data(), dataShare4Upd.size());
-        timer.setTimePoint("SSLJ(X', Y ∪ Y') end");
-        // std::cout << timer << "\n";
+    void PseudonymisedDB_P0::setAllocPolicy(const AllocPolicy& policy)
+    {
+        mAllocPolicy = policy;
+        mDoublePrf.setAllocPolicy(policy);
+        mSsljReceiver.setAllocPolicy(policy);
+        mSsljSender.setAllocPolicy(policy);
+        mSsljReceiver4Upd.setAllocPolicy(policy);
+        mSsljSender4Upd.setAllocPolicy(policy);
+        mMultiKeyReceiver.setAllocPolicy(policy);
+        mMux.setAllocPolicy(policy);
+        mBitSum.setAllocPolicy(policy);
+        mAggregates.setAllocPolicy(policy);
+        mScratch.setPolicy(policy);
+
+        // re-advise the whole tables under the new policy
+        mUidRange = {};
+        mDataRange = {};
+        mDataShareRange = {};
+        mOwnDataShareRange = {};
+        adviseTables();
     }
 
+    PageReport PseudonymisedDB_P0::pageReport()
+    {
+        PageReport r;
+        r += uppid::pageReport(UID.data(), UID.capacity() * sizeof(oc::block));
+        r += uppid::pageReport(myData.data(), myData.size());
+        r += uppid::pageReport(dataShare.data(), dataShare.size());
+        r += uppid::pageReport(ownDataShare.data(), ownDataShare.size());
+        r += uppid::pageReport(mMemShare4PrevIDs.data(), mMemShare4PrevIDs.sizeBytes());
+        r += uppid::pageReport(mDataShare4PrevIDs.data(), mDataShare4PrevIDs.size());
+        r += mSsljReceiver.mScratch.pageReport();
+        r += mSsljSender.mScratch.pageReport();
+        r += mSsljReceiver4Upd.mScratch.pageReport();
+        r += mSsljSender4Upd.mScratch.pageReport();
+        r += mMultiKeyReceiver.pageReport();
+        r += mMux.pageReport();
+        r += mBitSum.pageReport();
+        r += mAggregates.pageReport();
+        r += mScratch.pageReport();
+        r += mDoublePrf.pageReport();
+        return r;
+    }
 
+    void PseudonymisedDB_P1::adviseTables()
+    {
+        mUidRange.update(UID.data(), UID.capacity() * sizeof(oc::block), mAllocPolicy);
+        mDataRange.update(myData.data(), myData.size(), mAllocPolicy);
+        mDataShareRange.update(dataShare.data(), dataShare.size(), mAllocPolicy);
+        mOwnDataShareRange.update(ownDataShare.data(), ownDataShare.size(), mAllocPolicy);
+    }
 
+    void PseudonymisedDB_P1::setAllocPolicy(const AllocPolicy& policy)
+    {
+        mAllocPolicy = policy;
+        mDoublePrf.setAllocPolicy(policy);
+        mSsljReceiver.setAllocPolicy(policy);
+        mSsljSender.setAllocPolicy(policy);
+        mSsljReceiver4Upd.setAllocPolicy(policy);
+        mSsljSender4Upd.setAllocPolicy(policy);
+        mMultiKeySender.setAllocPolicy(policy);
+        mMux.setAllocPolicy(policy);
+        mBitSum.setAllocPolicy(policy);
+        mAggregates.setAllocPolicy(policy);
+        mScratch.setPolicy(policy);
+
+        // re-advise the whole tables under the new policy
+        mUidRange = {};
+        mDataRange = {};
+        mDataShareRange = {};
+        mOwnDataShareRange = {};
+        adviseTables();
+    }
 
-}
\ No newline at end of file
+    PageReport PseudonymisedDB_P1::pageReport()
+    {
+        PageReport r;
+        r += uppid::pageReport(UID.data(), UID.capacity() * sizeof(oc::block));
+        r += uppid::pageReport(myData.data(), myData.size());
+        r += uppid::pageReport(dataShare.data(), dataShare.size());
+        r += uppid::pageReport(ownDataShare.data(), ownDataShare.size());
+        r += uppid::pageReport(mMemShare4PrevIDs.data(), mMemShare4PrevIDs.sizeBytes());
+        r += uppid::pageReport(mDataShare4PrevIDs.data(), mDataShare4PrevIDs.size());
+        r += mSsljReceiver.mScratch.pageReport();
+        r += mSsljSender.mScratch.pageReport();
+        r += mSsljReceiver4Upd.mScratch.pageReport();
+        r += mSsljSender4Upd.mScratch.pageReport();
+        r += mMultiKeySender.pageReport();
+        r += mMux.pageReport();
+        r += mBitSum.pageReport();
+        r += mAggregates.pageReport();
+        r += mScratch.pageReport();
+        r += mDoublePrf.pageReport();
+        return r;
+    }
+}
@@ -1,6 +1,18 @@
 #pragma once
 #include "DoublePrf.h"
 #include "SsLeftJoin.h"
+#include "MultiKeySsLeftJoin.h"
+#include "SecureMux.h"
+#include "SecureBitSum.h"
+#include "Aggregates.h"
+#include "SecureCompaction.h"
+#include "Memory.h"
+#include "CostModel.h"
+#include "Transcript.h"
+
+#include <optional>
+#include <string>
+#include <thread>
 
 namespace uppid
 {
@@ -10,6 +22,87 @@ namespace uppid
     // P_0 has set X
     // P_1 has set Y along with associated payload p_y
 
+    // Progress of a shareUpdate that has not been committed yet. The outputs
+    // of the finished steps are kept (the rows of SSLJ (X', Y \cup Y') sit
+    // past mPrevRows in memShare / dataShare), so a shareUpdate on a new
+    // socket continues with the steps that are missing on either side.
+    struct UpdateCheckpoint
+    {
+        enum Step : oc::u8
+        {
+            JoinPrevious = 1,   // SSLJ (X, Y')
+            MuxPrevious = 2,    // mux of its payload shares against the rows of X
+            JoinUpdated = 4,    // SSLJ (X', Y \cup Y')
+            Aggregates = 8,     // standing aggregates advanced
+            AllSteps = 15
+        };
+
+        bool mActive = false;
+        oc::u8 mDone = 0;
+
+        // SSLJ (X \cup X', Y \cup Y') into the spare buffers instead of the
+        // incremental steps, see CostModel
+        bool mRebuild = false;
+
+        // |X| and |X'| of the update
+        oc::u64 mPrevRows = 0;
+        oc::u64 mNewRows = 0;
+
+        // |Y| and |Y \cup Y'|
+        oc::u64 mPrevYSize = 0;
+        oc::u64 mYSize = 0;
+
+        // chosen by P_1, masks P_0's payloads of the new rows
+        oc::block mOwnDataSeed = oc::ZeroBlock;
+
+        // aggregate shares before the update
+        std::vector<oc::u64> mAggregateShares;
+    };
+
+    // per-update buffers of PseudonymisedDB_P0 / _P1, kept across updates
+    enum PseudonymisedScratch : oc::u64
+    {
+        ScratchMuxRows,
+        ScratchMerged,
+        ScratchTable,
+        NumPseudonymisedScratch
+    };
+
+    enum class UpdatePolicy
+    {
+        // whatever the cost model predicts to be faster
+        Auto,
+        Incremental,
+        Rebuild
+    };
+
+    // What the last shareUpdate did.
+    struct UpdateMetrics
+    {
+        // the tables were rebuilt with SSLJ (X \cup X', Y \cup Y')
+        bool mRebuild = false;
+
+        // predicted seconds of both ways (P_0 only, P_0 decides)
+        double mIncrementalCost = 0;
+        double mRebuildCost = 0;
+
+        // |X|, |X'|, |Y|, |Y'|
+        oc::u64 mPrevRows = 0;
+        oc::u64 mNewRows = 0;
+        oc::u64 mPrevYSize = 0;
+        oc::u64 mNewYSize = 0;
+
+        // wall time, summed over the calls of a resumed update
+        double mSeconds = 0;
+
+        // my flights (see TranscriptStats::mFlights), summed the same way;
+        // 0 unless setTranscriptStats gave the stats of the socket
+        oc::u64 mFlights = 0;
+
+        // instruction set of the local kernels, see kernelIsa()
+        std::string mKernelIsa;
+    };
+
     class PseudonymisedDB_P0 : oc::TimerAdapter
     { 
         // TODO: Key만 갖고 있는게 더 예쁘긴 함
@@ -17,40 +110,285 @@ namespace uppid
         SsLeftJoinReceiver  mSsljReceiver;
         SsLeftJoinSender    mSsljSender;
 
+        // SSLJ (X', Y \cup Y') runs concurrently with SSLJ (X, Y'),
+        // so it gets its own instance (and PRNG).
+        SsLeftJoinReceiver  mSsljReceiver4Upd;
+        SsLeftJoinSender    mSsljSender4Upd;
+
+        // SSLJ (X \cup X', Y \cup Y') of tables with several identifiers per row
+        MultiKeySsLeftJoinReceiver mMultiKeyReceiver;
+
+        // mux of the payload shares of SSLJ (X, Y') against the rows of X
+        SecureMux           mMux;
+
+        // B2A of the membership bits of countMatches
+        SecureBitSum        mBitSum;
+
+        // registered aggregates, advanced by shareUpdate
+        StandingAggregates  mAggregates;
+
+        // inner join output of the table
+        SecureCompaction    mCompaction;
+
         oc::u64 mPartyIdx;
 
+        // identifiers per row, UID holds mNumKeys of them for every row
+        oc::u64 mNumKeys = 1;
+
         std::vector<oc::block> UID;
         oc::Matrix<oc::u8> myData;
         
         oc::BitVector memShare;
         oc::Matrix<oc::u8> dataShare;
 
+        // shares of myData (P_0's payloads), in the rows of memShare / dataShare
+        oc::Matrix<oc::u8> ownDataShare;
+
+        // output of SSLJ (X, Y'), kept so that later updates reuse the memory
+        oc::BitVector mMemShare4PrevIDs;
+        oc::Matrix<oc::u8> mDataShare4PrevIDs;
+
+        // staging of the mux, aggregates and inner join
+        ScratchArena mScratch{ NumPseudonymisedScratch };
+
+        // backing of UID, myData, dataShare, ownDataShare and of the per-update buffers
+        AllocPolicy mAllocPolicy;
+        AdvisedRange mUidRange, mDataRange, mDataShareRange, mOwnDataShareRange;
+
+        // apply mAllocPolicy to the parts of the tables that are new
+        void adviseTables();
+
+        // shareUpdate in progress, the number of committed ones, and the
+        // last one that changed rows it did not add
+        UpdateCheckpoint mCheckpoint;
+        oc::u64 mUpdateEpoch = 0;
+        oc::u64 mRewriteEpoch = 0;
+
+        // incremental update vs rebuild
+        CostModel mCostModel;
+        UpdatePolicy mUpdatePolicy = UpdatePolicy::Auto;
+        UpdateMetrics mLastUpdate;
+
+        // see setWanMode
+        bool mWan = false;
+
+        // see setTranscriptStats
+        std::shared_ptr<TranscriptStats> mTranscriptStats;
+
+        // drop the rows of an uncommitted update
+        void rollbackUpdate();
+
+        // Merge the update into the tables. Row i of X keeps its payload
+        // share d[i] unless it newly matched Y': the mux of SSLJ (X, Y') gave
+        // shares of m'[i] * (p'[i] ^ d[i]), XORed onto d[i] that is p'[i]
+        // where m'[i] = 1 and d[i] elsewhere.
+        void commitUpdate();
+
+        // SSLJ (X, Y') and the mux of its payload shares against the rows
+        // of X, prevShares, the steps that are not done yet. See commitUpdate.
+        // done is the branch's own copy of the checkpoint flags, it runs
+        // concurrently with SSLJ (X', Y \cup Y'). So are the seconds of the
+        // steps it ran, for the cost model.
+        Proto joinPrevious_P0(
+            oc::span<oc::block> previousIDs,
+            oc::MatrixView<const oc::u8> prevShares,
+            oc::BitVector& memShare4PrevIDs,
+            oc::Matrix<oc::u8>& dataShare4PrevIDs,
+            oc::u8& done,
+            std::optional<double>& ssljSeconds,
+            std::optional<double>& muxSeconds,
+            Socket& chl);
+
     public:
+        // dataByteSize is the width of P_1's payloads, ownDataByteSize the
+        // width of mine (0: P_1 is the only one with payloads). Both parties
+        // must use the same two.
+        //
+        // numKeys > 1: every row has numKeys identifiers (email, phone, ...),
+        // given to insertID row after row, oc::ZeroBlock for an absent one.
+        // A row of X matches a row of Y if some slot agrees, the lowest such
+        // slot picks the payload (see MultiKeySsLeftJoin). Such tables are
+        // rebuilt on every shareUpdate, as two rows of Y may match one row
+        // of X, and have no rotateKey, compactKeys, membershipShares or
+        // countMatches. Both parties must use the same numKeys.
         PseudonymisedDB_P0(
             oc::u64 dataByteSize,
             oc::block randomSeed = oc::ZeroBlock,
             PrfType prfType = PrfType::AltMod,
-            oc::u64 oteBatchSize = 1ull << 22);
+            oc::u64 oteBatchSize = 1ull << 22,
+            oc::u64 ownDataByteSize = 0,
+            oc::u64 numKeys = 1);
 
         Proto respondOPRF(Socket& chl);
 
         Proto insertID(
             oc::span<oc::block> input, 
-            // oc::MatrixView<oc::u8> inputData,
             Socket& chl);
+
+        // insertID with one payload row (ownDataByteSize bytes) per identifier
+        Proto insertID(
+            oc::span<oc::block> input, 
+            oc::MatrixView<oc::u8> inputData,
+            Socket& chl);
+
+        // insertID with my half of the double PRF precomputed by evalLocal
+        Proto insertID(
+            oc::span<oc::block> input, 
+            oc::span<const oc::block> localPrf,
+            Socket& chl);
+
+        Proto insertID(
+            oc::span<oc::block> input, 
+            oc::span<const oc::block> localPrf,
+            oc::MatrixView<oc::u8> inputData,
+            Socket& chl);
+
+        // My half of the double PRF for input, computed locally on the
+        // DoublePrf threads. For bulk loads that prepare it ahead of insertID.
+        void evalLocal(oc::span<const oc::block> input, oc::span<oc::block> localPrf) const
+        {
+            mDoublePrf.evalLocal(input, localPrf);
+        }
         
         void DinsertID(
-            oc::span<oc::block> input
+            oc::span<oc::block> input,
+            oc::MatrixView<oc::u8> inputData = {}
         );
         
-        // Update memShare, dataShare 
+        // Update memShare, dataShare and ownDataShare
+        //
+        // My payloads do not need a join: the table is in the row order of
+        // X, so the new rows of ownDataShare are shared from myData
+        // directly, under a mask P_1 expands from a seed it sends.
+        //
+        // The update is checkpointed after every step and committed at the
+        // end, once both parties are known to hold all of them. If the socket
+        // fails the tables keep their committed rows (plus the pending ones,
+        // see UpdateCheckpoint), and the next shareUpdate, e.g. on a new
+        // connection, resumes from the steps both parties finished. If the
+        // peer had already committed it only commits and returns; rows
+        // inserted in the meantime go into the next update.
         Proto shareUpdate_P0(Socket& chl);
+
+        // Cover the rows inserted since the last shareUpdate without a join:
+        // membership and payload shares of 0, my payloads in my share. Only
+        // correct if the peer holds no identifiers at all, e.g. an empty shard
+        // of ShardedPseudonymisedDB. The peer calls appendUnmatched with the
+        // same rows.
+        void appendUnmatched(oc::u64 rows);
+
+        bool hasPendingUpdate() const { return mCheckpoint.mActive; }
+        oc::u8 pendingSteps() const { return mCheckpoint.mDone; }
+
+        // number of committed shareUpdates
+        oc::u64 updateEpoch() const { return mUpdateEpoch; }
+
+        // The epoch of the last shareUpdate that changed the shares of rows
+        // that were there before it: an incremental one over a non-empty
+        // table (T xor T^new, late matches) or a rebuild. Copies of the
+        // shares taken before it are stale, see exportShares.
+        oc::u64 rewriteEpoch() const { return mRewriteEpoch; }
+
+        // shareUpdate either adds the new rows (SSLJ (X, Y'), mux and SSLJ
+        // (X', Y \cup Y')) or, when the cost model expects it to be cheaper,
+        // rebuilds the tables with one SSLJ (X \cup X', Y \cup Y'). A rebuild
+        // is also exact when Y and Y' intersect. The model is refit from the
+        // measured steps of every update.
+        void setUpdatePolicy(UpdatePolicy policy) { mUpdatePolicy = policy; }
+        CostModel& costModel() { return mCostModel; }
+        const UpdateMetrics& lastUpdateMetrics() const { return mLastUpdate; }
+
+        // Membership of all of P_0's UIDs in all of P_1's, without payload
+        // and without touching the tables. Must run together with the
+        // peer's call of the same name.
+        // - membershipShares: XOR shares of (x[i] in Y), in the row order of X
+        // - countMatches: additive shares (mod 2^64) of |X cap Y|, from the
+        //   CPSI flags directly, so no permutation is needed
+        Proto membershipShares_P0(oc::BitVector& memShares, Socket& chl);
+        Proto countMatches_P0(oc::u64& countShare, Socket& chl);
+
+        // The table as an inner join: shares of [dataShare | ownDataShare]
+        // of the matched rows only, count of them, in an order neither party
+        // knows (see SecureCompaction). Reveals count to both parties.
+        // Aggregates and exports over rows then skip the unmatched ones
+        // (membership 1 for every row). Must run together with the peer's
+        // innerJoin_P1.
+        Proto innerJoin_P0(oc::Matrix<oc::u8>& rows, oc::u64& count, Socket& chl);
+
+        // Standing aggregate over the matched rows of the table. Registering
+        // folds in the rows already present, after that every shareUpdate
+        // adds only the rows it appends and the rows of X that newly matched
+        // Y', so reading one costs the same at any table size. Must run
+        // together with the peer's call, with the same spec.
+        Proto registerAggregate_P0(const AggregateSpec& spec, oc::u64& id, Socket& chl);
+
+        // my additive share (mod 2^64) of aggregate id
+        oc::u64 aggregateShare(oc::u64 id) const { return mAggregates.share(id); }
+
+        // open aggregate id to both parties
+        Proto revealAggregate(oc::u64 id, oc::u64& value, Socket& chl)
+        {
+            return mAggregates.reveal(id, value, chl);
+        }
+
+        // Rotate the PRF key and re-derive every UID under it, chunkSize
+        // UIDs at a time. memShare / dataShare are kept as they are: both
+        // parties' UIDs go through the same function, so the rows and their
+        // matches do not change. Must run together with the peer's rotateKey.
+        //
+        // The new UIDs go to a spare buffer, swapped in with the new key once
+        // both parties sent they hold theirs, so a failure leaves UID and the
+        // key epochs as they were. Throws while an update is pending.
+        Proto rotateKey(
+            Socket& chl,
+            oc::u64 chunkSize = 1ull << 20,
+            oc::u64 numThreads = std::thread::hardware_concurrency());
+
+        // Every rotateKey adds a key epoch that insertID chains, one OPRF
+        // each. compactKeys retires all of them for one fresh key and
+        // re-derives UID from input, the identifiers of every insertID so
+        // far in insertion order, as the pseudonyms cannot be mapped back.
+        // memShare / dataShare are kept as in rotateKey, and so is a failure.
+        // Must run together with the peer's compactKeys.
+        Proto compactKeys(oc::span<oc::block> input, Socket& chl);
         
         std::vector<oc::block>&  getUID() {return UID;};
+        oc::u64                  numKeys() const {return mNumKeys;};
         oc::Matrix<oc::u8>&      getData() {return myData;};
 
         oc::BitVector&           getMemShare() {return memShare;};
         oc::Matrix<oc::u8>&      getDataShare() {return dataShare;};
+        oc::Matrix<oc::u8>&      getOwnDataShare() {return ownDataShare;};
+
+        // Huge pages / NUMA node for the tables and the SSLJ, mux and OPRF
+        // buffers. Tables are advised as they grow; explicit huge pages only
+        // apply to the internal buffers, the tables get transparent ones.
+        void setAllocPolicy(const AllocPolicy& policy);
+
+        // threads for the local half of the double PRF
+        void setNumThreads(oc::u64 numThreads) { mDoublePrf.setNumThreads(numThreads); }
+
+        // WAN mode, for links where the round trips dominate: shareUpdate
+        // sends the set sizes with the checkpoint exchange, P_1's mask seed
+        // in the same flight as P_0's choice of update, and the SSLJs take
+        // their sizes from there instead of exchanging them again. The DDH
+        // double PRF drops its size message. Both parties must agree.
+        void setWanMode(bool wan)
+        {
+            mWan = wan;
+            mDoublePrf.setWanMode(wan);
+        }
+
+        // Stats of the socket shareUpdate runs on, a makeRecordingSocket
+        // wrapper, so that UpdateMetrics::mFlights counts the flights of
+        // every update, e.g. to compare WAN mode against the default.
+        void setTranscriptStats(std::shared_ptr<TranscriptStats> stats)
+        {
+            mTranscriptStats = std::move(stats);
+        }
+
+        // page sizes achieved for the tables and the internal buffers
+        PageReport pageReport();
     };
 
     class PseudonymisedDB_P1 : oc::TimerAdapter
@@ -60,22 +398,97 @@ namespace uppid
         SsLeftJoinReceiver  mSsljReceiver;
         SsLeftJoinSender    mSsljSender;
 
+        // SSLJ (X', Y \cup Y') runs concurrently with SSLJ (X, Y'),
+        // so it gets its own instance (and PRNG).
+        SsLeftJoinReceiver  mSsljReceiver4Upd;
+        SsLeftJoinSender    mSsljSender4Upd;
+
+        // See PseudonymisedDB_P0::mMultiKeyReceiver.
+        MultiKeySsLeftJoinSender mMultiKeySender;
+
+        // mux of the payload shares of SSLJ (X, Y') against the rows of X
+        SecureMux           mMux;
+
+        // B2A of the membership bits of countMatches
+        SecureBitSum        mBitSum;
+
+        // registered aggregates, advanced by shareUpdate
+        StandingAggregates  mAggregates;
+
+        // inner join output of the table
+        SecureCompaction    mCompaction;
+
         oc::u64 mPartyIdx;
 
+        // identifiers per row, UID holds mNumKeys of them for every row
+        oc::u64 mNumKeys = 1;
+
         std::vector<oc::block> UID;
         oc::Matrix<oc::u8> myData;
         
         oc::BitVector memShare;
         oc::Matrix<oc::u8> dataShare;
 
+        // shares of P_0's payloads, in the rows of memShare / dataShare
+        oc::Matrix<oc::u8> ownDataShare;
+
+        // output of SSLJ (X, Y'), kept so that later updates reuse the memory
+        oc::BitVector mMemShare4PrevIDs;
+        oc::Matrix<oc::u8> mDataShare4PrevIDs;
+
+        // staging of the mux, aggregates and inner join
+        ScratchArena mScratch{ NumPseudonymisedScratch };
+
+        // backing of UID, myData, dataShare, ownDataShare and of the per-update buffers
+        AllocPolicy mAllocPolicy;
+        AdvisedRange mUidRange, mDataRange, mDataShareRange, mOwnDataShareRange;
+
+        // apply mAllocPolicy to the parts of the tables that are new
+        void adviseTables();
+
+        // shareUpdate in progress, the number of committed ones, and the
+        // last one that changed rows it did not add
+        UpdateCheckpoint mCheckpoint;
+        oc::u64 mUpdateEpoch = 0;
+        oc::u64 mRewriteEpoch = 0;
+        UpdateMetrics mLastUpdate;
+
+        // see PseudonymisedDB_P0::setWanMode
+        bool mWan = false;
+
+        // see PseudonymisedDB_P0::setTranscriptStats
+        std::shared_ptr<TranscriptStats> mTranscriptStats;
+
+        // drop the rows of an uncommitted update
+        void rollbackUpdate();
+        // See PseudonymisedDB_P0::commitUpdate.
+        void commitUpdate();
+
         oc::u64 YSize = 0;
 
+        // seeds of the masks of P_0's payloads
+        oc::PRNG mPrng;
+
+        // SSLJ (X, Y') and the mux of its payload shares against the rows
+        // of X, prevShares, the steps that are not done yet. See commitUpdate.
+        Proto joinPrevious_P1(
+            oc::span<oc::block> updatedIDs,
+            oc::MatrixView<oc::u8> updatedPayloads,
+            oc::MatrixView<const oc::u8> prevShares,
+            oc::BitVector& memShare4PrevIDs,
+            oc::Matrix<oc::u8>& dataShare4PrevIDs,
+            oc::u8& done,
+            Socket& chl);
+
     public:
+        // ownDataByteSize, numKeys: as given to P_0
         PseudonymisedDB_P1(
             oc::u64 dataByteSize,
             oc::block randomSeed = oc::ZeroBlock,
             PrfType prfType = PrfType::AltMod,
-            oc::u64 oteBatchSize = 1ull << 22);
+            oc::u64 oteBatchSize = 1ull << 22,
+            oc::u64 ownDataByteSize = 0,
+            oc::u64 numKeys = 1);
 
         Proto respondOPRF(Socket& chl);
 
@@ -84,18 +497,100 @@ namespace uppid
             oc::MatrixView<oc::u8> inputData,
             Socket& chl);
 
+        // insertID with my half of the double PRF precomputed by evalLocal
+        Proto insertID(
+            oc::span<oc::block> input,
+            oc::span<const oc::block> localPrf,
+            oc::MatrixView<oc::u8> inputData,
+            Socket& chl);
+
+        // My half of the double PRF for input, computed locally on the
+        // DoublePrf threads. For bulk loads that prepare it ahead of insertID.
+        void evalLocal(oc::span<const oc::block> input, oc::span<oc::block> localPrf) const
+        {
+            mDoublePrf.evalLocal(input, localPrf);
+        }
+
         void DinsertID(
             oc::span<oc::block> input,
             oc::MatrixView<oc::u8> inputData
         );
         
-        // Update memShare, dataShare 
+        // Update memShare, dataShare and ownDataShare.
+        // See PseudonymisedDB_P0::shareUpdate_P0.
         Proto shareUpdate_P1(Socket& chl);
 
+        // See PseudonymisedDB_P0::appendUnmatched.
+        void appendUnmatched(oc::u64 rows);
+
+        bool hasPendingUpdate() const { return mCheckpoint.mActive; }
+        oc::u8 pendingSteps() const { return mCheckpoint.mDone; }
+
+        // number of committed shareUpdates
+        oc::u64 updateEpoch() const { return mUpdateEpoch; }
+
+        // See PseudonymisedDB_P0::rewriteEpoch.
+        oc::u64 rewriteEpoch() const { return mRewriteEpoch; }
+
+        // how P_0 chose to run the last shareUpdate
+        const UpdateMetrics& lastUpdateMetrics() const { return mLastUpdate; }
+
+        // See PseudonymisedDB_P0::membershipShares_P0 / countMatches_P0.
+        Proto membershipShares_P1(oc::BitVector& memShares, Socket& chl);
+        Proto countMatches_P1(oc::u64& countShare, Socket& chl);
+
+        // See PseudonymisedDB_P0::innerJoin_P0.
+        Proto innerJoin_P1(oc::Matrix<oc::u8>& rows, oc::u64& count, Socket& chl);
+
+        // See PseudonymisedDB_P0::registerAggregate_P0.
+        Proto registerAggregate_P1(const AggregateSpec& spec, oc::u64& id, Socket& chl);
+
+        // my additive share (mod 2^64) of aggregate id
+        oc::u64 aggregateShare(oc::u64 id) const { return mAggregates.share(id); }
+
+        // open aggregate id to both parties
+        Proto revealAggregate(oc::u64 id, oc::u64& value, Socket& chl)
+        {
+            return mAggregates.reveal(id, value, chl);
+        }
+
+        // See PseudonymisedDB_P0::rotateKey.
+        Proto rotateKey(
+            Socket& chl,
+            oc::u64 chunkSize = 1ull << 20,
+            oc::u64 numThreads = std::thread::hardware_concurrency());
+
+        // See PseudonymisedDB_P0::compactKeys.
+        Proto compactKeys(oc::span<oc::block> input, Socket& chl);
+
         std::vector<oc::block>&  getUID() {return UID;};
+        oc::u64                  numKeys() const {return mNumKeys;};
         oc::Matrix<oc::u8>&      getData() {return myData;};
 
         oc::BitVector&           getMemShare() {return memShare;};
         oc::Matrix<oc::u8>&      getDataShare() {return dataShare;};
+        oc::Matrix<oc::u8>&      getOwnDataShare() {return ownDataShare;};
+
+        // See PseudonymisedDB_P0::setAllocPolicy.
+        void setAllocPolicy(const AllocPolicy& policy);
+
+        // threads for the local half of the double PRF
+        void setNumThreads(oc::u64 numThreads) { mDoublePrf.setNumThreads(numThreads); }
+
+        // See PseudonymisedDB_P0::setWanMode.
+        void setWanMode(bool wan)
+        {
+            mWan = wan;
+            mDoublePrf.setWanMode(wan);
+        }
+
+        // See PseudonymisedDB_P0::setTranscriptStats.
+        void setTranscriptStats(std::shared_ptr<TranscriptStats> stats)
+        {
+            mTranscriptStats = std::move(stats);
+        }
+
+        // page sizes achieved for the tables and the internal buffers
+        PageReport pageReport();
     };
 }
\ No newline at end of file
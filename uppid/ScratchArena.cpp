@@ -0,0 +1,80 @@
+#include "ScratchArena.h"
+#include <cstdlib> // aligned_alloc
+
+using namespace oc;
+
+namespace uppid
+{
+    static constexpr u64 ScratchAlignment = 64;
+
+    void ScratchArena::Free::operator()(oc::u8* p) const
+    {
+        if (mMapped)
+            freePages(p, mMapped);
+        else
+            std::free(p);
+    }
+
+    oc::u8* ScratchArena::reserve(oc::u64 slot, oc::u64 bytes)
+    {
+        if (slot >= mBuffers.size())
+            throw RTE_LOC;
+
+        auto& buff = mBuffers[slot];
+        if (bytes > buff.mCapacity)
+        {
+            // grow geometrically so that a slowly growing table does not
+            // reallocate on every update
+            auto capacity = std::max<u64>(bytes, buff.mCapacity + buff.mCapacity / 2);
+            capacity = (capacity + ScratchAlignment - 1) / ScratchAlignment * ScratchAlignment;
+
+            buff.mData.reset();
+            if (mPolicy.isDefault())
+            {
+                buff.mData = { (u8*)std::aligned_alloc(ScratchAlignment, capacity), Free{} };
+                if (!buff.mData)
+                    throw std::bad_alloc();
+            }
+            else
+            {
+                // page aligned, which is also ScratchAlignment aligned
+                u64 mapped = 0;
+                auto ptr = allocPages(capacity, mPolicy, mapped);
+                buff.mData = { ptr, Free{ mapped } };
+            }
+            buff.mCapacity = capacity;
+        }
+        return buff.mData.get();
+    }
+
+    oc::u64 ScratchArena::capacity() const
+    {
+        u64 total = 0;
+        for (auto& buff : mBuffers)
+            total += buff.mCapacity;
+        return total;
+    }
+
+    void ScratchArena::release()
+    {
+        for (auto& buff : mBuffers)
+        {
+            buff.mData.reset();
+            buff.mCapacity = 0;
+        }
+    }
+
+    void ScratchArena::setPolicy(const AllocPolicy& policy)
+    {
+        release();
+        mPolicy = policy;
+    }
+
+    PageReport ScratchArena::pageReport() const
+    {
+        PageReport r;
+        for (auto& buff : mBuffers)
+            r += uppid::pageReport(buff.mData.get(), buff.mCapacity);
+        return r;
+    }
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include "cryptoTools/Common/Defines.h"
+#include "Memory.h"
+
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+namespace uppid
+{
+    // Pool of 64-byte aligned scratch buffers that survive across calls.
+    // Each owner names its buffers with a fixed set of slots. A slot only grows,
+    // so once the sizes settle, repeated protocol runs do no large allocations
+    // and touch no fresh pages.
+    //
+    // Different slots may be used concurrently. A single slot may not.
+    class ScratchArena
+    {
+        struct Free
+        {
+            // size of the mapping if the buffer came from allocPages, else 0
+            oc::u64 mMapped;
+            Free() : mMapped(0) {}
+            Free(oc::u64 mapped) : mMapped(mapped) {}
+            void operator()(oc::u8* p) const;
+        };
+
+        struct Buffer
+        {
+            std::unique_ptr<oc::u8[], Free> mData;
+            oc::u64 mCapacity = 0;
+        };
+
+        std::vector<Buffer> mBuffers;
+        AllocPolicy mPolicy;
+
+        oc::u8* reserve(oc::u64 slot, oc::u64 bytes);
+
+    public:
+        ScratchArena(oc::u64 numSlots = 0)
+            : mBuffers(numSlots)
+        {}
+
+        ScratchArena(ScratchArena&&) = default;
+        ScratchArena& operator=(ScratchArena&&) = default;
+
+        // n elements of the buffer of slot. The contents are whatever the
+        // previous user left there.
+        template<typename T>
+        oc::span<T> get(oc::u64 slot, oc::u64 n)
+        {
+            static_assert(std::is_trivially_copyable<T>::value,
+                "scratch buffers hold trivially copyable types only");
+            return oc::span<T>((T*)reserve(slot, n * sizeof(T)), n);
+        }
+
+        // total bytes held by all slots
+        oc::u64 capacity() const;
+
+        // give all the memory back
+        void release();
+
+        // Back future buffers by policy. Existing buffers are released.
+        void setPolicy(const AllocPolicy& policy);
+
+        const AllocPolicy& getPolicy() const { return mPolicy; }
+
+        // resident pages of all slots
+        PageReport pageReport() const;
+    };
+}
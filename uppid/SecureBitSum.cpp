@@ -0,0 +1,119 @@
+#include "SecureBitSum.h"
+#include "libOTe/TwoChooseOne/Silent/SilentOtExtSender.h"
+#include "libOTe/TwoChooseOne/Silent/SilentOtExtReceiver.h"
+
+using namespace std;
+using namespace oc;
+
+namespace uppid
+{
+    static u64 low64(const oc::block& b) { return b.get<u64>()[0]; }
+
+    Proto SecureBitSum::sendProducts(
+        const oc::BitVector& b,
+        oc::u64 wordBits,
+        oc::span<oc::u64> prodShares,
+        Socket& chl)
+    {
+        const u64 n = b.size();
+        const u64 cols = prodShares.size();
+
+        // random OT: (k0, k1) per bit
+        auto msgs = mScratch.get<std::array<oc::block, 2>>(ScratchOtMsgs, n);
+        oc::SilentOtExtSender otSender;
+        otSender.configure(n);
+        co_await otSender.silentSend(msgs, mPrng, chl);
+
+        // d = c ^ b_peer
+        oc::BitVector d(n);
+        co_await chl.recv(d);
+
+        // e = w b + k_{1^d} - k_d. The peer learns k_c + b_peer * e, where 
+        // c = d ^ b_peer, i.e. k_d + w b_peer b. My share of the product is k_d.
+        auto e = mScratch.get<u64>(ScratchE, n);
+        std::fill(prodShares.begin(), prodShares.end(), 0);
+        for (u64 i = 0; i < n; ++i)
+        {
+            auto w = 1ull << (i % wordBits);
+            auto kd = low64(msgs[i][d[i]]);
+            e[i] = (b[i] ? w : 0) + low64(msgs[i][d[i] ^ 1]) - kd;
+            prodShares[(i / wordBits) % cols] += kd;
+        }
+        co_await chl.send(e);
+    }
+
+    Proto SecureBitSum::recvProducts(
+        const oc::BitVector& b,
+        oc::u64 wordBits,
+        oc::span<oc::u64> prodShares,
+        Socket& chl)
+    {
+        const u64 n = b.size();
+        const u64 cols = prodShares.size();
+
+        // random OT: random choice c and k_c per bit
+        oc::BitVector c(n);
+        auto kc = mScratch.get<oc::block>(ScratchKc, n);
+        oc::SilentOtExtReceiver otReceiver;
+        otReceiver.configure(n);
+        co_await otReceiver.silentReceive(c, kc, mPrng, chl);
+
+        c ^= b;
+        co_await chl.send(std::move(c));
+
+        auto e = mScratch.get<u64>(ScratchE, n);
+        co_await chl.recv(e);
+
+        // my share of the product is b * e - k_c
+        std::fill(prodShares.begin(), prodShares.end(), 0);
+        for (u64 i = 0; i < n; ++i)
+            prodShares[(i / wordBits) % cols] += (b[i] ? e[i] : 0) - low64(kc[i]);
+    }
+
+    Proto SecureBitSum::count(
+        oc::u64 partyIdx,
+        const oc::BitVector& bits,
+        oc::u64& sumShare,
+        Socket& chl)
+    {
+        sumShare = 0;
+        if (bits.size() == 0)
+            co_return;
+
+        u64 prodShare;
+        if (partyIdx == 0)
+            co_await sendProducts(bits, 1, { &prodShare, 1 }, chl);
+        else
+            co_await recvProducts(bits, 1, { &prodShare, 1 }, chl);
+
+        sumShare = bits.hammingWeight() - 2 * prodShare;
+    }
+
+    Proto SecureBitSum::sumWords(
+        oc::u64 partyIdx,
+        oc::MatrixView<const oc::u64> words,
+        oc::span<oc::u64> sumShares,
+        Socket& chl)
+    {
+        const u64 cols = words.cols();
+        if (sumShares.size() != cols)
+            throw RTE_LOC;
+        std::fill(sumShares.begin(), sumShares.end(), 0);
+        if (words.size() == 0)
+            co_return;
+
+        oc::BitVector bits((u8*)words.data(), words.size() * 64);
+        std::vector<u64> prodShares(cols);
+        if (partyIdx == 0)
+            co_await sendProducts(bits, 64, prodShares, chl);
+        else
+            co_await recvProducts(bits, 64, prodShares, chl);
+
+        // w0 ^ w1 = w0 + w1 - 2 sum_j 2^j w0_j w1_j
+        for (u64 i = 0; i < words.rows(); ++i)
+            for (u64 j = 0; j < cols; ++j)
+                sumShares[j] += words(i, j);
+        for (u64 j = 0; j < cols; ++j)
+            sumShares[j] -= 2 * prodShares[j];
+    }
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include "volePSI/RsCpsi.h"
+#include "ScratchArena.h"
+
+namespace uppid
+{
+    using Proto = coproto::task<>;
+    using Socket = coproto::Socket;
+
+    // Secure bit count: from XOR shares of bits b, computes additive shares
+    // (mod 2^64) of the number of ones.
+    //
+    // b0 ^ b1 = b0 + b1 - 2 b0 b1. The product is shared with one random OT
+    // per bit, party 0 is the OT sender. Only the sum of the products is
+    // needed, so each party adds up its product shares locally.
+    //
+    // Words are handled bit by bit, w = sum_j 2^j w_j, so the same OT per
+    // bit gives additive shares of sums of XOR-shared integers.
+    class SecureBitSum : public oc::TimerAdapter
+    {
+        oc::PRNG mPrng;
+
+        // per-call buffers, kept across calls
+        enum Scratch : oc::u64
+        {
+            ScratchOtMsgs,
+            ScratchKc,
+            ScratchE,
+            NumScratch
+        };
+        ScratchArena mScratch{ NumScratch };
+
+        // Additive shares of the weighted products b0[i] b1[i] 2^(i % wordBits),
+        // summed per column: bit i belongs to column (i / wordBits) % #columns.
+        Proto sendProducts(const oc::BitVector& b, oc::u64 wordBits, 
+            oc::span<oc::u64> prodShares, Socket& chl);
+        Proto recvProducts(const oc::BitVector& b, oc::u64 wordBits, 
+            oc::span<oc::u64> prodShares, Socket& chl);
+
+    public:
+        void init(oc::block seed = oc::ZeroBlock)
+        {
+            mPrng.SetSeed(seed);
+        }
+
+        void setAllocPolicy(const AllocPolicy& policy)
+        {
+            mScratch.setPolicy(policy);
+        }
+
+        PageReport pageReport() const { return mScratch.pageReport(); }
+
+        /**
+         * input: bits = share of the bits
+         * output: sumShare, sumShare_0 + sumShare_1 = #ones mod 2^64
+         *
+         * partyIdx must differ between the two parties. Both call with the
+         * same number of bits.
+         */
+        Proto count(
+            oc::u64 partyIdx,
+            const oc::BitVector& bits,
+            oc::u64& sumShare,
+            Socket& chl);
+
+        /**
+         * input: words = XOR share of a matrix of integers
+         * output: sumShares[j] = additive share of sum_i words(i, j) mod 2^64
+         *
+         * 64 OTs per word.
+         */
+        Proto sumWords(
+            oc::u64 partyIdx,
+            oc::MatrixView<const oc::u64> words,
+            oc::span<oc::u64> sumShares,
+            Socket& chl);
+    };
+}
@@ -0,0 +1,100 @@
+#include "SecureCompaction.h"
+#include "secure-join/Perm/AltModPerm.h"
+#include "secure-join/Perm/PermCorrelation.h"
+
+#include <cstring> // memcpy
+
+using namespace std;
+using namespace oc;
+using namespace secJoin;
+
+namespace uppid
+{
+    Proto SecureCompaction::shuffle(
+        oc::u64 partyIdx,
+        oc::u64 permIdx,
+        oc::MatrixView<oc::u8> in,
+        oc::MatrixView<oc::u8> out,
+        Socket& chl)
+    {
+        const u64 n = in.rows();
+        const u64 bytes = in.cols();
+
+        secJoin::CorGenerator ole;
+        if (partyIdx == permIdx)
+        {
+            // random permutation, Fisher-Yates
+            std::vector<oc::u32> order(n);
+            for (u64 i = 0; i < n; ++i)
+                order[i] = i;
+            for (u64 i = 0; i + 1 < n; ++i)
+                std::swap(order[i], order[i + mPrng.get<u64>() % (n - i)]);
+            secJoin::Perm perm(order);
+
+            secJoin::PermCorSender permCorSender;
+            secJoin::AltModPermGenSender permGenSender;
+            ole.init(chl.fork(), mPrng, 1, 1, mOteBatchSize, false);
+            permGenSender.init(n, bytes, ole);
+            co_await macoro::when_all_ready(
+                ole.start(),
+                permGenSender.generate(perm, mPrng, chl, permCorSender));
+            co_await permCorSender.apply<u8>(PermOp::Regular, in, out, chl);
+        }
+        else
+        {
+            secJoin::PermCorReceiver permCorReceiver;
+            secJoin::AltModPermGenReceiver permGenReceiver;
+            ole.init(chl.fork(), mPrng, 0, 1, mOteBatchSize, false);
+            permGenReceiver.init(n, bytes, ole);
+            co_await macoro::when_all_ready(
+                ole.start(),
+                permGenReceiver.generate(mPrng, chl, permCorReceiver));
+            co_await permCorReceiver.apply<u8>(PermOp::Regular, in, out, chl);
+        }
+    }
+
+    Proto SecureCompaction::compact(
+        oc::u64 partyIdx,
+        const oc::BitVector& memShares,
+        oc::MatrixView<const oc::u8> datas,
+        oc::Matrix<oc::u8>& compacted,
+        oc::u64& count,
+        Socket& chl)
+    {
+        const u64 n = memShares.size();
+        const u64 bytes = datas.cols();
+        if (datas.rows() != n)
+            throw RTE_LOC;
+
+        count = 0;
+        compacted.resize(0, bytes);
+        if (n == 0)
+            co_return;
+
+        // payload | membership byte
+        oc::Matrix<oc::u8> rows(n, bytes + 1, oc::AllocType::Uninitialized);
+        oc::Matrix<oc::u8> shuffled(n, bytes + 1, oc::AllocType::Uninitialized);
+        for (u64 i = 0; i < n; ++i)
+        {
+            std::memcpy(rows.data(i), datas.data(i), bytes);
+            rows(i, bytes) = memShares[i];
+        }
+
+        co_await shuffle(partyIdx, 0, rows, shuffled, chl);
+        co_await shuffle(partyIdx, 1, shuffled, rows, chl);
+
+        // open the shuffled membership bits
+        oc::BitVector mine(n), theirs(n);
+        for (u64 i = 0; i < n; ++i)
+            mine[i] = rows(i, bytes) & 1;
+        co_await chl.send(mine);
+        co_await chl.recv(theirs);
+        mine ^= theirs;
+
+        count = mine.hammingWeight();
+        compacted.resize(count, bytes, oc::AllocType::Uninitialized);
+        for (u64 i = 0, j = 0; i < n; ++i)
+            if (mine[i])
+                std::memcpy(compacted.data(j++), rows.data(i), bytes);
+    }
+}
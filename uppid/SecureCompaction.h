@@ -0,0 +1,58 @@
+#pragma once
+#include "volePSI/RsCpsi.h"
+
+namespace uppid
+{
+    using Proto = coproto::task<>;
+    using Socket = coproto::Socket;
+
+    // Oblivious compaction of a shared table to its matched rows, i.e. a left
+    // join result turned into an inner join result.
+    //
+    // The rows and their membership bits are shuffled with two P&S passes,
+    // the first under a random permutation of party 0, the second under one
+    // of party 1, so neither party knows the composed order. The membership
+    // bits are then opened and the matched rows kept. The opened bits are a
+    // uniformly random subset of the given size, so both parties learn the
+    // number of matched rows and nothing else; calling compact is the
+    // consent to reveal it.
+    class SecureCompaction : public oc::TimerAdapter
+    {
+        oc::PRNG mPrng;
+        oc::u64 mOteBatchSize = 1ull << 22;
+
+        // in -> out = pi(in) on shares, pi random and known to permIdx only
+        Proto shuffle(
+            oc::u64 partyIdx,
+            oc::u64 permIdx,
+            oc::MatrixView<oc::u8> in,
+            oc::MatrixView<oc::u8> out,
+            Socket& chl);
+
+    public:
+        void init(
+            oc::block seed = oc::ZeroBlock,
+            oc::u64 oteBatchSize = 1ull << 22)
+        {
+            mPrng.SetSeed(seed);
+            mOteBatchSize = oteBatchSize;
+        }
+
+        /**
+         * input: memShares, datas = shares of n rows and their membership
+         * output: compacted = shares of the count rows of datas with
+         *         membership 1, in an order neither party knows
+         *         count = number of matched rows, revealed to both
+         *
+         * partyIdx must differ between the two parties. Both call with the
+         * same number of rows and bytes per row.
+         */
+        Proto compact(
+            oc::u64 partyIdx,
+            const oc::BitVector& memShares,
+            oc::MatrixView<const oc::u8> datas,
+            oc::Matrix<oc::u8>& compacted,
+            oc::u64& count,
+            Socket& chl);
+    };
+}
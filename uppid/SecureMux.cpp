@@ -0,0 +1,108 @@
+#include "SecureMux.h"
+#include "Kernels.h"
+#include "libOTe/TwoChooseOne/Silent/SilentOtExtSender.h"
+#include "libOTe/TwoChooseOne/Silent/SilentOtExtReceiver.h"
+
+using namespace std;
+using namespace oc;
+
+namespace uppid
+{
+    Proto SecureMux::sendHalf(
+        oc::MatrixView<const oc::block> a,
+        oc::span<oc::block> share,
+        oc::PRNG& prng,
+        Socket& chl)
+    {
+        const u64 rows = a.rows();
+        const u64 bpr = a.cols();
+
+        // random OT: (k0, k1) per row
+        auto msgs = mScratch.get<std::array<oc::block, 2>>(ScratchOtMsgs, rows);
+        oc::SilentOtExtSender otSender;
+        otSender.configure(rows);
+        co_await otSender.silentSend(msgs, prng, chl);
+
+        auto K0 = mScratch.get<oc::block>(ScratchK0, rows * bpr);
+        auto K1 = mScratch.get<oc::block>(ScratchK1, rows * bpr);
+        expandRows(&msgs[0][0], 2, rows, bpr, K0.data());
+        expandRows(&msgs[0][1], 2, rows, bpr, K1.data());
+
+        // d = c ^ m, the receiver's derandomization bits
+        oc::BitVector d(rows);
+        co_await chl.recv(d);
+
+        // u = K0 ^ K1 ^ a
+        auto u = mScratch.get<oc::block>(ScratchSendU, rows * bpr);
+        xorBlocks3(u.data(), K0.data(), K1.data(), a.data(), u.size());
+        co_await chl.send(u);
+
+        // my share of m_peer * a_mine is K_d
+        selectRows(d.data(), K0.data(), K1.data(), share.data(), rows, bpr);
+    }
+
+    Proto SecureMux::recvHalf(
+        const oc::BitVector& m,
+        oc::u64 blocksPerRow,
+        oc::span<oc::block> share,
+        oc::PRNG& prng,
+        Socket& chl)
+    {
+        const u64 rows = m.size();
+
+        // random OT: random choice c and k_c per row
+        oc::BitVector c(rows);
+        auto kc = mScratch.get<oc::block>(ScratchKc, rows);
+        oc::SilentOtExtReceiver otReceiver;
+        otReceiver.configure(rows);
+        co_await otReceiver.silentReceive(c, kc, prng, chl);
+
+        c ^= m;
+        co_await chl.send(std::move(c));
+
+        expandRows(kc.data(), 1, rows, blocksPerRow, share.data());
+
+        auto u = mScratch.get<oc::block>(ScratchRecvU, rows * blocksPerRow);
+        co_await chl.recv(u);
+
+        // my share of m_mine * a_peer is K_c ^ m * u
+        maskedXorRows(m.data(), u.data(), share.data(), rows, blocksPerRow);
+    }
+
+    Proto SecureMux::apply(
+        oc::u64 partyIdx,
+        const oc::BitVector& m,
+        oc::MatrixView<oc::block> a,
+        Socket& chl)
+    {
+        const u64 rows = a.rows();
+        const u64 bpr = a.cols();
+        if (m.size() != rows)
+            throw RTE_LOC;
+        if (rows == 0)
+            co_return;
+
+        // Both directions run concurrently. Party 0 sends on the first fork,
+        // party 1 on the second one.
+        auto chl0 = chl.fork();
+        auto chl1 = chl.fork();
+        auto& sendChl = partyIdx ? chl1 : chl0;
+        auto& recvChl = partyIdx ? chl0 : chl1;
+
+        oc::PRNG sendPrng(mPrng.get<oc::block>());
+        oc::PRNG recvPrng(mPrng.get<oc::block>());
+
+        auto sendShare = mScratch.get<oc::block>(ScratchSendShare, rows * bpr);
+        auto recvShare = mScratch.get<oc::block>(ScratchRecvShare, rows * bpr);
+        auto r = co_await macoro::when_all_ready(
+            sendHalf(oc::MatrixView<const oc::block>(a.data(), rows, bpr),
+                sendShare, sendPrng, sendChl),
+            recvHalf(m, bpr, recvShare, recvPrng, recvChl));
+        std::get<0>(r).result();
+        std::get<1>(r).result();
+
+        // local term m_mine * a_mine, plus both cross terms
+        maskRows(m.data(), a.data(), rows, bpr);
+        xorBlocks3(a.data(), a.data(), sendShare.data(), recvShare.data(), rows * bpr);
+    }
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include "volePSI/RsCpsi.h"
+#include "ScratchArena.h"
+
+namespace uppid
+{
+    using Proto = coproto::task<>;
+    using Socket = coproto::Socket;
+
+    // Secure multiplexer: from XOR shares of bits m and of payload rows a,
+    // computes XOR shares of m * a (a row of zeros wherever m = 0).
+    //
+    // m * a = m0 a0 ^ m1 a1 ^ m0 a1 ^ m1 a0. The cross terms are computed with
+    // one random OT per row in each direction, derandomized with one bit from
+    // the receiver and one payload row from the sender.
+    class SecureMux : public oc::TimerAdapter
+    {
+        oc::PRNG mPrng;
+
+        // per-call buffers, kept across calls. The two halves run
+        // concurrently and use disjoint slots.
+        enum Scratch : oc::u64
+        {
+            ScratchOtMsgs,
+            ScratchK0,
+            ScratchK1,
+            ScratchSendU,
+            ScratchSendShare,
+            ScratchKc,
+            ScratchRecvU,
+            ScratchRecvShare,
+            NumScratch
+        };
+        ScratchArena mScratch{ NumScratch };
+
+        // sender of the cross term m_peer * a_mine
+        Proto sendHalf(
+            oc::MatrixView<const oc::block> a,
+            oc::span<oc::block> share,
+            oc::PRNG& prng,
+            Socket& chl);
+
+        // receiver of the cross term m_mine * a_peer
+        Proto recvHalf(
+            const oc::BitVector& m,
+            oc::u64 blocksPerRow,
+            oc::span<oc::block> share,
+            oc::PRNG& prng,
+            Socket& chl);
+
+    public:
+        void init(oc::block seed = oc::ZeroBlock)
+        {
+            mPrng.SetSeed(seed);
+        }
+
+        void setAllocPolicy(const AllocPolicy& policy)
+        {
+            mScratch.setPolicy(policy);
+        }
+
+        PageReport pageReport() const { return mScratch.pageReport(); }
+
+        /**
+         * input: m = share of membership bits, a = share of payload rows
+         * output: a is overwritten with a share of m[i] * a[i]
+         * 
+         * partyIdx must differ between the two parties. Both call with the
+         * same number of rows and blocks per row.
+         */
+        Proto apply(
+            oc::u64 partyIdx,
+            const oc::BitVector& m,
+            oc::MatrixView<oc::block> a,
+            Socket& chl);
+    };
+}
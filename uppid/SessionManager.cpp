@@ -0,0 +1,179 @@
+#include "SessionManager.h"
+#include <coroutine>
+#include <exception>
+
+using namespace std;
+using namespace oc;
+
+namespace uppid
+{
+    SessionManager_P1::SessionManager_P1(
+        oc::u64 dataByteSize,
+        oc::u64 numThreads,
+        oc::block randomSeed,
+        PrfType prfType,
+        oc::u64 oteBatchSize)
+        : mDataByteSize(dataByteSize)
+        , mPrfType(prfType)
+        , mOteBatchSize(oteBatchSize)
+    {
+        mPrng.SetSeed(randomSeed);
+
+        mWork.emplace(mPool.make_work());
+        for (u64 i = 0; i < std::max<u64>(numThreads, 1); ++i)
+            mPool.create_thread();
+    };
+
+    SessionManager_P1::~SessionManager_P1()
+    {
+        {
+            std::unique_lock<std::mutex> lock(mMtx);
+            mDrained.wait(lock, [this] { return mDraining == 0; });
+            mSessions.clear();
+        }
+        // let the pool threads exit, then wait for them
+        mWork.reset();
+        mPool.join();
+    };
+
+    oc::u64 SessionManager_P1::openSession(Socket socket)
+    {
+        auto session = std::make_shared<Session>();
+        socket.setExecutor(mPool);
+        session->mSocket = std::move(socket);
+
+        std::lock_guard<std::mutex> lock(mMtx);
+        session->mDB = std::make_unique<PseudonymisedDB_P1>(
+            mDataByteSize, mPrng.get<oc::block>(), mPrfType, mOteBatchSize);
+
+        auto sessionId = mNextSessionId++;
+        mSessions.emplace(sessionId, std::move(session));
+        return sessionId;
+    };
+
+    void SessionManager_P1::closeSession(oc::u64 sessionId)
+    {
+        std::lock_guard<std::mutex> lock(mMtx);
+        if (mSessions.erase(sessionId) == 0)
+            throw RTE_LOC;
+    };
+
+    oc::u64 SessionManager_P1::numSessions() const
+    {
+        std::lock_guard<std::mutex> lock(mMtx);
+        return mSessions.size();
+    };
+
+    std::shared_ptr<SessionManager_P1::Session>
+        SessionManager_P1::getSession(oc::u64 sessionId) const
+    {
+        std::lock_guard<std::mutex> lock(mMtx);
+        auto iter = mSessions.find(sessionId);
+        if (iter == mSessions.end())
+            throw RTE_LOC;
+        return iter->second;
+    };
+
+    PseudonymisedDB_P1& SessionManager_P1::getDB(oc::u64 sessionId)
+    {
+        return *getSession(sessionId)->mDB;
+    };
+
+    struct SessionManager_P1::Detached
+    {
+        struct promise_type
+        {
+            Detached get_return_object() noexcept { return {}; }
+            std::suspend_never initial_suspend() noexcept { return {}; }
+            std::suspend_never final_suspend() noexcept { return {}; }
+            void return_void() noexcept {}
+            void unhandled_exception() noexcept { std::terminate(); }
+        };
+    };
+
+    std::future<void> SessionManager_P1::submit(oc::u64 sessionId, Op op)
+    {
+        auto session = getSession(sessionId);
+
+        std::promise<void> done;
+        auto f = done.get_future();
+        bool start;
+        {
+            std::lock_guard<std::mutex> lock(session->mMtx);
+            session->mQueue.emplace_back(std::move(op), std::move(done));
+            start = !session->mDraining;
+            session->mDraining = true;
+        }
+
+        if (start)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mMtx);
+                ++mDraining;
+            }
+            drain(std::move(session));
+        }
+        return f;
+    };
+
+    SessionManager_P1::Detached SessionManager_P1::drain(std::shared_ptr<Session> session)
+    {
+        co_await mPool.schedule();
+
+        while (true)
+        {
+            std::pair<Op, std::promise<void>> op;
+            {
+                std::lock_guard<std::mutex> lock(session->mMtx);
+                if (session->mQueue.empty())
+                {
+                    session->mDraining = false;
+                    break;
+                }
+                op = std::move(session->mQueue.front());
+                session->mQueue.pop_front();
+            }
+
+            std::exception_ptr error;
+            try {
+                co_await op.first(*session->mDB, session->mSocket);
+            }
+            catch (...) {
+                error = std::current_exception();
+            }
+
+            if (error)
+                op.second.set_exception(error);
+            else
+                op.second.set_value();
+        }
+
+        std::lock_guard<std::mutex> lock(mMtx);
+        --mDraining;
+        mDrained.notify_all();
+    };
+
+    std::future<void> SessionManager_P1::respondOPRF(oc::u64 sessionId)
+    {
+        return submit(sessionId, [](PseudonymisedDB_P1& db, Socket& chl) {
+            return db.respondOPRF(chl);
+        });
+    };
+
+    std::future<void> SessionManager_P1::insertID(
+        oc::u64 sessionId,
+        oc::span<oc::block> input,
+        oc::MatrixView<oc::u8> inputData)
+    {
+        return submit(sessionId, [input, inputData](PseudonymisedDB_P1& db, Socket& chl) {
+            return db.insertID(input, inputData, chl);
+        });
+    };
+
+    std::future<void> SessionManager_P1::shareUpdate(oc::u64 sessionId)
+    {
+        return submit(sessionId, [](PseudonymisedDB_P1& db, Socket& chl) {
+            return db.shareUpdate_P1(chl);
+        });
+    };
+}
@@ -0,0 +1,103 @@
+#pragma once
+#include "PseudonymisedDB.h"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <unordered_map>
+
+namespace uppid
+{
+    // Serves many concurrent P_0 peers from a single P_1 process.
+    // All sessions share one executor (thread pool), so the total work scales
+    // with the number of cores instead of the number of connected clients.
+    // Each session owns its own PseudonymisedDB_P1 state and socket, and the
+    // operations of one session are serialized.
+    class SessionManager_P1
+    {
+        using Work = decltype(std::declval<macoro::thread_pool&>().make_work());
+
+        using Op = std::function<Proto(PseudonymisedDB_P1&, Socket&)>;
+
+        struct Session
+        {
+            std::unique_ptr<PseudonymisedDB_P1> mDB;
+            Socket mSocket;
+
+            // submitted operations, run in order by one drain at a time
+            std::mutex mMtx;
+            std::deque<std::pair<Op, std::promise<void>>> mQueue;
+            bool mDraining = false;
+        };
+
+        oc::u64 mDataByteSize;
+        PrfType mPrfType;
+        oc::u64 mOteBatchSize;
+
+        // master seed source: every session gets an independent seed
+        oc::PRNG mPrng;
+
+        macoro::thread_pool mPool;
+        std::optional<Work> mWork;
+
+        mutable std::mutex mMtx;
+        oc::u64 mNextSessionId = 0;
+        std::unordered_map<oc::u64, std::shared_ptr<Session>> mSessions;
+
+        // number of sessions with a drain running, waited for on destruction
+        oc::u64 mDraining = 0;
+        std::condition_variable mDrained;
+
+        std::shared_ptr<Session> getSession(oc::u64 sessionId) const;
+
+        std::future<void> submit(oc::u64 sessionId, Op op);
+
+        // coroutine that nobody awaits, its frame frees itself
+        struct Detached;
+
+        // Run the queued operations of session on mPool until the queue is
+        // empty. No thread waits on an operation in the meantime.
+        Detached drain(std::shared_ptr<Session> session);
+
+    public:
+        SessionManager_P1(
+            oc::u64 dataByteSize,
+            oc::u64 numThreads = std::thread::hardware_concurrency(),
+            oc::block randomSeed = oc::ZeroBlock,
+            PrfType prfType = PrfType::AltMod,
+            oc::u64 oteBatchSize = 1ull << 22);
+
+        ~SessionManager_P1();
+
+        SessionManager_P1(const SessionManager_P1&) = delete;
+        SessionManager_P1& operator=(const SessionManager_P1&) = delete;
+
+        // Register a connection to a new P_0 peer. The socket is rebound to
+        // the shared executor. Returns the session id.
+        oc::u64 openSession(Socket socket);
+
+        // Drop the state of a session. Pending operations keep it alive.
+        void closeSession(oc::u64 sessionId);
+
+        oc::u64 numSessions() const;
+
+        PseudonymisedDB_P1& getDB(oc::u64 sessionId);
+
+        macoro::thread_pool& getExecutor() { return mPool; };
+
+        // Each call is queued on its session, runs on the shared executor and
+        // returns immediately. The destructor waits for every queued call.
+        std::future<void> respondOPRF(oc::u64 sessionId);
+
+        std::future<void> insertID(
+            oc::u64 sessionId,
+            oc::span<oc::block> input,
+            oc::MatrixView<oc::u8> inputData);
+
+        std::future<void> shareUpdate(oc::u64 sessionId);
+    };
+}
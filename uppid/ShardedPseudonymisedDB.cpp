@@ -0,0 +1,422 @@
+#include "ShardedPseudonymisedDB.h"
+#include <condition_variable>
+#include <cstring> // memcpy
+#include <mutex>
+#include <numeric>
+
+using namespace std;
+using namespace oc;
+using namespace secJoin;
+
+namespace uppid
+{
+    // Run update(s) for every s in shards[begin, end) concurrently, each on
+    // pool(s).
+    template<typename Fn, typename Pool>
+    static Proto runShards(
+        Fn& update,
+        const std::vector<u64>& shards,
+        u64 begin, u64 end,
+        Pool& pool)
+    {
+        if (end - begin == 0)
+            co_return;
+
+        if (end - begin == 1)
+        {
+            co_await(update(shards[begin]) | macoro::start_on(pool(shards[begin])));
+            co_return;
+        }
+
+        auto mid = begin + (end - begin) / 2;
+        auto r = co_await macoro::when_all_ready(
+            runShards(update, shards, begin, mid, pool),
+            runShards(update, shards, mid, end, pool));
+        std::get<0>(r).result();
+        std::get<1>(r).result();
+    }
+
+    // Exchange (total rows, new rows) of every shard and pick the shards that
+    // have to run. A shard runs if both sides hold rows in it and one side has
+    // something new. If only P_0 holds rows, its new ones cannot match and are
+    // appended as unmatched (shard, rows), so every shard covers its UIDs.
+    // Otherwise the shares are unchanged.
+    static Proto activeShards(
+        const std::vector<u64>& myCounts,
+        bool isP0,
+        std::vector<u64>& active,
+        std::vector<std::pair<u64, u64>>& unmatched,
+        Socket& chl)
+    {
+        std::vector<u64> theirCounts;
+        co_await chl.send(std::vector<u64>(myCounts));
+        co_await chl.recvResize(theirCounts);
+
+        if (theirCounts.size() != myCounts.size())
+            throw RTE_LOC;
+
+        auto& xCounts = isP0 ? myCounts : theirCounts;
+        auto& yCounts = isP0 ? theirCounts : myCounts;
+
+        active.clear();
+        unmatched.clear();
+        for (u64 s = 0; s < myCounts.size() / 2; ++s)
+        {
+            bool bothHaveRows = xCounts[2 * s] && yCounts[2 * s];
+            bool anyNew = xCounts[2 * s + 1] || yCounts[2 * s + 1];
+            if (bothHaveRows && anyNew)
+                active.push_back(s);
+            else if (xCounts[2 * s + 1] && yCounts[2 * s] == 0)
+                unmatched.emplace_back(s, xCounts[2 * s + 1]);
+        }
+    }
+
+    // One pool per NUMA node that gets a shard (shard s goes to node s mod
+    // nodes), its threads pinned to the node. numThreads (0: one per shard)
+    // are split by the shards of each node.
+    static std::vector<std::unique_ptr<ShardNodePool>> makeNodePools(u64 numShards, u64 numThreads)
+    {
+        auto nodes = std::min(numaNodeCount(), numShards);
+        std::vector<std::unique_ptr<ShardNodePool>> pools(nodes);
+        for (u64 n = 0; n < nodes; ++n)
+        {
+            auto& p = *(pools[n] = std::make_unique<ShardNodePool>());
+            u64 shards = (numShards - n + nodes - 1) / nodes;
+            u64 threads = numThreads ? std::max<u64>(1, numThreads * shards / numShards) : shards;
+            p.mWork.emplace(p.mPool.make_work());
+            for (u64 t = 0; t < threads; ++t)
+                p.mPool.create_thread();
+
+            // One task per thread that waits until all of them started, so
+            // every thread of the pool runs exactly one and pins itself.
+            std::mutex mtx;
+            std::condition_variable cv;
+            u64 waiting = threads;
+            auto pin = [&](u64) -> Proto {
+                pinToNode(int(n));
+                std::unique_lock<std::mutex> lock(mtx);
+                if (--waiting == 0)
+                    cv.notify_all();
+                else
+                    cv.wait(lock, [&] { return waiting == 0; });
+                co_return;
+            };
+            auto pool = [&](u64) -> macoro::thread_pool& { return p.mPool; };
+            std::vector<u64> ids(threads);
+            std::iota(ids.begin(), ids.end(), 0);
+            macoro::sync_wait(runShards(pin, ids, 0, threads, pool));
+        }
+        return pools;
+    }
+
+    //////////////////////////////////////////////////////////////////
+    // P_0
+
+    ShardedPseudonymisedDB_P0::ShardedPseudonymisedDB_P0(
+        oc::u64 numShards,
+        oc::u64 dataByteSize,
+        oc::block randomSeed,
+        PrfType prfType,
+        oc::u64 oteBatchSize,
+        oc::u64 numThreads)
+        : mNumThreads(numThreads)
+    {
+        if (numShards == 0)
+            throw RTE_LOC;
+
+        PRNG prng(randomSeed);
+        mDoublePrf.init(prfType, prng.get(), oteBatchSize);
+
+        // shards only store rows and run SSLJ, their own PRF is never used
+        for (u64 s = 0; s < numShards; ++s)
+            mShards.emplace_back(new PseudonymisedDB_P0(
+                dataByteSize, prng.get(), PrfType::AltMod, oteBatchSize));
+        mSharedRows.resize(numShards, 0);
+
+        mWork.emplace(mPool.make_work());
+        for (u64 i = 0; i < (numThreads ? numThreads : numShards); ++i)
+            mPool.create_thread();
+    };
+
+    ShardedPseudonymisedDB_P0::~ShardedPseudonymisedDB_P0()
+    {
+        mWork.reset();
+    };
+
+    void ShardedPseudonymisedDB_P0::route(oc::span<oc::block> UIDs)
+    {
+        auto k = mShards.size();
+        std::vector<std::vector<oc::block>> parts(k);
+
+        mRowShard.reserve(mRowShard.size() + UIDs.size());
+        mRowIdx.reserve(mRowIdx.size() + UIDs.size());
+        for (u64 i = 0; i < UIDs.size(); ++i)
+        {
+            auto s = shardOf(UIDs[i], k);
+            mRowShard.push_back(oc::u32(s));
+            mRowIdx.push_back(mShards[s]->getUID().size() + parts[s].size());
+            parts[s].push_back(UIDs[i]);
+        }
+
+        for (u64 s = 0; s < k; ++s)
+            if (parts[s].size())
+                mShards[s]->DinsertID(parts[s]);
+    };
+
+    Proto ShardedPseudonymisedDB_P0::insertID(
+        oc::span<oc::block> input,
+        Socket& chl)
+    {
+        std::vector<oc::block> updatedUID;
+        co_await mDoublePrf.recv(input, updatedUID, chl);
+        route(updatedUID);
+    };
+
+    void ShardedPseudonymisedDB_P0::DinsertID(
+        oc::span<oc::block> input)
+    {
+        route(input);
+    };
+
+    Proto ShardedPseudonymisedDB_P0::respondOPRF(
+        Socket& chl)
+    {
+        co_await mDoublePrf.send(chl);
+        co_return;
+    };
+
+    Proto ShardedPseudonymisedDB_P0::shareUpdate_P0(Socket& chl)
+    {
+        auto k = mShards.size();
+
+        std::vector<u64> counts(2 * k);
+        for (u64 s = 0; s < k; ++s)
+        {
+            counts[2 * s] = mShards[s]->getUID().size();
+            counts[2 * s + 1] = counts[2 * s] - mSharedRows[s];
+        }
+
+        std::vector<u64> active;
+        std::vector<std::pair<u64, u64>> unmatched;
+        co_await activeShards(counts, true, active, unmatched, chl);
+
+        // fork in shard order so that both parties pair up the same channels
+        std::vector<Socket> subChls(k);
+        for (auto s : active)
+        {
+            subChls[s] = chl.fork();
+            subChls[s].setExecutor(shardPool(s));
+        }
+
+        auto update = [&](u64 s) {
+            return mShards[s]->shareUpdate_P0(subChls[s]);
+        };
+        auto pool = [&](u64 s) -> macoro::thread_pool& { return shardPool(s); };
+        co_await runShards(update, active, 0, active.size(), pool);
+
+        for (auto s : active)
+            mSharedRows[s] = counts[2 * s];
+        for (auto [s, rows] : unmatched)
+        {
+            mShards[s]->appendUnmatched(rows);
+            mSharedRows[s] = counts[2 * s];
+        }
+    };
+
+    //////////////////////////////////////////////////////////////////
+    // P_1
+
+    ShardedPseudonymisedDB_P1::ShardedPseudonymisedDB_P1(
+        oc::u64 numShards,
+        oc::u64 dataByteSize,
+        oc::block randomSeed,
+        PrfType prfType,
+        oc::u64 oteBatchSize,
+        oc::u64 numThreads)
+        : mNumThreads(numThreads)
+    {
+        if (numShards == 0)
+            throw RTE_LOC;
+
+        PRNG prng(randomSeed);
+        mDoublePrf.init(prfType, prng.get(), oteBatchSize);
+
+        for (u64 s = 0; s < numShards; ++s)
+            mShards.emplace_back(new PseudonymisedDB_P1(
+                dataByteSize, prng.get(), PrfType::AltMod, oteBatchSize));
+        mSharedRows.resize(numShards, 0);
+
+        mWork.emplace(mPool.make_work());
+        for (u64 i = 0; i < (numThreads ? numThreads : numShards); ++i)
+            mPool.create_thread();
+    };
+
+    ShardedPseudonymisedDB_P1::~ShardedPseudonymisedDB_P1()
+    {
+        mWork.reset();
+    };
+
+    void ShardedPseudonymisedDB_P1::route(
+        oc::span<oc::block> UIDs,
+        oc::MatrixView<oc::u8> inputData)
+    {
+        if (inputData.rows() != UIDs.size())
+            throw RTE_LOC;
+
+        auto k = mShards.size();
+        auto cols = inputData.cols();
+
+        // first pass: shard of every row and the shard sizes
+        std::vector<u64> sizes(k, 0);
+        std::vector<u32> rowShard(UIDs.size());
+        for (u64 i = 0; i < UIDs.size(); ++i)
+        {
+            rowShard[i] = oc::u32(shardOf(UIDs[i], k));
+            ++sizes[rowShard[i]];
+        }
+
+        std::vector<std::vector<oc::block>> parts(k);
+        std::vector<oc::Matrix<oc::u8>> partData(k);
+        for (u64 s = 0; s < k; ++s)
+        {
+            parts[s].reserve(sizes[s]);
+            partData[s].resize(sizes[s], cols, oc::AllocType::Uninitialized);
+        }
+
+        // second pass: scatter rows and payloads into their shards
+        mRowShard.reserve(mRowShard.size() + UIDs.size());
+        mRowIdx.reserve(mRowIdx.size() + UIDs.size());
+        for (u64 i = 0; i < UIDs.size(); ++i)
+        {
+            auto s = rowShard[i];
+            auto j = parts[s].size();
+            mRowShard.push_back(s);
+            mRowIdx.push_back(mShards[s]->getUID().size() + j);
+            parts[s].push_back(UIDs[i]);
+            std::memcpy(partData[s].data(j), inputData.data(i), cols);
+        }
+
+        for (u64 s = 0; s < k; ++s)
+            if (parts[s].size())
+                mShards[s]->DinsertID(parts[s], partData[s]);
+    };
+
+    Proto ShardedPseudonymisedDB_P1::insertID(
+        oc::span<oc::block> input,
+        oc::MatrixView<oc::u8> inputData,
+        Socket& chl)
+    {
+        std::vector<oc::block> updatedUID;
+        co_await mDoublePrf.recv(input, updatedUID, chl);
+        route(updatedUID, inputData);
+    };
+
+    void ShardedPseudonymisedDB_P1::DinsertID(
+        oc::span<oc::block> input,
+        oc::MatrixView<oc::u8> inputData)
+    {
+        route(input, inputData);
+    };
+
+    Proto ShardedPseudonymisedDB_P1::respondOPRF(
+        Socket& chl)
+    {
+        co_await mDoublePrf.send(chl);
+        co_return;
+    };
+
+    Proto ShardedPseudonymisedDB_P1::shareUpdate_P1(Socket& chl)
+    {
+        auto k = mShards.size();
+
+        std::vector<u64> counts(2 * k);
+        for (u64 s = 0; s < k; ++s)
+        {
+            counts[2 * s] = mShards[s]->getUID().size();
+            counts[2 * s + 1] = counts[2 * s] - mSharedRows[s];
+        }
+
+        std::vector<u64> active;
+        std::vector<std::pair<u64, u64>> unmatched;
+        co_await activeShards(counts, false, active, unmatched, chl);
+
+        std::vector<Socket> subChls(k);
+        for (auto s : active)
+        {
+            subChls[s] = chl.fork();
+            subChls[s].setExecutor(shardPool(s));
+        }
+
+        auto update = [&](u64 s) {
+            return mShards[s]->shareUpdate_P1(subChls[s]);
+        };
+        auto pool = [&](u64 s) -> macoro::thread_pool& { return shardPool(s); };
+        co_await runShards(update, active, 0, active.size(), pool);
+
+        for (auto s : active)
+            mSharedRows[s] = counts[2 * s];
+        for (auto [s, rows] : unmatched)
+        {
+            mShards[s]->appendUnmatched(rows);
+            mSharedRows[s] = counts[2 * s];
+        }
+    };
+
+    macoro::thread_pool& ShardedPseudonymisedDB_P0::shardPool(oc::u64 s)
+    {
+        return mNodePools.empty() ? mPool : mNodePools[s % mNodePools.size()]->mPool;
+    }
+
+    void ShardedPseudonymisedDB_P0::setAllocPolicy(const AllocPolicy& policy, bool perShardNode)
+    {
+        mNodePools.clear();
+        if (perShardNode)
+            mNodePools = makeNodePools(mShards.size(), mNumThreads);
+
+        auto nodes = numaNodeCount();
+        for (u64 s = 0; s < mShards.size(); ++s)
+        {
+            auto shardPolicy = policy;
+            if (perShardNode)
+                shardPolicy.mNumaNode = int(s % nodes);
+            mShards[s]->setAllocPolicy(shardPolicy);
+        }
+    };
+
+    PageReport ShardedPseudonymisedDB_P0::pageReport()
+    {
+        PageReport r;
+        for (auto& shard : mShards)
+            r += shard->pageReport();
+        return r;
+    };
+
+    macoro::thread_pool& ShardedPseudonymisedDB_P1::shardPool(oc::u64 s)
+    {
+        return mNodePools.empty() ? mPool : mNodePools[s % mNodePools.size()]->mPool;
+    }
+
+    void ShardedPseudonymisedDB_P1::setAllocPolicy(const AllocPolicy& policy, bool perShardNode)
+    {
+        mNodePools.clear();
+        if (perShardNode)
+            mNodePools = makeNodePools(mShards.size(), mNumThreads);
+
+        auto nodes = numaNodeCount();
+        for (u64 s = 0; s < mShards.size(); ++s)
+        {
+            auto shardPolicy = policy;
+            if (perShardNode)
+                shardPolicy.mNumaNode = int(s % nodes);
+            mShards[s]->setAllocPolicy(shardPolicy);
+        }
+    };
+
+    PageReport ShardedPseudonymisedDB_P1::pageReport()
+    {
+        PageReport r;
+        for (auto& shard : mShards)
+            r += shard->pageReport();
+        return r;
+    };
+}
@@ -0,0 +1,162 @@
+#pragma once
+#include "PseudonymisedDB.h"
+
+#include <optional>
+
+namespace uppid
+{
+    // Hash-partitioned PseudonymisedDB.
+    // Each UID is routed to one of k shards by a prefix of the pseudonym, and
+    // every shard keeps its own memShare/dataShare segment. shareUpdate runs the
+    // per-shard SSLJs in parallel, each on its own forked channel and thread.
+    // Both parties know the UIDs, so the partition reveals nothing new.
+
+    // Shard of a pseudonym, computed from its top 64 bits.
+    inline oc::u64 shardOf(const oc::block& uid, oc::u64 numShards)
+    {
+        auto prefix = uid.get<oc::u64>()[1];
+        return oc::u64((unsigned __int128)(prefix) * numShards >> 64);
+    }
+
+    // Threads pinned to one NUMA node, running the shards placed there.
+    struct ShardNodePool
+    {
+        macoro::thread_pool mPool;
+        std::optional<decltype(std::declval<macoro::thread_pool&>().make_work())> mWork;
+
+        ~ShardNodePool() { mWork.reset(); }
+    };
+
+    class ShardedPseudonymisedDB_P0 : oc::TimerAdapter
+    {
+        using Work = decltype(std::declval<macoro::thread_pool&>().make_work());
+
+        DoublePrf mDoublePrf;
+        std::vector<std::unique_ptr<PseudonymisedDB_P0>> mShards;
+
+        // row r of the table lives at row mRowIdx[r] of shard mRowShard[r]
+        std::vector<oc::u32> mRowShard;
+        std::vector<oc::u64> mRowIdx;
+
+        // number of rows of each shard already covered by shareUpdate
+        std::vector<oc::u64> mSharedRows;
+
+        macoro::thread_pool mPool;
+        std::optional<Work> mWork;
+        oc::u64 mNumThreads;
+
+        // setAllocPolicy with perShardNode: pool n runs the shards on node n
+        std::vector<std::unique_ptr<ShardNodePool>> mNodePools;
+        macoro::thread_pool& shardPool(oc::u64 s);
+
+        void route(oc::span<oc::block> UIDs);
+
+    public:
+        ShardedPseudonymisedDB_P0(
+            oc::u64 numShards,
+            oc::u64 dataByteSize,
+            oc::block randomSeed = oc::ZeroBlock,
+            PrfType prfType = PrfType::AltMod,
+            oc::u64 oteBatchSize = 1ull << 22,
+            oc::u64 numThreads = 0);
+
+        ~ShardedPseudonymisedDB_P0();
+
+        Proto respondOPRF(Socket& chl);
+
+        Proto insertID(
+            oc::span<oc::block> input,
+            Socket& chl);
+
+        void DinsertID(
+            oc::span<oc::block> input
+        );
+
+        // Update memShare, dataShare of every shard with new rows
+        Proto shareUpdate_P0(Socket& chl);
+
+        oc::u64 numShards() const { return mShards.size(); };
+        oc::u64 size() const { return mRowShard.size(); };
+        PseudonymisedDB_P0& getShard(oc::u64 i) { return *mShards[i]; };
+
+        // Apply policy to every shard. With perShardNode, shard s is placed
+        // on NUMA node s mod numaNodeCount() and updated by threads pinned to
+        // that node, so that concurrent shard updates spread their memory
+        // traffic over all sockets and keep it local. The threads of the
+        // constructor are split over the nodes by their shards.
+        void setAllocPolicy(const AllocPolicy& policy, bool perShardNode = false);
+
+        PageReport pageReport();
+
+        // (shard, row in shard) of the r-th inserted row
+        std::pair<oc::u64, oc::u64> getRowLocation(oc::u64 r) const
+        {
+            return { mRowShard[r], mRowIdx[r] };
+        };
+    };
+
+    class ShardedPseudonymisedDB_P1 : oc::TimerAdapter
+    {
+        using Work = decltype(std::declval<macoro::thread_pool&>().make_work());
+
+        DoublePrf mDoublePrf;
+        std::vector<std::unique_ptr<PseudonymisedDB_P1>> mShards;
+
+        std::vector<oc::u32> mRowShard;
+        std::vector<oc::u64> mRowIdx;
+
+        std::vector<oc::u64> mSharedRows;
+
+        macoro::thread_pool mPool;
+        std::optional<Work> mWork;
+        oc::u64 mNumThreads;
+
+        // setAllocPolicy with perShardNode: pool n runs the shards on node n
+        std::vector<std::unique_ptr<ShardNodePool>> mNodePools;
+        macoro::thread_pool& shardPool(oc::u64 s);
+
+        void route(
+            oc::span<oc::block> UIDs,
+            oc::MatrixView<oc::u8> inputData);
+
+    public:
+        ShardedPseudonymisedDB_P1(
+            oc::u64 numShards,
+            oc::u64 dataByteSize,
+            oc::block randomSeed = oc::ZeroBlock,
+            PrfType prfType = PrfType::AltMod,
+            oc::u64 oteBatchSize = 1ull << 22,
+            oc::u64 numThreads = 0);
+
+        ~ShardedPseudonymisedDB_P1();
+
+        Proto respondOPRF(Socket& chl);
+
+        Proto insertID(
+            oc::span<oc::block> input,
+            oc::MatrixView<oc::u8> inputData,
+            Socket& chl);
+
+        void DinsertID(
+            oc::span<oc::block> input,
+            oc::MatrixView<oc::u8> inputData
+        );
+
+        // Update memShare, dataShare of every shard with new rows
+        Proto shareUpdate_P1(Socket& chl);
+
+        oc::u64 numShards() const { return mShards.size(); };
+        oc::u64 size() const { return mRowShard.size(); };
+        PseudonymisedDB_P1& getShard(oc::u64 i) { return *mShards[i]; };
+
+        // See ShardedPseudonymisedDB_P0::setAllocPolicy.
+        void setAllocPolicy(const AllocPolicy& policy, bool perShardNode = false);
+
+        PageReport pageReport();
+
+        std::pair<oc::u64, oc::u64> getRowLocation(oc::u64 r) const
+        {
+            return { mRowShard[r], mRowIdx[r] };
+        };
+    };
+}
@@ -0,0 +1,324 @@
+#include "ShareExport.h"
+#include "cryptoTools/Crypto/RandomOracle.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+
+using namespace std;
+using namespace oc;
+
+namespace uppid
+{
+    static constexpr u64 Alignment = 64;
+
+    static u64 padded(u64 bytes) { return (bytes + Alignment - 1) / Alignment * Alignment; }
+
+    static u64 checksum(const u8* data, u64 bytes)
+    {
+        oc::RandomOracle ro(sizeof(u64));
+        ro.Update(data, bytes);
+        u64 h;
+        ro.Final(h);
+        return h;
+    }
+
+    static u64 payloadBytes(ShareColumn column, u64 numRows, u64 dataByteSize)
+    {
+        switch (column)
+        {
+        case ShareColumn::Mem: return (numRows + 7) / 8;
+        case ShareColumn::Data: return numRows * dataByteSize;
+        case ShareColumn::Uid: return numRows * sizeof(oc::block);
+        case ShareColumn::Commit: return 0;
+        default: throw RTE_LOC;
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////
+    // reader
+
+    ShareExportReader::ShareExportReader(const std::string& path, bool verify)
+        : mFile(path, MappedFile::Mode::Read)
+    {
+        if (mFile.size() < sizeof(mHeader))
+            throw RTE_LOC;
+        std::memcpy(&mHeader, mFile.data(), sizeof(mHeader));
+        if (std::memcmp(mHeader.mMagic, ShareFileHeader::Magic, sizeof(mHeader.mMagic)) ||
+            mHeader.mVersion != ShareFileHeader::Version)
+            throw RTE_LOC;
+
+        const u64 numColumns = hasUids() ? 3 : 2;
+        std::vector<u64> covered(numColumns, 0);
+        std::vector<Chunk> pending;
+
+        mValidBytes = sizeof(mHeader);
+        u64 pos = sizeof(mHeader);
+        while (pos + sizeof(ShareChunkHeader) <= mFile.size())
+        {
+            ShareChunkHeader h;
+            std::memcpy(&h, mFile.data() + pos, sizeof(h));
+
+            // a cut-off tail ends the file
+            auto start = pos;
+            auto offset = pos + sizeof(h);
+            if (h.mMagic != ShareChunkHeader::Magic || offset + h.mBytes > mFile.size())
+                break;
+
+            if (h.mBytes != payloadBytes(h.mColumn, h.mNumRows, mHeader.mDataByteSize))
+                throw RTE_LOC;
+            if (verify && checksum(mFile.data() + offset, h.mBytes) != h.mChecksum)
+                throw RTE_LOC;
+            pos = offset + padded(h.mBytes);
+
+            if (h.mColumn == ShareColumn::Commit)
+            {
+                // every column holds exactly the rows of the export
+                for (auto c : covered)
+                    if (c != h.mNumRows)
+                        throw RTE_LOC;
+                if (h.mEpoch < mEpoch)
+                    throw RTE_LOC;
+                mChunks.insert(mChunks.end(), pending.begin(), pending.end());
+                pending.clear();
+                mRows = h.mNumRows;
+                mEpoch = h.mEpoch;
+                mValidBytes = pos;
+                continue;
+            }
+
+            // either new rows or rows written again
+            auto col = (u64)h.mColumn;
+            if (col >= numColumns || h.mFirstRow > covered[col])
+                throw RTE_LOC;
+
+            pending.push_back({ h.mColumn, h.mFirstRow, h.mNumRows, h.mEpoch, start, offset, h.mBytes });
+            covered[col] = std::max(covered[col], h.mFirstRow + h.mNumRows);
+        }
+    }
+
+    void ShareExportReader::readMem(oc::BitVector& out, oc::u64 begin) const
+    {
+        out.resize(mRows > begin ? mRows - begin : 0);
+        for (auto& c : mChunks)
+        {
+            auto lo = std::max(begin, c.mFirstRow);
+            auto hi = std::min(mRows, c.mFirstRow + c.mNumRows);
+            if (c.mColumn != ShareColumn::Mem || lo >= hi)
+                continue;
+
+            // later chunks overwrite earlier ones
+            oc::BitVector bits;
+            bits.append((u8*)mFile.data() + c.mOffset, hi - lo, lo - c.mFirstRow);
+            for (u64 i = 0; i < bits.size(); ++i)
+                out[lo - begin + i] = bits[i];
+        }
+    }
+
+    void ShareExportReader::readData(oc::Matrix<oc::u8>& out, oc::u64 begin) const
+    {
+        const u64 cols = dataByteSize();
+        out.resize(mRows > begin ? mRows - begin : 0, cols, oc::AllocType::Uninitialized);
+        for (auto& c : mChunks)
+        {
+            auto lo = std::max(begin, c.mFirstRow);
+            auto hi = std::min(mRows, c.mFirstRow + c.mNumRows);
+            if (c.mColumn == ShareColumn::Data && lo < hi)
+                std::memcpy(out.data(lo - begin),
+                    mFile.data() + c.mOffset + (lo - c.mFirstRow) * cols, (hi - lo) * cols);
+        }
+    }
+
+    void ShareExportReader::readUids(std::vector<oc::block>& out, oc::u64 begin) const
+    {
+        if (!hasUids())
+            throw RTE_LOC;
+
+        out.resize(mRows > begin ? mRows - begin : 0);
+        for (auto& c : mChunks)
+        {
+            auto lo = std::max(begin, c.mFirstRow);
+            auto hi = std::min(mRows, c.mFirstRow + c.mNumRows);
+            if (c.mColumn == ShareColumn::Uid && lo < hi)
+                std::memcpy(out.data() + (lo - begin),
+                    mFile.data() + c.mOffset + (lo - c.mFirstRow) * sizeof(oc::block),
+                    (hi - lo) * sizeof(oc::block));
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////
+    // writer
+
+    ShareExportWriter::ShareExportWriter(
+        const std::string& path,
+        oc::u64 dataByteSize,
+        bool withUids,
+        oc::u64 chunkRows)
+        : mPath(path)
+        , mDataByteSize(dataByteSize)
+        , mWithUids(withUids)
+        , mChunkRows(chunkRows)
+    {
+        if (mChunkRows == 0)
+            throw RTE_LOC;
+
+        u64 validBytes = 0;
+        std::error_code ec;
+        if (std::filesystem::file_size(path, ec) > 0 && !ec)
+        {
+            ShareExportReader reader(path);
+            if (reader.dataByteSize() != dataByteSize || reader.hasUids() != withUids)
+                throw RTE_LOC;
+            mRows = reader.rows();
+            mEpoch = reader.epoch();
+            validBytes = reader.validBytes();
+        }
+
+        mFd = ::open(path.c_str(), O_RDWR | O_CREAT, 0600);
+        if (mFd < 0)
+            throw std::runtime_error("failed to open " + path + ": " + std::strerror(errno));
+
+        if (validBytes == 0)
+        {
+            ShareFileHeader h = {};
+            std::memcpy(h.mMagic, ShareFileHeader::Magic, sizeof(h.mMagic));
+            h.mVersion = ShareFileHeader::Version;
+            h.mFlags = withUids ? ShareFileHeader::HasUids : 0;
+            h.mDataByteSize = dataByteSize;
+            validBytes = sizeof(h);
+
+            if (ftruncate(mFd, 0))
+                throw RTE_LOC;
+            writeAll(&h, sizeof(h));
+        }
+        else
+        {
+            // drop the chunks of an export that did not finish
+            if (ftruncate(mFd, validBytes) || lseek(mFd, validBytes, SEEK_SET) < 0)
+                throw RTE_LOC;
+        }
+    }
+
+    ShareExportWriter::~ShareExportWriter()
+    {
+        if (mFd >= 0)
+            ::close(mFd);
+    }
+
+    void ShareExportWriter::writeAll(const void* data, oc::u64 bytes)
+    {
+        auto p = (const u8*)data;
+        while (bytes)
+        {
+            auto n = ::write(mFd, p, bytes);
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                throw std::runtime_error("failed to write " + mPath + ": " + std::strerror(errno));
+            }
+            p += n;
+            bytes -= n;
+        }
+    }
+
+    void ShareExportWriter::writeChunk(
+        ShareColumn column, oc::u64 firstRow, oc::u64 numRows,
+        oc::u64 epoch, const oc::u8* data, oc::u64 bytes)
+    {
+        static const u8 zeros[Alignment] = {};
+
+        ShareChunkHeader h = {};
+        h.mMagic = ShareChunkHeader::Magic;
+        h.mColumn = column;
+        h.mFirstRow = firstRow;
+        h.mNumRows = numRows;
+        h.mBytes = bytes;
+        h.mChecksum = checksum(data, bytes);
+        h.mEpoch = epoch;
+
+        writeAll(&h, sizeof(h));
+        writeAll(data, bytes);
+        writeAll(zeros, padded(bytes) - bytes);
+    }
+
+    void ShareExportWriter::writeRows(
+        oc::u64 begin, oc::u64 end, oc::u64 epoch,
+        const oc::BitVector& mem, oc::MatrixView<oc::u8> data, oc::span<oc::block> uids)
+    {
+        for (u64 first = begin; first < end; first += mChunkRows)
+        {
+            const u64 n = std::min(mChunkRows, end - first);
+
+            // the first row need not be byte aligned, repack to start at bit 0
+            oc::BitVector bits;
+            bits.append((u8*)mem.data(), n, first);
+            writeChunk(ShareColumn::Mem, first, n, epoch, bits.data(), bits.sizeBytes());
+
+            writeChunk(ShareColumn::Data, first, n, epoch, data.data(first), n * mDataByteSize);
+
+            if (mWithUids)
+                writeChunk(ShareColumn::Uid, first, n, epoch, (const u8*)(uids.data() + first), n * sizeof(oc::block));
+        }
+    }
+
+    oc::u64 ShareExportWriter::append(
+        const oc::BitVector& mem,
+        oc::MatrixView<oc::u8> data,
+        oc::span<oc::block> uids,
+        oc::u64 epoch,
+        oc::u64 rewriteRows)
+    {
+        const u64 end = mem.size();
+        if (end < mRows ||
+            rewriteRows > mRows ||
+            epoch < mEpoch ||
+            data.rows() != end ||
+            data.cols() != mDataByteSize ||
+            (mWithUids && uids.size() != end))
+            throw RTE_LOC;
+
+        auto written = rewriteRows + end - mRows;
+        if (written == 0 && epoch == mEpoch)
+            return 0;
+
+        writeRows(0, rewriteRows, epoch, mem, data, uids);
+        writeRows(mRows, end, epoch, mem, data, uids);
+        writeChunk(ShareColumn::Commit, 0, end, epoch, nullptr, 0);
+
+        mRows = end;
+        mEpoch = epoch;
+        return written;
+    }
+
+    void ShareExportWriter::sync()
+    {
+        if (fdatasync(mFd))
+            throw std::runtime_error("failed to sync " + mPath + ": " + std::strerror(errno));
+    }
+
+    oc::u64 exportShares(PseudonymisedDB_P0& db, ShareExportWriter& w)
+    {
+        oc::span<oc::block> uids;
+        if (w.hasUids() && db.numKeys() != 1)
+            throw RTE_LOC;
+        if (w.hasUids())
+            uids = oc::span<oc::block>(db.getUID().data(), db.getMemShare().size());
+        auto rewrite = db.rewriteEpoch() > w.epoch() ? w.rows() : 0;
+        return w.append(db.getMemShare(), db.getDataShare(), uids, db.updateEpoch(), rewrite);
+    }
+
+    oc::u64 exportShares(PseudonymisedDB_P1& db, ShareExportWriter& w)
+    {
+        // P_1's UIDs are Y, which is not the row order of the shares
+        if (w.hasUids())
+            throw RTE_LOC;
+        auto rewrite = db.rewriteEpoch() > w.epoch() ? w.rows() : 0;
+        return w.append(db.getMemShare(), db.getDataShare(), {}, db.updateEpoch(), rewrite);
+    }
+}
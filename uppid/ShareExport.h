@@ -0,0 +1,178 @@
+#pragma once
+#include "PseudonymisedDB.h"
+#include "MappedFile.h"
+
+#include <string>
+
+namespace uppid
+{
+    // Columnar file of secret-shared rows.
+    //
+    //   file header (64 bytes), then 64-byte aligned chunks:
+    //   chunk header (64 bytes) | payload | zero padding to 64 bytes
+    //
+    // A chunk holds rows [mFirstRow, mFirstRow + mNumRows) of one column:
+    //   Mem     membership shares, bit-packed, bit 0 of byte 0 = first row
+    //   Data    payload shares, dataByteSize bytes per row
+    //   Uid     row UIDs, one block per row (optional)
+    //   Commit  no payload, ends an export: the file holds mNumRows rows,
+    //           the shares of update epoch mEpoch
+    // Every chunk carries the epoch of its export. All integers are
+    // little-endian.
+    //
+    // The file is append-only. An export adds the chunks of the rows that are
+    // new since the previous one, then a Commit chunk; the chunks after the
+    // last Commit belong to an export that did not finish and are ignored.
+    // shareUpdate also changes the shares of rows that were already present
+    // (T xor T^new and the payloads of late matches, or all of them on a
+    // rebuild), so an export after such an update first writes the exported
+    // rows again. A chunk supersedes what earlier chunks hold for its rows.
+    //
+    // Version 1 files had neither Commit chunks nor rewritten rows.
+
+    enum class ShareColumn : oc::u32
+    {
+        Mem = 0,
+        Data = 1,
+        Uid = 2,
+        Commit = 3
+    };
+
+    struct ShareFileHeader
+    {
+        static constexpr char Magic[8] = { 'U', 'P', 'P', 'I', 'D', 'S', 'H', 'R' };
+        static constexpr oc::u32 Version = 2;
+        static constexpr oc::u32 HasUids = 1;
+
+        char mMagic[8];
+        oc::u32 mVersion;
+        oc::u32 mFlags;
+        oc::u64 mDataByteSize;
+        oc::u8 mReserved[40];
+    };
+    static_assert(sizeof(ShareFileHeader) == 64, "header is one cache line");
+
+    struct ShareChunkHeader
+    {
+        static constexpr oc::u32 Magic = 0x4b4e4843; // "CHNK"
+
+        oc::u32 mMagic;
+        ShareColumn mColumn;
+        oc::u64 mFirstRow;
+        oc::u64 mNumRows;
+        oc::u64 mBytes;
+        oc::u64 mChecksum;
+        oc::u64 mEpoch;
+        oc::u8 mReserved[16];
+    };
+    static_assert(sizeof(ShareChunkHeader) == 64, "header is one cache line");
+
+    // mmap-based reader. The chunks of an export that did not finish, e.g.
+    // one cut short by a crash, are ignored.
+    class ShareExportReader
+    {
+    public:
+        struct Chunk
+        {
+            ShareColumn mColumn;
+            oc::u64 mFirstRow;
+            oc::u64 mNumRows;
+            oc::u64 mEpoch;
+            // offset of the chunk header, and of the payload
+            oc::u64 mHeaderOffset;
+            oc::u64 mOffset;
+            oc::u64 mBytes;
+        };
+
+        // With verify, every chunk checksum is checked and a mismatch throws.
+        ShareExportReader(const std::string& path, bool verify = true);
+
+        // number of rows present in every column
+        oc::u64 rows() const { return mRows; }
+
+        // update epoch of the last export
+        oc::u64 epoch() const { return mEpoch; }
+        oc::u64 dataByteSize() const { return mHeader.mDataByteSize; }
+        bool hasUids() const { return mHeader.mFlags & ShareFileHeader::HasUids; }
+
+        // the Mem, Data and Uid chunks of the finished exports, in file order
+        const std::vector<Chunk>& chunks() const { return mChunks; }
+        oc::span<const oc::u8> payload(const Chunk& c) const
+        {
+            return { mFile.data() + c.mOffset, c.mBytes };
+        }
+
+        // file size up to the last export that completed in every column
+        oc::u64 validBytes() const { return mValidBytes; }
+
+        // rows [begin, rows()) of each column, as of the last export
+        void readMem(oc::BitVector& out, oc::u64 begin = 0) const;
+        void readData(oc::Matrix<oc::u8>& out, oc::u64 begin = 0) const;
+        void readUids(std::vector<oc::block>& out, oc::u64 begin = 0) const;
+
+    private:
+        MappedFile mFile;
+        ShareFileHeader mHeader;
+        std::vector<Chunk> mChunks;
+        oc::u64 mRows = 0;
+        oc::u64 mEpoch = 0;
+        oc::u64 mValidBytes = 0;
+    };
+
+    // Appends new rows to a share file. Opening an existing file resumes
+    // after the rows it already holds.
+    class ShareExportWriter
+    {
+        std::string mPath;
+        int mFd = -1;
+        oc::u64 mDataByteSize;
+        bool mWithUids;
+        oc::u64 mChunkRows;
+        oc::u64 mRows = 0;
+        oc::u64 mEpoch = 0;
+
+        void writeAll(const void* data, oc::u64 bytes);
+        void writeChunk(ShareColumn column, oc::u64 firstRow, oc::u64 numRows,
+            oc::u64 epoch, const oc::u8* data, oc::u64 bytes);
+        void writeRows(oc::u64 begin, oc::u64 end, oc::u64 epoch,
+            const oc::BitVector& mem, oc::MatrixView<oc::u8> data, oc::span<oc::block> uids);
+
+    public:
+        ShareExportWriter(
+            const std::string& path,
+            oc::u64 dataByteSize,
+            bool withUids = false,
+            oc::u64 chunkRows = 1ull << 20);
+        ~ShareExportWriter();
+
+        ShareExportWriter(const ShareExportWriter&) = delete;
+        ShareExportWriter& operator=(const ShareExportWriter&) = delete;
+
+        // rows already in the file, and the update epoch of their shares
+        oc::u64 rows() const { return mRows; }
+        oc::u64 epoch() const { return mEpoch; }
+        bool hasUids() const { return mWithUids; }
+
+        // One export of the shares of update epoch: rows [0, rewriteRows)
+        // again, superseding what the file holds for them, then the new rows
+        // [rows(), mem.size()). uids is only read if hasUids(). Returns the
+        // number of rows written.
+        oc::u64 append(
+            const oc::BitVector& mem,
+            oc::MatrixView<oc::u8> data,
+            oc::span<oc::block> uids = {},
+            oc::u64 epoch = 0,
+            oc::u64 rewriteRows = 0);
+
+        // wait until everything written so far is on disk
+        void sync();
+    };
+
+    // Export the rows of db added since the last export to w, and the rows
+    // exported before if an update changed them since (see
+    // PseudonymisedDB_P0::rewriteEpoch). The UIDs (P_0 only, the shares are
+    // in the row order of X, one identifier per row) are written if w has
+    // the Uid column.
+    oc::u64 exportShares(PseudonymisedDB_P0& db, ShareExportWriter& w);
+    oc::u64 exportShares(PseudonymisedDB_P1& db, ShareExportWriter& w);
+}
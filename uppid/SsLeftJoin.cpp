@@ -1,6 +1,10 @@
 #include "SsLeftJoin.h"
 #include "secure-join/Perm/AltModPerm.h"
 #include "secure-join/Perm/PermCorrelation.h"
+#include "Kernels.h"
+#include "cryptoTools/Common/CuckooIndex.h"
+
+#include <utility> // std::exchange
 
 using namespace std;
 using namespace oc;
@@ -11,6 +15,12 @@ namespace uppid
 {
 
     const bool debugCorrectness = false;
+
+    oc::u64 SsLeftJoinBase::tableRows(oc::u64 receiverSize)
+    {
+        // the cuckoo table RsCpsi builds, 3 hashes and 40 bits of statistical security
+        return oc::CuckooIndex<>::selectParams(std::max<oc::u64>(receiverSize, 1), 40, 0, 3).numBins();
+    }
     
 
     struct BlockHash {
@@ -29,6 +39,88 @@ namespace uppid
     };
     
 
+    // P&S of the CPSI flag bits. The first numRows bits of the permuted
+    // column are written to aligned.
+    template<typename PermCor>
+    static Proto permuteFlags(
+        PermCor& permCor,
+        const oc::BitVector& flags,
+        u64 numRows,
+        ScratchArena& scratch,
+        oc::BitVector& aligned,
+        Socket& chl)
+    {
+        const u64 cpsiSize = flags.size();
+
+        oc::MatrixView<oc::u8> memSharesU8(
+            scratch.get<oc::u8>(SsLeftJoinBase::ScratchMemIn, cpsiSize).data(), cpsiSize, 1);
+        unpackBits(flags.data(), memSharesU8.data(), cpsiSize);
+
+        oc::MatrixView<oc::u8> memSharesU8Aligned(
+            scratch.get<oc::u8>(SsLeftJoinBase::ScratchMemOut, cpsiSize).data(), cpsiSize, 1);
+        co_await permCor.template apply<oc::u8>(
+            PermOp::Regular, memSharesU8, memSharesU8Aligned, chl);
+
+        // Compact the tables by dropping the dummy rows.
+        aligned.resize(numRows);
+        packBits(memSharesU8Aligned.data(), aligned.data(), numRows);
+    }
+
+    // make permutation pi
+    std::vector<oc::u32>& SsLeftJoinReceiver::inputOrder(
+        const volePSI::RsCpsiReceiver::Sharing& cpsi,
+        oc::u64 numInputs)
+    {
+        const u64 cpsiSize = cpsi.mFlagBits.size();
+        auto& inputToShareIdx = mInputToShareIdx;
+        inputToShareIdx.resize(cpsiSize);
+        auto used = mScratch.get<uint8_t>(ScratchUsed, cpsiSize);
+        std::memset(used.data(), 0, used.size());
+
+        // CPSI make injective function, idx: X -> |M|, idx(x) -> i (secret share table index)
+        // we want to permutation pi operated, pi(idx(x_i)) = i
+        // we store idx(x_i) for each i and mark which CPSI table indices are used.
+        for (size_t i = 0; i < numInputs; i++) {
+            inputToShareIdx[i] = cpsi.mMapping[i];
+            used[inputToShareIdx[i]] = 1;
+        }
+
+        // Place unused indices in the positions beyond |X|.
+        size_t out = numInputs;
+        for (oc::u32 i = 0; i < cpsiSize; ++i) {
+            if (!used[i]) {
+                inputToShareIdx[out++] = i;
+                if (out == cpsiSize) break;
+            }
+        }
+
+        return inputToShareIdx;
+    }
+
+    // The peer's set size, sent before the CPSI unless setPeerSize gave it.
+    static Proto exchangeSize(
+        SsLeftJoinBase& base,
+        oc::u64 mySize,
+        bool sendFirst,
+        oc::u64& peerSize,
+        Socket& chl)
+    {
+        peerSize = std::exchange(base.mPeerSize, SsLeftJoinBase::UnknownSize);
+        if (peerSize != SsLeftJoinBase::UnknownSize)
+            co_return;
+
+        if (sendFirst)
+        {
+            co_await chl.send(mySize);
+            co_await chl.recv(peerSize);
+        }
+        else
+        {
+            co_await chl.recv(peerSize);
+            co_await chl.send(mySize);
+        }
+    }
+
     Proto SsLeftJoinSender::send(
         oc::span<oc::block> Y,
         oc::MatrixView<oc::u8> datas,
@@ -37,8 +129,7 @@ namespace uppid
         Socket& chl)
     {
         u64 receiverSize;
-        co_await chl.send(Y.size());
-        co_await chl.recv(receiverSize);
+        co_await exchangeSize(*this, Y.size(), true, receiverSize, chl);
 
         // Invoke CPSI
         volePSI::RsCpsiSender cpsiSender;
@@ -70,36 +161,29 @@ namespace uppid
             permGenReceiver.generate(mPrng, chl, permCorReceiver)
         );
 
-        valueShares.resize(cpsiSize, mDataByteSize, oc::AllocType::Uninitialized);
+        // The outputs are appended: P&S writes straight into the destination
+        // rows of valueShares, the dummy rows past |X| are dropped afterwards.
+        const u64 rowOffset = valueShares.rows();
+        if (rowOffset && valueShares.cols() != mDataByteSize)
+            throw RTE_LOC;
+        valueShares.resize(rowOffset + cpsiSize, mDataByteSize, oc::AllocType::Uninitialized);
 
         // invoke P&S with payload
         co_await permCorReceiver.apply<u8>(
-            PermOp::Regular, cpsiResults.mValues, valueShares, chl);
-
-        oc::Matrix<oc::u8> memSharesU8(cpsiSize, 1, oc::AllocType::Uninitialized);
-        for (oc::u64 i = 0; i < cpsiSize; ++i) {
-            memSharesU8(i, 0) = static_cast<oc::u8>(cpsiResults.mFlagBits[i]);
-        }
-
-        oc::Matrix<oc::u8> memSharesU8Aligned(
-            cpsiSize, 1, oc::AllocType::Uninitialized);
-        // invoke P&S with membership bit
-        co_await permCorReceiver.apply<oc::u8>(
-            PermOp::Regular, memSharesU8, memSharesU8Aligned, chl);
-
-        memShares.resize(cpsiSize);
-        for (oc::u64 i = 0; i < cpsiSize; ++i) {
-            memShares[i] = (memSharesU8Aligned(i, 0) & 1);
-        }
+            PermOp::Regular, cpsiResults.mValues, 
+            oc::MatrixView<oc::u8>(valueShares.data(rowOffset), cpsiSize, mDataByteSize), chl);
 
-        // Compact the tables by dropping the dummy rows and keeping only the |X| meaningful rows.
-        memShares.resize(receiverSize);
-        valueShares.resize(receiverSize, mDataByteSize);
+        // invoke P&S with membership bit, keeping only the |X| meaningful rows
+        oc::BitVector alignedMemShares;
+        co_await permuteFlags(permCorReceiver, cpsiResults.mFlagBits, receiverSize, 
+            mScratch, alignedMemShares, chl);
+        memShares.append(alignedMemShares);
+        valueShares.resize(rowOffset + receiverSize, mDataByteSize);
 
         if (debugCorrectness) {
             // After P&S (alignment/resize completed), send the sender's memShares to the receiver.
-            std::cout << "sender sended data size is " << memShares.size() << '\n';
-            co_await chl.send(memShares);
+            std::cout << "sender sended data size is " << alignedMemShares.size() << '\n';
+            co_await chl.send(alignedMemShares);
         }
 
     };
@@ -112,8 +196,7 @@ namespace uppid
     {
 
         oc::u64 senderSize;
-        co_await chl.recv(senderSize);
-        co_await chl.send(X.size());
+        co_await exchangeSize(*this, X.size(), false, senderSize, chl);
 
         // Invoke CPSI
         volePSI::RsCpsiReceiver cpsiReceiver;
@@ -169,28 +252,7 @@ namespace uppid
 
         }
 
-        //make permutation pi
-        std::vector<oc::u32> inputToShareIdx(cpsiSize);
-        std::vector<uint8_t> used(cpsiSize, 0);
-
-        // CPSI make injective function, idx: X -> |M|, idx(x) -> i (secret share table index)
-        // we want to permutation pi operated, pi(idx(x_i)) = i
-        // we store idx(x_i) for each i and mark which CPSI table indices are used.
-        for (size_t i = 0; i < X.size(); i++) {
-            inputToShareIdx[i] = cpsiResults.mMapping[i];
-            used[inputToShareIdx[i]] = 1;
-        }
-
-        // Place unused indices in the positions beyond |X|.
-        size_t out = X.size();
-        for (oc::u32 i = 0; i < cpsiSize; ++i) {
-            if (!used[i]) {
-                inputToShareIdx[out++] = i;
-                if (out == cpsiSize) break;
-            }
-        }
-            
-        secJoin::Perm perm(inputToShareIdx);
+        secJoin::Perm perm(inputOrder(cpsiResults, X.size()));
 
         secJoin::PermCorSender permCorSender;
         secJoin::AltModPermGenSender permGenSender;
@@ -205,29 +267,22 @@ namespace uppid
             permGenSender.generate(perm, mPrng, chl, permCorSender)
         );
 
-        valueShares.resize(cpsiSize, mDataByteSize, oc::AllocType::Uninitialized);
+        const u64 rowOffset = valueShares.rows();
+        if (rowOffset && valueShares.cols() != mDataByteSize)
+            throw RTE_LOC;
+        valueShares.resize(rowOffset + cpsiSize, mDataByteSize, oc::AllocType::Uninitialized);
 
         // invoke P&S with payload
         co_await permCorSender.apply<u8>(
-            PermOp::Regular, cpsiResults.mValues, valueShares, chl);
-
-        oc::Matrix<oc::u8> memSharesU8(cpsiSize, 1, oc::AllocType::Uninitialized);
-        for (oc::u64 i = 0; i < cpsiSize; ++i)
-            memSharesU8(i, 0) = static_cast<oc::u8>(cpsiResults.mFlagBits[i]);
-
-        oc::Matrix<oc::u8> memSharesU8Aligned(
-            cpsiSize, 1, oc::AllocType::Uninitialized);
-        // invoke P&S with membership bit
-        co_await permCorSender.apply<oc::u8>(
-            PermOp::Regular, memSharesU8, memSharesU8Aligned, chl);
-
-        memShares.resize(cpsiSize);
-        for (oc::u64 i = 0; i < cpsiSize; ++i)
-            memShares[i] = (memSharesU8Aligned(i, 0) & 1);
-
-        // Compact the tables by dropping the dummy rows and keeping only the |X| meaningful rows.
-        memShares.resize(X.size());
-        valueShares.resize(X.size(), mDataByteSize);
+            PermOp::Regular, cpsiResults.mValues, 
+            oc::MatrixView<oc::u8>(valueShares.data(rowOffset), cpsiSize, mDataByteSize), chl);
+
+        // invoke P&S with membership bit, keeping only the |X| meaningful rows
+        oc::BitVector alignedMemShares;
+        co_await permuteFlags(permCorSender, cpsiResults.mFlagBits, X.size(), 
+            mScratch, alignedMemShares, chl);
+        memShares.append(alignedMemShares);
+        valueShares.resize(rowOffset + X.size(), mDataByteSize);
         
         // debug
         if (debugCorrectness) {
@@ -238,10 +293,10 @@ namespace uppid
             co_await chl.recv(senderAlignedShare);
             // std::cout << "Receiver Sender membership bit\n";
 
-            if (senderAlignedShare.size() != X.size() || memShares.size() != X.size()) {
+            if (senderAlignedShare.size() != X.size() || alignedMemShares.size() != X.size()) {
                 std::cout << "[DEBUG][P&S] size mismatch: senderAlignedShare.size()="
                         << senderAlignedShare.size()
-                        << " memShares.size()=" << memShares.size()
+                        << " alignedMemShares.size()=" << alignedMemShares.size()
                         << " X.size()=" << X.size() << "\n";
             }
 
@@ -249,7 +304,7 @@ namespace uppid
             size_t mismPSvsCpsi = 0;
 
             for (u64 i = 0; i < X.size(); ++i) {
-                bool openedPS = (senderAlignedShare[i] ^ memShares[i]);
+                bool openedPS = (senderAlignedShare[i] ^ alignedMemShares[i]);
                 bool expected = (ySet.find(X[i]) != ySet.end());
 
                 if (openedPS != expected) {
@@ -278,4 +333,82 @@ namespace uppid
         }
 
     }
-}
\ No newline at end of file
+
+    Proto SsLeftJoinSender::sendMembership(
+        oc::span<oc::block> Y,
+        oc::BitVector& memShares,
+        bool aligned,
+        Socket& chl)
+    {
+        u64 receiverSize;
+        co_await exchangeSize(*this, Y.size(), true, receiverSize, chl);
+
+        // CPSI without values
+        volePSI::RsCpsiSender cpsiSender;
+        cpsiSender.init(Y.size(), receiverSize, 0, 40, mPrng.get(), 1, ValueShareType::Xor);
+        RsCpsiSender::Sharing cpsiResults;
+        oc::Matrix<oc::u8> noValues(Y.size(), 0);
+        co_await cpsiSender.send(Y, noValues, cpsiResults, chl);
+
+        if (!aligned) {
+            memShares.append(cpsiResults.mFlagBits);
+            co_return;
+        }
+
+        u64 cpsiSize = cpsiResults.mFlagBits.size();
+        secJoin::PermCorReceiver permCorReceiver;
+        secJoin::AltModPermGenReceiver permGenReceiver;
+        secJoin::CorGenerator ole;
+        ole.init(chl.fork(), mPrng, 0, 1, mOteBatchSize, false);
+        permGenReceiver.init(cpsiSize, 1, ole);
+
+        co_await macoro::when_all_ready(
+            ole.start(),
+            permGenReceiver.generate(mPrng, chl, permCorReceiver)
+        );
+
+        oc::BitVector alignedMemShares;
+        co_await permuteFlags(permCorReceiver, cpsiResults.mFlagBits, receiverSize, 
+            mScratch, alignedMemShares, chl);
+        memShares.append(alignedMemShares);
+    }
+
+    Proto SsLeftJoinReceiver::recvMembership(
+        oc::span<oc::block> X,
+        oc::BitVector& memShares,
+        bool aligned,
+        Socket& chl)
+    {
+        oc::u64 senderSize;
+        co_await exchangeSize(*this, X.size(), false, senderSize, chl);
+
+        volePSI::RsCpsiReceiver cpsiReceiver;
+        cpsiReceiver.init(senderSize, X.size(), 0, 40, mPrng.get(), 1, ValueShareType::Xor);
+        RsCpsiReceiver::Sharing cpsiResults;
+        co_await cpsiReceiver.receive(X, cpsiResults, chl);
+
+        if (!aligned) {
+            memShares.append(cpsiResults.mFlagBits);
+            co_return;
+        }
+
+        u64 cpsiSize = cpsiResults.mFlagBits.size();
+        secJoin::Perm perm(inputOrder(cpsiResults, X.size()));
+
+        secJoin::PermCorSender permCorSender;
+        secJoin::AltModPermGenSender permGenSender;
+        secJoin::CorGenerator ole;
+        ole.init(chl.fork(), mPrng, 1, 1, mOteBatchSize, false);
+        permGenSender.init(cpsiSize, 1, ole);
+
+        co_await macoro::when_all_ready(
+            ole.start(),
+            permGenSender.generate(perm, mPrng, chl, permCorSender)
+        );
+
+        oc::BitVector alignedMemShares;
+        co_await permuteFlags(permCorSender, cpsiResults.mFlagBits, X.size(), 
+            mScratch, alignedMemShares, chl);
+        memShares.append(alignedMemShares);
+    }
+}
@@ -1,5 +1,6 @@
 #pragma once
 #include "volePSI/RsCpsi.h"
+#include "ScratchArena.h"
 
 namespace uppid
 {
@@ -12,6 +13,21 @@ namespace uppid
         oc::PRNG mPrng;
         oc::u64 mDataByteSize;
 
+        // per-call buffers, kept across calls
+        enum Scratch : oc::u64
+        {
+            ScratchUsed,
+            ScratchMemIn,
+            ScratchMemOut,
+            NumScratch
+        };
+        ScratchArena mScratch{ NumScratch };
+        std::vector<oc::u32> mInputToShareIdx;
+
+        // the peer's set size, if an earlier message carried it
+        static constexpr oc::u64 UnknownSize = ~0ull;
+        oc::u64 mPeerSize = UnknownSize;
+
         void init(
             oc::u64 dataByteSize,
             oc::block seed = oc::ZeroBlock,
@@ -21,6 +37,25 @@ namespace uppid
             mPrng.SetSeed(seed);
             mOteBatchSize = oteBatchSize;
         }
+
+        // back the per-call buffers by policy (huge pages, NUMA node)
+        void setAllocPolicy(const AllocPolicy& policy)
+        {
+            mScratch.setPolicy(policy);
+        }
+
+        // The next call skips the set size exchange and takes size as the
+        // peer's. For callers that sent the sizes along with their own
+        // messages already (WAN mode); both parties must set it.
+        void setPeerSize(oc::u64 size)
+        {
+            mPeerSize = size;
+        }
+
+        // Rows send / recv append before the dummy rows past |X| are
+        // dropped again: the CPSI table size for a receiver set of
+        // receiverSize. Reserving them keeps the output from moving.
+        static oc::u64 tableRows(oc::u64 receiverSize);
         
     };
     
@@ -35,6 +70,8 @@ namespace uppid
          * 
          * Caution: No guarantee for sharings[i] when x[i] notin Y
          * In particular, NOT a share of zero
+         * 
+         * The |X| output rows are appended to memShares and sharings.
          */
         Proto send(
             oc::span<oc::block> Y,
@@ -42,10 +79,30 @@ namespace uppid
             oc::BitVector& memShares,
             oc::Matrix<oc::u8>& sharings,
             Socket& chl);
+
+        /**
+         * Membership only: the CPSI runs without payload and only the flag
+         * bits are permuted.
+         * - aligned:  memShares[i] = (x[i] in Y), |X| rows appended
+         * - !aligned: the CPSI table flags are appended as they are, one
+         *             row per table bin in an order neither party knows.
+         *             They hold |X cap Y| ones, enough for counting, and
+         *             skip the permutation altogether.
+         */
+        Proto sendMembership(
+            oc::span<oc::block> Y,
+            oc::BitVector& memShares,
+            bool aligned,
+            Socket& chl);
     };
 
     class SsLeftJoinReceiver : public SsLeftJoinBase, oc::TimerAdapter
     {
+        // mInputToShareIdx: the CPSI bin of each x[i], then the unused bins
+        std::vector<oc::u32>& inputOrder(
+            const volePSI::RsCpsiReceiver::Sharing& cpsi,
+            oc::u64 numInputs);
+
     public:
         /**
          * input: X = [x[i]]
@@ -55,12 +112,21 @@ namespace uppid
          * 
          * Caution: No guarantee for sharings[i] when x[i] notin Y
          * In particular, NOT a share of zero
+         * 
+         * The |X| output rows are appended to memShares and sharings.
          */
         Proto recv(
             oc::span<oc::block> X,
             oc::BitVector& memShares,
             oc::Matrix<oc::u8>& sharings,
             Socket& chl);
+
+        // See SsLeftJoinSender::sendMembership.
+        Proto recvMembership(
+            oc::span<oc::block> X,
+            oc::BitVector& memShares,
+            bool aligned,
+            Socket& chl);
     };
 
 }
\ No newline at end of file
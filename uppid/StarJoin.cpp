@@ -0,0 +1,75 @@
+#include "StarJoin.h"
+
+using namespace std;
+using namespace oc;
+
+namespace uppid
+{
+    StarJoin_P0::StarJoin_P0(
+        oc::u64 dataByteSize,
+        oc::block randomSeed,
+        PrfType prfType,
+        oc::u64 oteBatchSize)
+        : mPrfType(prfType)
+    {
+        mDoublePrf.init(prfType, randomSeed, oteBatchSize);
+        mSsljReceiver.init(dataByteSize, oc::mAesFixedKey.hashBlock(randomSeed), oteBatchSize);
+    }
+
+    void StarJoin_P0::setInput(oc::span<const oc::block> X)
+    {
+        mInput.assign(X.begin(), X.end());
+        mProviders.clear();
+
+        // my key is the same for every provider
+        mLocalPrf.resize(0);
+        if (mPrfType == PrfType::AltMod)
+        {
+            mLocalPrf.resize(mInput.size());
+            mDoublePrf.evalLocal(mInput, mLocalPrf);
+        }
+    }
+
+    Proto StarJoin_P0::join(oc::u64& provider, Socket& chl)
+    {
+        Provider p;
+
+        // UID_k(X) with the precomputed half, then the provider's UID_k(Y_k)
+        co_await mDoublePrf.recv(mInput, mLocalPrf, p.mUID, chl);
+        co_await mDoublePrf.send(chl);
+
+        p.mDataShare.resize(0, mSsljReceiver.mDataByteSize);
+        co_await mSsljReceiver.recv(p.mUID, p.mMemShare, p.mDataShare, chl);
+
+        provider = mProviders.size();
+        mProviders.push_back(std::move(p));
+    }
+
+    StarJoin_P1::StarJoin_P1(
+        oc::u64 dataByteSize,
+        oc::block randomSeed,
+        PrfType prfType,
+        oc::u64 oteBatchSize)
+    {
+        mDoublePrf.init(prfType, randomSeed, oteBatchSize);
+        mSsljSender.init(dataByteSize, oc::mAesFixedKey.hashBlock(randomSeed), oteBatchSize);
+        dataShare.resize(0, dataByteSize);
+    }
+
+    Proto StarJoin_P1::join(
+        oc::span<oc::block> Y,
+        oc::MatrixView<oc::u8> datas,
+        Socket& chl)
+    {
+        if (datas.rows() != Y.size() || datas.cols() != mSsljSender.mDataByteSize)
+            throw RTE_LOC;
+
+        co_await mDoublePrf.send(chl);
+        UID.clear();
+        co_await mDoublePrf.recv(Y, UID, chl);
+
+        memShare.resize(0);
+        dataShare.resize(0, dataShare.cols());
+        co_await mSsljSender.send(UID, datas, memShare, dataShare, chl);
+    }
+}
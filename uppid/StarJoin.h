@@ -0,0 +1,101 @@
+#pragma once
+#include "DoublePrf.h"
+#include "SsLeftJoin.h"
+
+namespace uppid
+{
+    // Star join: one identifier set X of P_0 left-joined with the tables of
+    // several providers, each in the role of P_1. Per provider k:
+    //
+    //   UID_k(x) = F_k0(x) ^ F_kk(x)    double PRF with that provider's key
+    //   SSLJ (UID_k(X), UID_k(Y_k))     P_0 receiver, provider sender
+    //
+    // F_k0(X), my half of every provider's double PRF, is evaluated once in
+    // setInput and reused. The CPSI hashing, the mapping and the permutation
+    // depend on UID_k(X), which differ per provider by design (the UIDs of
+    // two providers are unlinkable), and the permutation correlations are
+    // tied to the provider they were generated with; the one receiver keeps
+    // their buffers across providers instead.
+    //
+    // The results of all providers are in the row order of X.
+    class StarJoin_P0 : public oc::TimerAdapter
+    {
+        PrfType mPrfType;
+        DoublePrf mDoublePrf;
+        SsLeftJoinReceiver mSsljReceiver;
+
+        // X, and F_k0(X) (AltMod only, empty for DDH)
+        std::vector<oc::block> mInput;
+        std::vector<oc::block> mLocalPrf;
+
+        struct Provider
+        {
+            std::vector<oc::block> mUID;
+            oc::BitVector mMemShare;
+            oc::Matrix<oc::u8> mDataShare;
+        };
+        std::vector<Provider> mProviders;
+
+    public:
+        StarJoin_P0(
+            oc::u64 dataByteSize,
+            oc::block randomSeed = oc::ZeroBlock,
+            PrfType prfType = PrfType::AltMod,
+            oc::u64 oteBatchSize = 1ull << 22);
+
+        // Set X, and evaluate my half of the double PRF on it. Drops the
+        // results of earlier providers.
+        void setInput(oc::span<const oc::block> X);
+
+        // Left join X with the next provider, who runs StarJoin_P1::join on
+        // the other end of chl. provider is the index of its results.
+        Proto join(oc::u64& provider, Socket& chl);
+
+        oc::u64 numProviders() const { return mProviders.size(); }
+
+        std::vector<oc::block>&  getUID(oc::u64 provider) {return mProviders.at(provider).mUID;};
+        oc::BitVector&           getMemShare(oc::u64 provider) {return mProviders.at(provider).mMemShare;};
+        oc::Matrix<oc::u8>&      getDataShare(oc::u64 provider) {return mProviders.at(provider).mDataShare;};
+
+        void setAllocPolicy(const AllocPolicy& policy)
+        {
+            mDoublePrf.setAllocPolicy(policy);
+            mSsljReceiver.setAllocPolicy(policy);
+        }
+    };
+
+    // A provider of the star join.
+    class StarJoin_P1 : public oc::TimerAdapter
+    {
+        DoublePrf mDoublePrf;
+        SsLeftJoinSender mSsljSender;
+
+        std::vector<oc::block> UID;
+        oc::BitVector memShare;
+        oc::Matrix<oc::u8> dataShare;
+
+    public:
+        StarJoin_P1(
+            oc::u64 dataByteSize,
+            oc::block randomSeed = oc::ZeroBlock,
+            PrfType prfType = PrfType::AltMod,
+            oc::u64 oteBatchSize = 1ull << 22);
+
+        // My side of StarJoin_P0::join: Y with one payload row per
+        // identifier. memShare / dataShare get |X| rows, in the order of X.
+        Proto join(
+            oc::span<oc::block> Y,
+            oc::MatrixView<oc::u8> datas,
+            Socket& chl);
+
+        std::vector<oc::block>&  getUID() {return UID;};
+        oc::BitVector&           getMemShare() {return memShare;};
+        oc::Matrix<oc::u8>&      getDataShare() {return dataShare;};
+
+        void setAllocPolicy(const AllocPolicy& policy)
+        {
+            mDoublePrf.setAllocPolicy(policy);
+            mSsljSender.setAllocPolicy(policy);
+        }
+    };
+}
@@ -0,0 +1,172 @@
+#include "Transcript.h"
+#include "MappedFile.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+
+using namespace std;
+using namespace oc;
+
+namespace uppid
+{
+    using Result = std::pair<std::error_code, oc::u64>;
+
+    static void countSend(TranscriptStats& stats, u64 bytes)
+    {
+        if (!stats.mInFlight)
+            ++stats.mFlights;
+        stats.mInFlight = true;
+        stats.mBytesSent += bytes;
+    }
+
+    static void countRecv(TranscriptStats& stats, u64 bytes)
+    {
+        stats.mInFlight = false;
+        stats.mBytesReceived += bytes;
+    }
+
+    // custom coproto socket: send / recv move part of a byte stream
+    struct RecordingSocket
+    {
+        struct State
+        {
+            Socket mInner;
+            int mFd = -1;
+            std::string mPath;
+            std::shared_ptr<TranscriptStats> mStats;
+
+            // the message received last and how much of it was read
+            std::vector<u8> mMsg;
+            u64 mMsgPos = 0;
+
+            ~State()
+            {
+                if (mFd >= 0)
+                    ::close(mFd);
+            }
+
+            void record(const u8* data, u64 bytes)
+            {
+                while (bytes)
+                {
+                    auto n = ::write(mFd, data, bytes);
+                    if (n < 0)
+                    {
+                        if (errno == EINTR)
+                            continue;
+                        throw std::runtime_error("failed to write " + mPath + ": " + std::strerror(errno));
+                    }
+                    data += n;
+                    bytes -= n;
+                }
+            }
+        };
+        std::shared_ptr<State> mState;
+
+        macoro::task<Result> send(coproto::span<u8> data, macoro::stop_token = {})
+        {
+            auto& s = *mState;
+            countSend(*s.mStats, data.size());
+            co_await s.mInner.send(std::vector<u8>(data.begin(), data.end()));
+            co_return Result{ std::error_code{}, data.size() };
+        }
+
+        macoro::task<Result> recv(coproto::span<u8> data, macoro::stop_token = {})
+        {
+            auto& s = *mState;
+            if (s.mMsgPos == s.mMsg.size())
+            {
+                co_await s.mInner.recvResize(s.mMsg);
+                s.mMsgPos = 0;
+            }
+
+            auto n = std::min<u64>(data.size(), s.mMsg.size() - s.mMsgPos);
+            std::memcpy(data.data(), s.mMsg.data() + s.mMsgPos, n);
+            s.mMsgPos += n;
+            if (s.mFd >= 0)
+                s.record(data.data(), n);
+            countRecv(*s.mStats, n);
+            co_return Result{ std::error_code{}, n };
+        }
+    };
+
+    struct ReplaySocket
+    {
+        struct State
+        {
+            MappedFile mFile;
+            u64 mPos = sizeof(TranscriptHeader);
+            std::shared_ptr<TranscriptStats> mStats;
+        };
+        std::shared_ptr<State> mState;
+
+        macoro::task<Result> send(coproto::span<u8> data, macoro::stop_token = {})
+        {
+            countSend(*mState->mStats, data.size());
+            co_return Result{ std::error_code{}, data.size() };
+        }
+
+        macoro::task<Result> recv(coproto::span<u8> data, macoro::stop_token = {})
+        {
+            auto& s = *mState;
+            auto n = std::min<u64>(data.size(), s.mFile.size() - s.mPos);
+            if (n == 0)
+                co_return Result{ std::make_error_code(std::errc::no_message_available), 0 };
+
+            std::memcpy(data.data(), s.mFile.data() + s.mPos, n);
+            s.mPos += n;
+            countRecv(*s.mStats, n);
+            co_return Result{ std::error_code{}, n };
+        }
+    };
+
+    Socket makeRecordingSocket(
+        Socket inner,
+        const std::string& path,
+        std::shared_ptr<TranscriptStats> stats)
+    {
+        auto state = std::make_shared<RecordingSocket::State>();
+        state->mInner = std::move(inner);
+        state->mStats = stats ? stats : std::make_shared<TranscriptStats>();
+
+        if (path.size())
+        {
+            state->mPath = path;
+            state->mFd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+            if (state->mFd < 0)
+                throw std::runtime_error("failed to open " + path + ": " + std::strerror(errno));
+
+            TranscriptHeader h = {};
+            std::memcpy(h.mMagic, TranscriptHeader::Magic, sizeof(h.mMagic));
+            h.mVersion = TranscriptHeader::Version;
+            state->record((const u8*)&h, sizeof(h));
+        }
+
+        return coproto::makeSocket(RecordingSocket{ std::move(state) });
+    }
+
+    Socket makeReplaySocket(
+        const std::string& path,
+        std::shared_ptr<TranscriptStats> stats)
+    {
+        auto state = std::make_shared<ReplaySocket::State>();
+        state->mFile.open(path, MappedFile::Mode::Read);
+        state->mStats = stats ? stats : std::make_shared<TranscriptStats>();
+
+        TranscriptHeader h;
+        if (state->mFile.size() < sizeof(h))
+            throw RTE_LOC;
+        std::memcpy(&h, state->mFile.data(), sizeof(h));
+        if (std::memcmp(h.mMagic, TranscriptHeader::Magic, sizeof(h.mMagic)) ||
+            h.mVersion != TranscriptHeader::Version)
+            throw RTE_LOC;
+
+        return coproto::makeSocket(ReplaySocket{ std::move(state) });
+    }
+}
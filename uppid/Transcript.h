@@ -0,0 +1,57 @@
+#pragma once
+#include "volePSI/RsCpsi.h"
+
+#include <memory>
+#include <string>
+
+namespace uppid
+{
+    using Socket = coproto::Socket;
+
+    // Transcript of one party: the byte stream its socket read during a run,
+    // after a 16-byte header (magic "UPPIDTRN", u32 version, u32 reserved).
+    //
+    // To profile one party alone, run both parties once with recording
+    // sockets and deterministic seeds, then run the profiled party again,
+    // with the same seeds and inputs, on a replay socket. Its local work is
+    // the same as in the recorded run, but no peer competes for the cores.
+    struct TranscriptHeader
+    {
+        static constexpr char Magic[8] = { 'U', 'P', 'P', 'I', 'D', 'T', 'R', 'N' };
+        static constexpr oc::u32 Version = 1;
+
+        char mMagic[8];
+        oc::u32 mVersion;
+        oc::u32 mReserved;
+    };
+    static_assert(sizeof(TranscriptHeader) == 16, "fixed header size");
+
+    struct TranscriptStats
+    {
+        oc::u64 mBytesSent = 0;
+        oc::u64 mBytesReceived = 0;
+
+        // Sends of this end with no receive in between count as one flight.
+        // The flights of both ends add up to the rounds of a protocol whose
+        // messages alternate; with forked channels interleaving it is an
+        // upper bound.
+        oc::u64 mFlights = 0;
+        bool mInFlight = false;
+    };
+
+    // Byte stream over inner. Both parties must wrap their end. If path is not
+    // empty, everything this end receives is also written to path (created
+    // or truncated).
+    Socket makeRecordingSocket(
+        Socket inner,
+        const std::string& path = {},
+        std::shared_ptr<TranscriptStats> stats = {});
+
+    // Plays back a transcript written by makeRecordingSocket: receives are
+    // served from the file, sends are counted and dropped. A receive past the
+    // end of the transcript fails, e.g. when the replayed party diverged
+    // from the recorded run because of a different seed or input.
+    Socket makeReplaySocket(
+        const std::string& path,
+        std::shared_ptr<TranscriptStats> stats = {});
+}
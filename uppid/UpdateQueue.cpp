@@ -0,0 +1,254 @@
+#include "UpdateQueue.h"
+#include <cstring> // memcpy
+
+using namespace std;
+using namespace oc;
+
+namespace uppid
+{
+    template<typename TimePoint>
+    static bool isDue(
+        u64 pending,
+        const std::deque<std::pair<u64, TimePoint>>& times,
+        const UpdateQueueParams& params)
+    {
+        if (pending == 0)
+            return false;
+        if (pending >= params.mMaxBatchSize)
+            return true;
+        return times.size() &&
+            TimePoint::clock::now() - times.front().second >= params.mMaxStaleness;
+    }
+
+    // Drop the enqueue times of the calls that are now below the watermark.
+    template<typename TimePoint>
+    static void retireTimes(
+        std::deque<std::pair<u64, TimePoint>>& times,
+        u64 watermark)
+    {
+        while (times.size() && times.front().first <= watermark)
+            times.pop_front();
+    }
+
+    // Tell the peer whether we are due, how many insertions we will flush and
+    // whether we resume a batch in flight.
+    // Returns {theirDue, theirCount, theirInFlight}.
+    static coproto::task<std::array<u64, 3>> exchangeState(
+        bool myDue, u64 myCount, bool myInFlight, Socket& chl)
+    {
+        std::vector<u64> mine{ u64(myDue), myCount, u64(myInFlight) };
+        std::vector<u64> theirs(3);
+        co_await chl.send(std::move(mine));
+        co_await chl.recv(theirs);
+        co_return std::array<u64, 3>{ theirs[0], theirs[1], theirs[2] };
+    }
+
+    //////////////////////////////////////////////////////////////////
+    // P_0
+
+    UpdateQueue_P0::UpdateQueue_P0(
+        PseudonymisedDB_P0& db,
+        UpdateQueueParams params)
+        : mDB(db)
+        , mParams(params)
+    {}
+
+    oc::u64 UpdateQueue_P0::enqueue(oc::span<const oc::block> input)
+    {
+        std::lock_guard<std::mutex> lock(mMtx);
+        mPending.insert(mPending.end(), input.begin(), input.end());
+        mEnqueued += input.size();
+        if (input.size())
+            mEnqueueTimes.emplace_back(mEnqueued, Clock::now());
+        return mEnqueued;
+    };
+
+    oc::u64 UpdateQueue_P0::pending() const
+    {
+        std::lock_guard<std::mutex> lock(mMtx);
+        return mPending.size();
+    };
+
+    bool UpdateQueue_P0::due() const
+    {
+        std::lock_guard<std::mutex> lock(mMtx);
+        return isDue(mPending.size(), mEnqueueTimes, mParams);
+    };
+
+    oc::u64 UpdateQueue_P0::watermark() const
+    {
+        std::lock_guard<std::mutex> lock(mMtx);
+        return mWatermark;
+    };
+
+    Proto UpdateQueue_P0::poll(Socket& chl, bool force)
+    {
+        // snapshot: only the insertions announced to the peer are flushed,
+        // anything enqueued meanwhile waits for the next poll.
+        bool myDue, inFlight;
+        u64 myCount;
+        {
+            std::lock_guard<std::mutex> lock(mMtx);
+            inFlight = mInFlight.has_value();
+            myCount = inFlight ? *mInFlight : mPending.size();
+            myDue = inFlight || force || isDue(myCount, mEnqueueTimes, mParams);
+        }
+
+        auto [theirDue, theirCount, theirInFlight] =
+            co_await exchangeState(myDue, myCount, inFlight, chl);
+
+        if (inFlight || theirInFlight)
+        {
+            // the last shareUpdate failed on at least one side. The batch is
+            // already in mDB, so it is not inserted again. If only the peer is
+            // behind, our update committed and we just help it finish.
+            co_await mDB.shareUpdate_P0(chl);
+            if (!inFlight)
+                co_return;
+        }
+        else
+        {
+            if (!(myDue || theirDue) || !(myCount || theirCount))
+                co_return;
+
+            std::vector<oc::block> batch;
+            {
+                std::lock_guard<std::mutex> lock(mMtx);
+                batch.assign(mPending.begin(), mPending.begin() + myCount);
+            }
+
+            // same order as a manual insertID / respondOPRF pair
+            if (myCount)
+                co_await mDB.insertID(batch, chl);
+            if (theirCount)
+                co_await mDB.respondOPRF(chl);
+
+            {
+                std::lock_guard<std::mutex> lock(mMtx);
+                mInFlight = myCount;
+            }
+
+            co_await mDB.shareUpdate_P0(chl);
+        }
+
+        std::lock_guard<std::mutex> lock(mMtx);
+        mPending.erase(mPending.begin(), mPending.begin() + myCount);
+        mWatermark += myCount;
+        mInFlight.reset();
+
+        // the leftovers keep the time they were enqueued at
+        retireTimes(mEnqueueTimes, mWatermark);
+    };
+
+    //////////////////////////////////////////////////////////////////
+    // P_1
+
+    UpdateQueue_P1::UpdateQueue_P1(
+        PseudonymisedDB_P1& db,
+        UpdateQueueParams params)
+        : mDB(db)
+        , mParams(params)
+    {
+        mPendingData.resize(0, mDB.getData().cols());
+    }
+
+    oc::u64 UpdateQueue_P1::enqueue(
+        oc::span<const oc::block> input,
+        oc::MatrixView<oc::u8> inputData)
+    {
+        if (inputData.rows() != input.size() ||
+            inputData.cols() != mPendingData.cols())
+            throw RTE_LOC;
+
+        std::lock_guard<std::mutex> lock(mMtx);
+        auto oldRows = mPendingData.rows();
+        mPending.insert(mPending.end(), input.begin(), input.end());
+        mPendingData.resize(mPending.size(), mPendingData.cols(), oc::AllocType::Uninitialized);
+        if (inputData.size())
+            std::memcpy(mPendingData.data(oldRows), inputData.data(), inputData.size());
+
+        mEnqueued += input.size();
+        if (input.size())
+            mEnqueueTimes.emplace_back(mEnqueued, Clock::now());
+        return mEnqueued;
+    };
+
+    oc::u64 UpdateQueue_P1::pending() const
+    {
+        std::lock_guard<std::mutex> lock(mMtx);
+        return mPending.size();
+    };
+
+    bool UpdateQueue_P1::due() const
+    {
+        std::lock_guard<std::mutex> lock(mMtx);
+        return isDue(mPending.size(), mEnqueueTimes, mParams);
+    };
+
+    oc::u64 UpdateQueue_P1::watermark() const
+    {
+        std::lock_guard<std::mutex> lock(mMtx);
+        return mWatermark;
+    };
+
+    Proto UpdateQueue_P1::poll(Socket& chl, bool force)
+    {
+        bool myDue, inFlight;
+        u64 myCount;
+        {
+            std::lock_guard<std::mutex> lock(mMtx);
+            inFlight = mInFlight.has_value();
+            myCount = inFlight ? *mInFlight : mPending.size();
+            myDue = inFlight || force || isDue(myCount, mEnqueueTimes, mParams);
+        }
+
+        auto [theirDue, theirCount, theirInFlight] =
+            co_await exchangeState(myDue, myCount, inFlight, chl);
+
+        auto cols = mPendingData.cols();
+        if (inFlight || theirInFlight)
+        {
+            // see UpdateQueue_P0::poll
+            co_await mDB.shareUpdate_P1(chl);
+            if (!inFlight)
+                co_return;
+        }
+        else
+        {
+            if (!(myDue || theirDue) || !(myCount || theirCount))
+                co_return;
+
+            std::vector<oc::block> batch;
+            oc::Matrix<oc::u8> batchData(myCount, cols, oc::AllocType::Uninitialized);
+            {
+                std::lock_guard<std::mutex> lock(mMtx);
+                batch.assign(mPending.begin(), mPending.begin() + myCount);
+                if (batchData.size())
+                    std::memcpy(batchData.data(), mPendingData.data(), batchData.size());
+            }
+
+            if (theirCount)
+                co_await mDB.respondOPRF(chl);
+            if (myCount)
+                co_await mDB.insertID(batch, batchData, chl);
+
+            {
+                std::lock_guard<std::mutex> lock(mMtx);
+                mInFlight = myCount;
+            }
+
+            co_await mDB.shareUpdate_P1(chl);
+        }
+
+        std::lock_guard<std::mutex> lock(mMtx);
+        auto rest = mPending.size() - myCount;
+        mPending.erase(mPending.begin(), mPending.begin() + myCount);
+        if (rest)
+            std::memmove(mPendingData.data(), mPendingData.data(myCount), rest * cols);
+        mPendingData.resize(rest, cols);
+        mWatermark += myCount;
+        mInFlight.reset();
+
+        retireTimes(mEnqueueTimes, mWatermark);
+    };
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include "PseudonymisedDB.h"
+
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <utility>
+
+namespace uppid
+{
+    struct UpdateQueueParams
+    {
+        // flush once this many insertions are pending
+        oc::u64 mMaxBatchSize = 1ull << 16;
+
+        // flush once the oldest pending insertion is this old
+        std::chrono::milliseconds mMaxStaleness{ 1000 };
+    };
+
+    // Ingestion queue on top of PseudonymisedDB.
+    // Insertions are buffered locally and coalesced into one insertID +
+    // shareUpdate once either party hits its batch-size or staleness threshold,
+    // which amortizes the fixed cost of shareUpdate over many insertions.
+    //
+    // enqueue() may be called from any thread. poll() is a synchronization point
+    // with the peer and must be called the same number of times by both parties.
+    // Every insertion gets a sequence number; watermark() is the number of
+    // insertions that are already reflected in memShare/dataShare.
+    //
+    // If shareUpdate fails after the batch went through insertID, the batch is
+    // kept as in flight and the next poll only resumes shareUpdate.
+    class UpdateQueue_P0
+    {
+        using Clock = std::chrono::steady_clock;
+
+        PseudonymisedDB_P0& mDB;
+        UpdateQueueParams mParams;
+
+        mutable std::mutex mMtx;
+        std::vector<oc::block> mPending;
+        // (sequence number after the call, enqueue time) of every unflushed enqueue
+        std::deque<std::pair<oc::u64, Clock::time_point>> mEnqueueTimes;
+        // size of the batch inserted into mDB whose shareUpdate has not committed
+        std::optional<oc::u64> mInFlight;
+        oc::u64 mEnqueued = 0;
+        oc::u64 mWatermark = 0;
+
+    public:
+        UpdateQueue_P0(
+            PseudonymisedDB_P0& db,
+            UpdateQueueParams params = {});
+
+        // Returns the sequence number after the last enqueued insertion.
+        oc::u64 enqueue(oc::span<const oc::block> input);
+
+        oc::u64 pending() const;
+        bool due() const;
+
+        oc::u64 watermark() const;
+        bool isFresh(oc::u64 seq) const { return seq <= watermark(); };
+
+        // Flushes both queues if either party is due (or force is set).
+        Proto poll(Socket& chl, bool force = false);
+    };
+
+    class UpdateQueue_P1
+    {
+        using Clock = std::chrono::steady_clock;
+
+        PseudonymisedDB_P1& mDB;
+        UpdateQueueParams mParams;
+
+        mutable std::mutex mMtx;
+        std::vector<oc::block> mPending;
+        oc::Matrix<oc::u8> mPendingData;
+        std::deque<std::pair<oc::u64, Clock::time_point>> mEnqueueTimes;
+        std::optional<oc::u64> mInFlight;
+        oc::u64 mEnqueued = 0;
+        oc::u64 mWatermark = 0;
+
+    public:
+        UpdateQueue_P1(
+            PseudonymisedDB_P1& db,
+            UpdateQueueParams params = {});
+
+        oc::u64 enqueue(
+            oc::span<const oc::block> input,
+            oc::MatrixView<oc::u8> inputData);
+
+        oc::u64 pending() const;
+        bool due() const;
+
+        oc::u64 watermark() const;
+        bool isFresh(oc::u64 seq) const { return seq <= watermark(); };
+
+        Proto poll(Socket& chl, bool force = false);
+    };
+}